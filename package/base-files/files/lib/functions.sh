@@ -360,4 +360,37 @@ board_name() {
 	[ -e /tmp/sysinfo/board_name ] && cat /tmp/sysinfo/board_name || echo "generic"
 }
 
+# boot tracing, enabled by "boottrace" on the kernel command line or by
+# /etc/boottrace and active from preinit until the last rc.d script ran.
+# The trace is analyzed on the host with scripts/boottrace.py.
+BOOT_TRACE=/tmp/.boottrace
+
+boot_trace_start() {
+	local cmdline
+
+	read cmdline < /proc/cmdline
+	case " $cmdline " in
+		*" boottrace "*) ;;
+		*) [ -f /etc/boottrace ] || return 0 ;;
+	esac
+	: > "$BOOT_TRACE"
+	boot_trace I "trace:start"
+}
+
+boot_trace_stop() {
+	[ -f "$BOOT_TRACE" ] || return 0
+	boot_trace I "trace:stop"
+	mv "$BOOT_TRACE" /tmp/boottrace.log
+}
+
+# <B|E|I> <name>: begin, end or instant event, nested per process
+# (BOOT_TRACE_PID names the process for subshells)
+boot_trace() {
+	[ -f "$BOOT_TRACE" ] || return 0
+	local up idle
+
+	read up idle < /proc/uptime
+	echo "$up ${BOOT_TRACE_PID:-$$} $1 $2" >> "$BOOT_TRACE"
+}
+
 [ -z "$IPKG_INSTROOT" -a -f /lib/config/uci.sh ] && . /lib/config/uci.sh
@@ -18,27 +18,83 @@ __network_ifstatus() {
 	eval "$__tmp"
 }
 
+# parse the interface status once, all values are kept in __NETWORK_* variables
+# netifstatus sets __NETWORK_VARS, on failure the next call tries again
+__network_load() {
+	local __tmp
+
+	[ -n "${__NETWORK_VARS+x}" ] && return 0
+
+	[ -z "$__NETWORK_CACHE" ] && \
+		export __NETWORK_CACHE="$(ubus call network.interface dump)"
+
+	[ -n "$__NETWORK_CACHE" ] && \
+		__tmp="$(netifstatus -s "$__NETWORK_CACHE" 2>/dev/null)" || {
+		unset __NETWORK_CACHE
+		return 1
+	}
+
+	eval "$__tmp"
+}
+
+# 1: destination variable
+# 2: field
+# 3: interface
+__network_field() {
+	__network_load
+
+	case "$3" in
+		*[!A-Za-z0-9_]*) unset "$1"; return 1 ;;
+	esac
+
+	eval "[ -n \"\${__NETWORK_$2_$3+x}\" ]" || {
+		unset "$1"
+		return 1
+	}
+
+	eval "export \"$1=\${__NETWORK_$2_$3}\""
+}
+
+# query several values at once
+# 1..n: <variable>=<name>:<interface>, where network_get_<name> is the function
+#       used for the lookup, e.g. "lan_addr=ipaddr:lan"
+network_get_multi() {
+	local __arg __var __name __ret=0
+
+	for __arg in "$@"; do
+		__var="${__arg%%=*}"
+		__name="${__arg#*=}"
+		__name="${__name%%:*}"
+
+		case "$__name" in
+			""|*[!a-z0-9_]*) __ret=1; continue ;;
+		esac
+
+		network_get_$__name "$__var" "${__arg##*:}" || __ret=1
+	done
+
+	return $__ret
+}
+
 # determine first IPv4 address of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_ipaddr() {
-	__network_ifstatus "$1" "$2" "['ipv4-address'][0].address";
+	__network_field "$1" ipaddr "$2"
 }
 
 # determine first IPv6 address of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_ipaddr6() {
-	__network_ifstatus "$1" "$2" "['ipv6-address'][0].address" || \
-		__network_ifstatus "$1" "$2" "['ipv6-prefix-assignment'][0]['local-address'].address" || \
-		return 1
+	__network_field "$1" ipaddr6 "$2"
 }
 
 # determine first IPv4 subnet of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_subnet() {
-	__network_ifstatus "$1" "$2" "['ipv4-address'][0]['address','mask']" "/"
+	__network_field "$1" subnet "$2"
 }
 
 # determine first IPv6 subnet of given logical interface
@@ -81,42 +137,21 @@ network_get_subnet6() {
 # 1: destination variable
 # 2: interface
 network_get_prefix6() {
-	__network_ifstatus "$1" "$2" "['ipv6-prefix'][0]['address','mask']" "/"
+	__network_field "$1" prefix6 "$2"
 }
 
 # determine all IPv4 addresses of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_ipaddrs() {
-	__network_ifstatus "$1" "$2" "['ipv4-address'][*].address"
+	__network_field "$1" ipaddrs "$2"
 }
 
 # determine all IPv6 addresses of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_ipaddrs6() {
-	local __addr
-	local __list=""
-
-	if __network_ifstatus "__addr" "$2" "['ipv6-address'][*].address"; then
-		for __addr in $__addr; do
-			__list="${__list:+$__list }${__addr}"
-		done
-	fi
-
-	if __network_ifstatus "__addr" "$2" "['ipv6-prefix-assignment'][*]['local-address'].address"; then
-		for __addr in $__addr; do
-			__list="${__list:+$__list }${__addr}"
-		done
-	fi
-
-	if [ -n "$__list" ]; then
-		export "$1=$__list"
-		return 0
-	fi
-
-	unset "$1"
-	return 1
+	__network_field "$1" ipaddrs6 "$2"
 }
 
 # determine all IP addresses of given logical interface
@@ -141,44 +176,21 @@ network_get_ipaddrs_all() {
 # 1: destination variable
 # 2: interface
 network_get_subnets() {
-	__network_ifstatus "$1" "$2" "['ipv4-address'][*]['address','mask']" "/ "
+	__network_field "$1" subnets "$2"
 }
 
 # determine all IPv6 subnets of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_subnets6() {
-	local __addr __mask
-	local __list=""
-
-	if __network_ifstatus "__addr" "$2" "['ipv6-address'][*]['address','mask']" "/ "; then
-		for __addr in $__addr; do
-			__list="${__list:+$__list }${__addr}"
-		done
-	fi
-
-	if __network_ifstatus "__addr" "$2" "['ipv6-prefix-assignment'][*]['local-address'].address" && \
-	   __network_ifstatus "__mask" "$2" "['ipv6-prefix-assignment'][*].mask"; then
-		for __addr in $__addr; do
-			__list="${__list:+$__list }${__addr}/${__mask%% *}"
-			__mask="${__mask#* }"
-		done
-	fi
-
-	if [ -n "$__list" ]; then
-		export "$1=$__list"
-		return 0
-	fi
-
-	unset "$1"
-	return 1
+	__network_field "$1" subnets6 "$2"
 }
 
 # determine all IPv6 prefixes of given logical interface
 # 1: destination variable
 # 2: interface
 network_get_prefixes6() {
-	__network_ifstatus "$1" "$2" "['ipv6-prefix'][*]['address','mask']" "/ "
+	__network_field "$1" prefixes6 "$2"
 }
 
 # determine IPv4 gateway of given logical interface
@@ -186,11 +198,11 @@ network_get_prefixes6() {
 # 2: interface
 # 3: consider inactive gateway if "true" (optional)
 network_get_gateway() {
-	__network_ifstatus "$1" "$2" ".route[@.target='0.0.0.0' && !@.table].nexthop" "" 1 && \
+	__network_field "$1" gateway "$2" && \
 		return 0
 
 	[ "$3" = 1 -o "$3" = "true" ] && \
-		__network_ifstatus "$1" "$2" ".inactive.route[@.target='0.0.0.0' && !@.table].nexthop" "" 1
+		__network_field "$1" inactivegateway "$2"
 }
 
 # determine IPv6 gateway of given logical interface
@@ -198,11 +210,11 @@ network_get_gateway() {
 # 2: interface
 # 3: consider inactive gateway if "true" (optional)
 network_get_gateway6() {
-	__network_ifstatus "$1" "$2" ".route[@.target='::' && !@.table].nexthop" "" 1 && \
+	__network_field "$1" gateway6 "$2" && \
 		return 0
 
 	[ "$3" = 1 -o "$3" = "true" ] && \
-		__network_ifstatus "$1" "$2" ".inactive.route[@.target='::' && !@.table].nexthop" "" 1
+		__network_field "$1" inactivegateway6 "$2"
 }
 
 # determine the DNS servers of the given logical interface
@@ -210,10 +222,10 @@ network_get_gateway6() {
 # 2: interface
 # 3: consider inactive servers if "true" (optional)
 network_get_dnsserver() {
-	__network_ifstatus "$1" "$2" "['dns-server'][*]" && return 0
+	__network_field "$1" dnsserver "$2" && return 0
 
 	[ "$3" = 1 -o "$3" = "true" ] && \
-		__network_ifstatus "$1" "$2" ".inactive['dns-server'][*]"
+		__network_field "$1" inactivednsserver "$2"
 }
 
 # determine the domains of the given logical interface
@@ -221,59 +233,57 @@ network_get_dnsserver() {
 # 2: interface
 # 3: consider inactive domains if "true" (optional)
 network_get_dnssearch() {
-	__network_ifstatus "$1" "$2" "['dns-search'][*]" && return 0
+	__network_field "$1" dnssearch "$2" && return 0
 
 	[ "$3" = 1 -o "$3" = "true" ] && \
-		__network_ifstatus "$1" "$2" ".inactive['dns-search'][*]"
+		__network_field "$1" inactivednssearch "$2"
 }
 
 
 # 1: destination variable
-# 2: addr
+# 2: field (wan or wan6)
 # 3: inactive
 __network_wan()
 {
-	__network_ifstatus "$1" "" \
-		"[@.route[@.target='$2' && !@.table]].interface" "" 1 && \
-			return 0
+	__network_field "$1" "$2" "" && \
+		return 0
 
 	[ "$3" = 1 -o "$3" = "true" ] && \
-		__network_ifstatus "$1" "" \
-			"[@.inactive.route[@.target='$2' && !@.table]].interface" "" 1
+		__network_field "$1" "inactive$2" ""
 }
 
 # find the logical interface which holds the current IPv4 default route
 # 1: destination variable
 # 2: consider inactive default routes if "true" (optional)
-network_find_wan() { __network_wan "$1" "0.0.0.0" "$2"; }
+network_find_wan() { __network_wan "$1" wan "$2"; }
 
 # find the logical interface which holds the current IPv6 default route
 # 1: destination variable
 # 2: consider inactive dafault routes if "true" (optional)
-network_find_wan6() { __network_wan "$1" "::" "$2"; }
+network_find_wan6() { __network_wan "$1" wan6 "$2"; }
 
 # test whether the given logical interface is running
 # 1: interface
 network_is_up()
 {
 	local __up
-	__network_ifstatus "__up" "$1" ".up" && [ "$__up" = 1 ]
+	__network_field __up up "$1" && [ "$__up" = 1 ]
 }
 
 # determine the protocol of the given logical interface
 # 1: destination variable
 # 2: interface
-network_get_protocol() { __network_ifstatus "$1" "$2" ".proto"; }
+network_get_protocol() { __network_field "$1" proto "$2"; }
 
 # determine the layer 3 linux network device of the given logical interface
 # 1: destination variable
 # 2: interface
-network_get_device() { __network_ifstatus "$1" "$2" ".l3_device"; }
+network_get_device() { __network_field "$1" device "$2"; }
 
 # determine the layer 2 linux network device of the given logical interface
 # 1: destination variable
 # 2: interface
-network_get_physdev() { __network_ifstatus "$1" "$2" ".device"; }
+network_get_physdev() { __network_field "$1" physdev "$2"; }
 
 # defer netifd actions on the given linux network device
 # 1: device name
@@ -292,4 +302,4 @@ network_ready_device()
 }
 
 # flush the internal value cache to force re-reading values from ubus
-network_flush_cache() { unset __NETWORK_CACHE; }
+network_flush_cache() { unset __NETWORK_CACHE $__NETWORK_VARS __NETWORK_VARS; }
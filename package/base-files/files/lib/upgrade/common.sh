@@ -80,6 +80,19 @@ get_image() { # <source> [ <command> ]
 	local from="$1"
 	local cat="$2"
 
+	case "$from" in
+	http://*|https://*)
+		# streamed upgrade, only written through default_do_upgrade
+		# which verifies the image before committing its first block
+		[ -n "$STREAM_VERIFY" ] || {
+			echo "Streamed upgrade is not supported on this device." >&2
+			return 1
+		}
+		wget -q -O- "$from" 2>/dev/null | ${cat:-cat}
+		return
+		;;
+	esac
+
 	if [ -z "$cat" ]; then
 		local magic="$(dd if="$from" bs=2 count=1 2>/dev/null | hexdump -n 2 -e '1/1 "%02x"')"
 		case "$magic" in
@@ -92,12 +105,26 @@ get_image() { # <source> [ <command> ]
 	$cat "$from" 2>/dev/null
 }
 
+# <image> [<offset> ...]: sets the img_* variables printed by imageprobe,
+# img_magic_long_<offset> for every given offset, from a single read
+image_probe() {
+	local image="$1"
+	local offset args=""
+
+	shift
+	for offset in "$@"; do
+		args="$args -o $offset"
+	done
+
+	eval "$(imageprobe $args "$image" 2>/dev/null)"
+}
+
 get_magic_word() {
-	(get_image "$@" | dd bs=2 count=1 | hexdump -v -n 2 -e '1/1 "%02x"') 2>/dev/null
+	imageprobe ${2:+-c "$2"} -f magic_word "$1" 2>/dev/null
 }
 
 get_magic_long() {
-	(get_image "$@" | dd bs=4 count=1 | hexdump -v -n 4 -e '1/1 "%02x"') 2>/dev/null
+	imageprobe ${2:+-c "$2"} -f magic_long "$1" 2>/dev/null
 }
 
 export_bootdevice() {
@@ -208,16 +235,42 @@ jffs2_copy_config() {
 	fi
 }
 
+# run by mtd once a streamed image passed its checksums, a failure keeps
+# the first block of the image from being written
+STREAM_CHECK='. /lib/functions.sh; include /lib/upgrade; stream_check_image'
+
+# the platform check in stage 1 ran on a separate fetch of the head, check
+# the head of the data that was actually written again
+stream_check_image() {
+	platform_check_image /tmp/sysupgrade.head || {
+		[ "$FORCE" = 1 ] || return 1
+		echo "Image check 'platform_check_image' failed but --force given - will update anyway!"
+	}
+
+	fwtool_check_stream
+}
+
 # Flash firmware to MTD partition
 #
 # $(1): path to image
 # $(2): (optional) pipe command to extract firmware, e.g. dd bs=n skip=m
 default_do_upgrade() {
+	local STREAM_VERIFY=
+	local stream=
+
+	case "$1" in
+	http://*|https://*)
+		rm -f /tmp/sysupgrade.meta /tmp/sysupgrade.head
+		STREAM_VERIFY=1
+		stream="-t /tmp/sysupgrade.meta -H /tmp/sysupgrade.head"
+		;;
+	esac
+
 	sync
 	if [ "$SAVE_CONFIG" -eq 1 ]; then
-		get_image "$1" "$2" | mtd $MTD_CONFIG_ARGS -j "$CONF_TAR" write - "${PART_NAME:-image}"
+		get_image "$1" "$2" | mtd $stream ${stream:+-T "$STREAM_CHECK"} $MTD_CONFIG_ARGS -j "$CONF_TAR" write - "${PART_NAME:-image}"
 	else
-		get_image "$1" "$2" | mtd write - "${PART_NAME:-image}"
+		get_image "$1" "$2" | mtd $stream ${stream:+-T "$STREAM_CHECK"} write - "${PART_NAME:-image}"
 	fi
 }
 
@@ -5,8 +5,6 @@ fwtool_pre_upgrade() {
 fwtool_check_image() {
 	[ $# -gt 1 ] && return 1
 
-	. /usr/share/libubox/jshn.sh
-
 	if ! fwtool -q -i /tmp/sysupgrade.meta "$1"; then
 		echo "Image metadata not found"
 		[ "$REQUIRE_IMAGE_METADATA" = 1 -a "$FORCE" != 1 ] && {
@@ -16,7 +14,27 @@ fwtool_check_image() {
 		return 0
 	fi
 
-	json_load "$(cat /tmp/sysupgrade.meta)" || {
+	fwtool_check_metadata /tmp/sysupgrade.meta
+}
+
+# metadata check of a streamed image, see stream_check_image
+fwtool_check_stream() {
+	[ -s /tmp/sysupgrade.meta ] || {
+		echo "Image metadata not found"
+		[ "$REQUIRE_IMAGE_METADATA" = 1 -a "$FORCE" != 1 ] && return 1
+		return 0
+	}
+
+	fwtool_check_metadata /tmp/sysupgrade.meta && return 0
+	[ "$FORCE" = 1 ] && echo "Image check failed but --force given - will update anyway!"
+	[ "$FORCE" = 1 ]
+}
+
+# <file>: checks image metadata extracted to <file> against this device
+fwtool_check_metadata() {
+	. /usr/share/libubox/jshn.sh
+
+	json_load "$(cat "$1")" || {
 		echo "Invalid image metadata"
 		return 1
 	}
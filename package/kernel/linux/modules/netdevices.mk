@@ -175,6 +175,21 @@ endef
 
 $(eval $(call KernelPackage,swconfig))
 
+define KernelPackage/switch-sim
+  SUBMENU:=$(NETWORK_DEVICES_MENU)
+  TITLE:=Software emulated switch
+  DEPENDS:=@!LINUX_3_18 @!LINUX_4_4 +kmod-swconfig
+  KCONFIG:=CONFIG_SWCONFIG_SIM
+  FILES:=$(LINUX_DIR)/drivers/net/phy/swconfig_sim.ko
+endef
+
+define KernelPackage/switch-sim/description
+ Switch without hardware behind it, for testing the switch
+ configuration API and the swconfig utility
+endef
+
+$(eval $(call KernelPackage,switch-sim))
+
 define KernelPackage/switch-mvsw61xx
   SUBMENU:=$(NETWORK_DEVICES_MENU)
   TITLE:=Marvell 88E61xx switch support
@@ -19,33 +19,130 @@
 #include <linux/netdevice.h>
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/if_vlan.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,19,0)
+#define skb_vlan_tag_present(skb) vlan_tx_tag_present(skb)
+#endif
 
 static LIST_HEAD(trelay_devs);
 static struct dentry *debugfs_dir;
 
+struct trelay_stats {
+	u64 packets;
+	u64 bytes;
+	u64 direct;
+	u64 dropped;
+	struct u64_stats_sync syncp;
+};
+
+/* one relay direction, the rx_handler_data of the receiving device */
+struct trelay_port {
+	struct trelay *tr;
+	struct net_device *dev;
+	struct trelay_stats __percpu *stats;
+};
+
 struct trelay {
 	struct list_head list;
 	struct net_device *dev1, *dev2;
 	struct dentry *debugfs;
+	struct trelay_port port[2];
+	u32 direct;
 	char name[];
 };
 
+/*
+ * In direct mode frames are handed to the driver of the peer device right
+ * away instead of going through its qdisc. Frames that still need work
+ * done by the xmit path (segmentation, checksum or VLAN tag insertion),
+ * frames the driver has no room for and frames for a device that is down
+ * are queued as usual. So are frames for queueless software devices, which
+ * can stack and need the recursion limit of dev_queue_xmit(). Taps on the
+ * peer device do not see directly transmitted frames.
+ *
+ * Returns NETDEV_TX_BUSY if the frame was not handed to the driver, the
+ * result of the driver otherwise.
+ */
+static int trelay_xmit_direct(struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	struct netdev_queue *txq;
+	netdev_tx_t ret = NETDEV_TX_BUSY;
+	int cpu = smp_processor_id();
+
+	if (!netif_running(dev) || !netif_carrier_ok(dev))
+		return NETDEV_TX_BUSY;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,3,0)
+	if (!dev->tx_queue_len)
+#else
+	if (dev->priv_flags & IFF_NO_QUEUE)
+#endif
+		return NETDEV_TX_BUSY;
+
+	if (skb_is_gso(skb) || skb->ip_summed == CHECKSUM_PARTIAL ||
+	    skb_vlan_tag_present(skb))
+		return NETDEV_TX_BUSY;
+
+	skb_set_queue_mapping(skb, cpu % dev->real_num_tx_queues);
+	txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
+
+	HARD_TX_LOCK(dev, txq, cpu);
+	if (!netif_xmit_frozen_or_stopped(txq)) {
+		ret = dev->netdev_ops->ndo_start_xmit(skb, dev);
+		if (ret == NETDEV_TX_OK)
+			txq_trans_update(txq);
+	}
+	HARD_TX_UNLOCK(dev, txq);
+
+	return ret;
+}
+
 rx_handler_result_t trelay_handle_frame(struct sk_buff **pskb)
 {
-	struct net_device *dev;
+	struct trelay_port *port;
+	struct trelay_stats *stats;
 	struct sk_buff *skb = *pskb;
+	unsigned int len;
+	bool direct;
+	int ret = NETDEV_TX_BUSY;
 
-	dev = rcu_dereference(skb->dev->rx_handler_data);
-	if (!dev)
+	port = rcu_dereference(skb->dev->rx_handler_data);
+	if (!port)
 		return RX_HANDLER_PASS;
 
 	if (skb->protocol == htons(ETH_P_PAE))
 		return RX_HANDLER_PASS;
 
 	skb_push(skb, ETH_HLEN);
-	skb->dev = dev;
+	skb->dev = port->dev;
 	skb_forward_csum(skb);
-	dev_queue_xmit(skb);
+	len = skb->len;
+
+	if (ACCESS_ONCE(port->tr->direct))
+		ret = trelay_xmit_direct(skb);
+
+	/* the driver may also have consumed the frame with NET_XMIT_DROP */
+	direct = dev_xmit_complete(ret);
+	if (!direct)
+		ret = dev_queue_xmit(skb);
+	ret = net_xmit_eval(ret);
+
+	stats = this_cpu_ptr(port->stats);
+	u64_stats_update_begin(&stats->syncp);
+	if (ret) {
+		stats->dropped++;
+	} else {
+		stats->packets++;
+		stats->bytes += len;
+		if (direct)
+			stats->direct++;
+	}
+	u64_stats_update_end(&stats->syncp);
 
 	return RX_HANDLER_CONSUMED;
 }
@@ -56,6 +153,71 @@ static int trelay_open(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static void trelay_stats_read(struct trelay_port *port,
+			      struct trelay_stats *sum)
+{
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(i) {
+		struct trelay_stats *stats = per_cpu_ptr(port->stats, i);
+		u64 packets, bytes, direct, dropped;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			packets = stats->packets;
+			bytes = stats->bytes;
+			direct = stats->direct;
+			dropped = stats->dropped;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		sum->packets += packets;
+		sum->bytes += bytes;
+		sum->direct += direct;
+		sum->dropped += dropped;
+	}
+}
+
+static int trelay_stats_show(struct seq_file *s, void *unused)
+{
+	struct trelay *tr = s->private;
+	struct trelay_stats sum;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tr->port); i++) {
+		struct trelay_port *port = &tr->port[i];
+
+		trelay_stats_read(port, &sum);
+		seq_printf(s, "%s -> %s: packets %llu bytes %llu direct %llu dropped %llu\n",
+			   port == &tr->port[0] ? tr->dev1->name : tr->dev2->name,
+			   port->dev->name, sum.packets, sum.bytes, sum.direct,
+			   sum.dropped);
+	}
+
+	return 0;
+}
+
+static int trelay_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trelay_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_stats = {
+	.owner = THIS_MODULE,
+	.open = trelay_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void trelay_free(struct trelay *tr)
+{
+	free_percpu(tr->port[0].stats);
+	free_percpu(tr->port[1].stats);
+	kfree(tr);
+}
+
 static int trelay_do_remove(struct trelay *tr)
 {
 	list_del(&tr->list);
@@ -67,7 +229,7 @@ static int trelay_do_remove(struct trelay *tr)
 	netdev_rx_handler_unregister(tr->dev2);
 
 	debugfs_remove_recursive(tr->debugfs);
-	kfree(tr);
+	trelay_free(tr);
 
 	return 0;
 }
@@ -136,6 +298,13 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!tr)
 		return -ENOMEM;
 
+	tr->port[0].stats = netdev_alloc_pcpu_stats(struct trelay_stats);
+	tr->port[1].stats = netdev_alloc_pcpu_stats(struct trelay_stats);
+	if (!tr->port[0].stats || !tr->port[1].stats) {
+		trelay_free(tr);
+		return -ENOMEM;
+	}
+
 	rtnl_lock();
 	rcu_read_lock();
 
@@ -151,11 +320,16 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!dev1 || !dev2)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, dev2);
+	tr->port[0].tr = tr;
+	tr->port[0].dev = dev2;
+	tr->port[1].tr = tr;
+	tr->port[1].dev = dev1;
+
+	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, &tr->port[0]);
 	if (ret < 0)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, dev1);
+	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, &tr->port[1]);
 	if (ret < 0) {
 		netdev_rx_handler_unregister(dev1);
 		goto out;
@@ -171,13 +345,15 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 
 	tr->debugfs = debugfs_create_dir(name, debugfs_dir);
 	debugfs_create_file("remove", S_IWUSR, tr->debugfs, tr, &fops_remove);
+	debugfs_create_file("stats", S_IRUSR, tr->debugfs, tr, &fops_stats);
+	debugfs_create_u32("direct", S_IRUSR | S_IWUSR, tr->debugfs, &tr->direct);
 	ret = 0;
 
 out:
 	rcu_read_unlock();
 	rtnl_unlock();
 	if (ret < 0)
-		kfree(tr);
+		trelay_free(tr);
 
 	return ret;
 }
@@ -589,6 +589,303 @@ struct nlattr *nla_find(struct nlattr *head, int len, int attrtype)
 
 /** @} */
 
+/**
+ * @name Compiled Policies
+ *
+ * nla_parse() looks up the policy of every attribute and works out its
+ * length limits from the attribute type each time. A compiled policy
+ * holds the final limits of each attribute type, and may also describe
+ * the contents of nested attributes so that one call to
+ * nla_parse_compiled() indexes a message and all of its nested
+ * attribute streams. The index array holds all levels back to back;
+ * nla_nested_tb() returns the part belonging to a nested attribute.
+ *
+ * @code
+ * static struct nla_cpolicy *sta_cpol, *msg_cpol;
+ *
+ * sta_cpol = nla_policy_compile(sta_policy, STA_MAX, NULL, 0);
+ *
+ * struct nla_nest_policy nests[] = {
+ * 	{ ATTR_STA_INFO, sta_cpol },
+ * };
+ * msg_cpol = nla_policy_compile(msg_policy, ATTR_MAX, nests, 1);
+ *
+ * struct nlattr *tb[nla_cpolicy_tb_size(msg_cpol)];
+ * err = nla_parse_compiled(tb, head, len, msg_cpol);
+ * sta = nla_nested_tb(msg_cpol, tb, ATTR_STA_INFO);
+ * if (sta[STA_SIGNAL])
+ * 	...
+ * @endcode
+ *
+ * When only a few attributes are needed, the iterator walks the stream
+ * once, validating as it goes, and does not fill an index at all:
+ *
+ * @code
+ * struct nla_iter it;
+ *
+ * nla_iter_init(&it, head, len, msg_cpol);
+ * while ((nla = nla_iter_next(&it)) != NULL)
+ * 	if (nla_type(nla) == ATTR_IFINDEX)
+ * 		break;
+ * if (it.err < 0)
+ * 	goto errout;
+ * @endcode
+ * @{
+ */
+
+struct nla_centry {
+	uint16_t		minlen;
+	uint16_t		maxlen;
+	uint16_t		string;
+	/* index array offset of the nested level, if any */
+	uint16_t		base;
+	const struct nla_cpolicy *nest;
+};
+
+struct nla_cpolicy {
+	int			maxtype;
+	/* index array slots used by this level and all nested ones */
+	int			tb_size;
+	struct nla_centry	entry[];
+};
+
+/**
+ * Compile an attribute validation policy.
+ * @arg policy		Attribute validation policy or NULL.
+ * @arg maxtype		Maximum attribute type expected and accepted.
+ * @arg nests		Compiled policies of nested attributes or NULL.
+ * @arg n_nests		Number of elements in \a nests.
+ *
+ * The policies passed in \a nests must stay around as long as the
+ * returned one is used.
+ *
+ * @return Newly allocated compiled policy or NULL if the policy is
+ *         invalid or memory could not be allocated.
+ */
+struct nla_cpolicy *nla_policy_compile(struct nla_policy *policy, int maxtype,
+				       const struct nla_nest_policy *nests,
+				       int n_nests)
+{
+	struct nla_cpolicy *cp;
+	int i, tb_size = maxtype + 1;
+
+	if (maxtype < 0)
+		return NULL;
+
+	cp = calloc(1, sizeof(*cp) + (maxtype + 1) * sizeof(cp->entry[0]));
+	if (!cp)
+		return NULL;
+
+	cp->maxtype = maxtype;
+
+	for (i = 0; i <= maxtype; i++) {
+		struct nla_centry *e = &cp->entry[i];
+		struct nla_policy *pt = policy ? &policy[i] : NULL;
+
+		e->maxlen = UINT16_MAX;
+		if (!pt)
+			continue;
+
+		if (pt->type > NLA_TYPE_MAX)
+			goto errout;
+
+		if (pt->minlen)
+			e->minlen = pt->minlen;
+		else if (pt->type != NLA_UNSPEC)
+			e->minlen = nla_attr_minlen[pt->type];
+
+		if (pt->type == NLA_FLAG)
+			e->maxlen = 0;
+		else if (pt->maxlen)
+			e->maxlen = pt->maxlen;
+
+		e->string = pt->type == NLA_STRING;
+	}
+
+	for (i = 0; i < n_nests; i++) {
+		struct nla_centry *e;
+
+		if (nests[i].type <= 0 || nests[i].type > maxtype ||
+		    !nests[i].policy ||
+		    tb_size + nests[i].policy->tb_size > UINT16_MAX)
+			goto errout;
+
+		e = &cp->entry[nests[i].type];
+		e->nest = nests[i].policy;
+		e->base = tb_size;
+		tb_size += e->nest->tb_size;
+	}
+
+	cp->tb_size = tb_size;
+
+	return cp;
+errout:
+	free(cp);
+	return NULL;
+}
+
+/**
+ * Release a compiled policy.
+ * @arg cp		Compiled policy.
+ */
+void nla_policy_free(struct nla_cpolicy *cp)
+{
+	free(cp);
+}
+
+/**
+ * Number of index array elements needed by nla_parse_compiled().
+ * @arg cp		Compiled policy.
+ */
+int nla_cpolicy_tb_size(const struct nla_cpolicy *cp)
+{
+	return cp->tb_size;
+}
+
+/**
+ * Index of a nested attribute filled in by nla_parse_compiled().
+ * @arg cp		Compiled policy the index was filled with.
+ * @arg tb		Index array.
+ * @arg type		Type of the nested attribute.
+ *
+ * @return Index array of the nested attribute stream or NULL if no
+ *         nested policy was given for \a type.
+ */
+struct nlattr **nla_nested_tb(const struct nla_cpolicy *cp, struct nlattr *tb[],
+			      int type)
+{
+	if (type <= 0 || type > cp->maxtype || !cp->entry[type].nest)
+		return NULL;
+
+	return tb + cp->entry[type].base;
+}
+
+static inline int validate_centry(const struct nla_centry *e,
+				  const struct nlattr *nla)
+{
+	int len = nla_len(nla);
+
+	if (len < e->minlen || len > e->maxlen)
+		return -NLE_RANGE;
+
+	if (e->string && ((char *) nla_data(nla))[len - 1] != '\0')
+		return -NLE_INVAL;
+
+	return 0;
+}
+
+static int parse_compiled(struct nlattr *tb[], struct nlattr *head, int len,
+			  const struct nla_cpolicy *cp)
+{
+	struct nlattr *nla;
+	int rem, err;
+
+	nla_for_each_attr(nla, head, len, rem) {
+		int type = nla_type(nla);
+		const struct nla_centry *e;
+
+		if (type == 0 || type > cp->maxtype)
+			continue;
+
+		e = &cp->entry[type];
+		err = validate_centry(e, nla);
+		if (err < 0)
+			return err;
+
+		tb[type] = nla;
+
+		if (!e->nest)
+			continue;
+
+		/* a repeated nested attribute replaces the previous one */
+		memset(tb + e->base, 0, sizeof(*tb) * e->nest->tb_size);
+		err = parse_compiled(tb + e->base, nla_data(nla), nla_len(nla),
+				     e->nest);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * Create attribute index using a compiled policy.
+ * @arg tb		Index array with nla_cpolicy_tb_size() elements.
+ * @arg head		Head of attribute stream.
+ * @arg len		Length of attribute stream.
+ * @arg cp		Compiled policy.
+ *
+ * Works like nla_parse() but also indexes the contents of nested
+ * attributes a nested policy was given for.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int nla_parse_compiled(struct nlattr *tb[], struct nlattr *head, int len,
+		       const struct nla_cpolicy *cp)
+{
+	memset(tb, 0, sizeof(*tb) * cp->tb_size);
+
+	return parse_compiled(tb, head, len, cp);
+}
+
+/**
+ * Start iterating over a stream of attributes.
+ * @arg it		Iterator.
+ * @arg head		Head of attribute stream.
+ * @arg len		Length of attribute stream.
+ * @arg cp		Compiled policy or NULL.
+ */
+void nla_iter_init(struct nla_iter *it, struct nlattr *head, int len,
+		   const struct nla_cpolicy *cp)
+{
+	it->pos = head;
+	it->rem = len;
+	it->policy = cp;
+	it->err = 0;
+}
+
+/**
+ * Return the next attribute of a stream.
+ * @arg it		Iterator.
+ *
+ * If the iterator has a policy, attributes with types beyond its maximum
+ * type are skipped and all others are validated before being returned.
+ *
+ * @return Next attribute or NULL at the end of the stream or if an
+ *         attribute failed validation, in which case \c it->err is set.
+ */
+struct nlattr *nla_iter_next(struct nla_iter *it)
+{
+	const struct nla_cpolicy *cp = it->policy;
+	struct nlattr *nla;
+	int type;
+
+	while (nla_ok(it->pos, it->rem)) {
+		nla = it->pos;
+		it->pos = nla_next(nla, &it->rem);
+
+		type = nla_type(nla);
+		if (type == 0)
+			continue;
+
+		if (!cp)
+			return nla;
+
+		if (type > cp->maxtype)
+			continue;
+
+		it->err = validate_centry(&cp->entry[type], nla);
+		if (it->err < 0)
+			return NULL;
+
+		return nla;
+	}
+
+	return NULL;
+}
+
+/** @} */
+
 /**
  * @name Unspecific Attribute
  * @{
@@ -0,0 +1,126 @@
+/*
+ * genl-bench.c		Generic netlink family lookup benchmark
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ *
+ * Copyright (c) 2018 OpenWrt.org
+ *
+ * Times what a genl tool does at startup to find its family, the way
+ * it used to be done (dumping every family into a cache and searching
+ * it), with a single GETFAMILY request (cold lookup cache) and from the
+ * lookup cache (warm), each including socket setup.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netlink/netlink.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/family.h>
+
+enum {
+	BENCH_DUMP,
+	BENCH_COLD,
+	BENCH_WARM,
+};
+
+static const char *bench_names[] = {
+	[BENCH_DUMP] = "dump",
+	[BENCH_COLD] = "getfamily",
+	[BENCH_WARM] = "cached",
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int lookup(int mode, const char *name)
+{
+	struct genl_family *family = NULL;
+	struct nl_cache *cache;
+	struct nl_sock *sk;
+	int id = -1;
+
+	sk = nl_socket_alloc();
+	if (!sk || genl_connect(sk))
+		goto out;
+
+	switch (mode) {
+	case BENCH_DUMP:
+		if (genl_ctrl_alloc_cache(sk, &cache))
+			goto out;
+		family = genl_ctrl_search_by_name(cache, name);
+		nl_cache_free(cache);
+		break;
+	case BENCH_COLD:
+		genl_ctrl_cache_invalidate(NULL);
+		/* fall through */
+	case BENCH_WARM:
+		family = genl_ctrl_probe_by_name(sk, name);
+		break;
+	}
+
+	if (family) {
+		id = genl_family_get_id(family);
+		genl_family_put(family);
+	}
+
+out:
+	nl_socket_free(sk);
+	return id;
+}
+
+static int usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-n <count>] <family>...\n", progname);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 1000;
+	int i, j, mode, ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (optind == argc || count < 1)
+		return usage(argv[0]);
+
+	for (i = optind; i < argc; i++) {
+		for (mode = BENCH_DUMP; mode <= BENCH_WARM; mode++) {
+			double start;
+
+			if (lookup(mode, argv[i]) < 0) {
+				fprintf(stderr, "%s: family not found\n", argv[i]);
+				return 1;
+			}
+
+			start = now();
+			for (j = 0; j < count; j++)
+				lookup(mode, argv[i]);
+
+			printf("%s: %-10s %8.1f us/lookup\n", argv[i],
+			       bench_names[mode], (now() - start) / count * 1e6);
+		}
+	}
+
+	return 0;
+}
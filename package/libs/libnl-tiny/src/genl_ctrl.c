@@ -58,55 +58,42 @@ static struct nla_policy family_grp_policy[CTRL_ATTR_MCAST_GRP_MAX+1] = {
 	[CTRL_ATTR_MCAST_GRP_ID]   = { .type = NLA_U32 },
 };
 
-static int ctrl_msg_parser(struct nl_cache_ops *ops, struct genl_cmd *cmd,
-			   struct genl_info *info, void *arg)
+static int ctrl_family_parse(struct genl_family *family,
+			     struct nlattr **attrs)
 {
-	struct genl_family *family;
-	struct nl_parser_param *pp = arg;
 	int err;
 
-	family = genl_family_alloc();
-	if (family == NULL) {
-		err = -NLE_NOMEM;
-		goto errout;
-	}
-
-	if (info->attrs[CTRL_ATTR_FAMILY_NAME] == NULL) {
-		err = -NLE_MISSING_ATTR;
-		goto errout;
-	}
+	if (attrs[CTRL_ATTR_FAMILY_NAME] == NULL)
+		return -NLE_MISSING_ATTR;
 
-	if (info->attrs[CTRL_ATTR_FAMILY_ID] == NULL) {
-		err = -NLE_MISSING_ATTR;
-		goto errout;
-	}
+	if (attrs[CTRL_ATTR_FAMILY_ID] == NULL)
+		return -NLE_MISSING_ATTR;
 
-	family->ce_msgtype = info->nlh->nlmsg_type;
 	genl_family_set_id(family,
-			   nla_get_u16(info->attrs[CTRL_ATTR_FAMILY_ID]));
+			   nla_get_u16(attrs[CTRL_ATTR_FAMILY_ID]));
 	genl_family_set_name(family,
-		     nla_get_string(info->attrs[CTRL_ATTR_FAMILY_NAME]));
+		     nla_get_string(attrs[CTRL_ATTR_FAMILY_NAME]));
 
-	if (info->attrs[CTRL_ATTR_VERSION]) {
-		uint32_t version = nla_get_u32(info->attrs[CTRL_ATTR_VERSION]);
+	if (attrs[CTRL_ATTR_VERSION]) {
+		uint32_t version = nla_get_u32(attrs[CTRL_ATTR_VERSION]);
 		genl_family_set_version(family, version);
 	}
 
-	if (info->attrs[CTRL_ATTR_HDRSIZE]) {
-		uint32_t hdrsize = nla_get_u32(info->attrs[CTRL_ATTR_HDRSIZE]);
+	if (attrs[CTRL_ATTR_HDRSIZE]) {
+		uint32_t hdrsize = nla_get_u32(attrs[CTRL_ATTR_HDRSIZE]);
 		genl_family_set_hdrsize(family, hdrsize);
 	}
 
-	if (info->attrs[CTRL_ATTR_MAXATTR]) {
-		uint32_t maxattr = nla_get_u32(info->attrs[CTRL_ATTR_MAXATTR]);
+	if (attrs[CTRL_ATTR_MAXATTR]) {
+		uint32_t maxattr = nla_get_u32(attrs[CTRL_ATTR_MAXATTR]);
 		genl_family_set_maxattr(family, maxattr);
 	}
 
-	if (info->attrs[CTRL_ATTR_OPS]) {
+	if (attrs[CTRL_ATTR_OPS]) {
 		struct nlattr *nla, *nla_ops;
 		int remaining;
 
-		nla_ops = info->attrs[CTRL_ATTR_OPS];
+		nla_ops = attrs[CTRL_ATTR_OPS];
 		nla_for_each_nested(nla, nla_ops, remaining) {
 			struct nlattr *tb[CTRL_ATTR_OP_MAX+1];
 			int flags = 0, id;
@@ -114,13 +101,11 @@ static int ctrl_msg_parser(struct nl_cache_ops *ops, struct genl_cmd *cmd,
 			err = nla_parse_nested(tb, CTRL_ATTR_OP_MAX, nla,
 					       family_op_policy);
 			if (err < 0)
-				goto errout;
+				return err;
+
+			if (tb[CTRL_ATTR_OP_ID] == NULL)
+				return -NLE_MISSING_ATTR;
 
-			if (tb[CTRL_ATTR_OP_ID] == NULL) {
-				err = -NLE_MISSING_ATTR;
-				goto errout;
-			}
-			
 			id = nla_get_u32(tb[CTRL_ATTR_OP_ID]);
 
 			if (tb[CTRL_ATTR_OP_FLAGS])
@@ -128,16 +113,16 @@ static int ctrl_msg_parser(struct nl_cache_ops *ops, struct genl_cmd *cmd,
 
 			err = genl_family_add_op(family, id, flags);
 			if (err < 0)
-				goto errout;
+				return err;
 
 		}
 	}
 
-	if (info->attrs[CTRL_ATTR_MCAST_GROUPS]) {
+	if (attrs[CTRL_ATTR_MCAST_GROUPS]) {
 		struct nlattr *nla, *nla_grps;
 		int remaining;
 
-		nla_grps = info->attrs[CTRL_ATTR_MCAST_GROUPS];
+		nla_grps = attrs[CTRL_ATTR_MCAST_GROUPS];
 		nla_for_each_nested(nla, nla_grps, remaining) {
 			struct nlattr *tb[CTRL_ATTR_MCAST_GRP_MAX+1];
 			int id;
@@ -146,27 +131,45 @@ static int ctrl_msg_parser(struct nl_cache_ops *ops, struct genl_cmd *cmd,
 			err = nla_parse_nested(tb, CTRL_ATTR_MCAST_GRP_MAX, nla,
 					       family_grp_policy);
 			if (err < 0)
-				goto errout;
+				return err;
 
-			if (tb[CTRL_ATTR_MCAST_GRP_ID] == NULL) {
-				err = -NLE_MISSING_ATTR;
-				goto errout;
-			}
+			if (tb[CTRL_ATTR_MCAST_GRP_ID] == NULL)
+				return -NLE_MISSING_ATTR;
 			id = nla_get_u32(tb[CTRL_ATTR_MCAST_GRP_ID]);
 
-			if (tb[CTRL_ATTR_MCAST_GRP_NAME] == NULL) {
-				err = -NLE_MISSING_ATTR;
-				goto errout;
-			}
+			if (tb[CTRL_ATTR_MCAST_GRP_NAME] == NULL)
+				return -NLE_MISSING_ATTR;
 			name = nla_get_string(tb[CTRL_ATTR_MCAST_GRP_NAME]);
 
 			err = genl_family_add_grp(family, id, name);
 			if (err < 0)
-				goto errout;
+				return err;
 		}
 
 	}
 
+	return 0;
+}
+
+static int ctrl_msg_parser(struct nl_cache_ops *ops, struct genl_cmd *cmd,
+			   struct genl_info *info, void *arg)
+{
+	struct genl_family *family;
+	struct nl_parser_param *pp = arg;
+	int err;
+
+	family = genl_family_alloc();
+	if (family == NULL) {
+		err = -NLE_NOMEM;
+		goto errout;
+	}
+
+	family->ce_msgtype = info->nlh->nlmsg_type;
+
+	err = ctrl_family_parse(family, info->attrs);
+	if (err < 0)
+		goto errout;
+
 	err = pp->pp_cb((struct nl_object *) family, pp);
 errout:
 	genl_family_put(family);
@@ -249,6 +252,247 @@ struct genl_family *genl_ctrl_search_by_name(struct nl_cache *cache,
 
 /** @} */
 
+/**
+ * @name Family Lookup
+ * @{
+ */
+
+/** @cond SKIP */
+struct ctrl_cache_entry {
+	struct nl_list_head	list;
+	struct genl_family *	family;
+};
+
+struct ctrl_probe {
+	int			err;
+	struct genl_family *	family;
+};
+
+/* families looked up by this process, shared by all sockets */
+static NL_LIST_HEAD(ctrl_family_cache);
+/** @endcond */
+
+static struct genl_family *ctrl_cache_lookup(const char *name)
+{
+	struct ctrl_cache_entry *entry;
+
+	nl_list_for_each_entry(entry, &ctrl_family_cache, list) {
+		if (!strcmp(name, entry->family->gf_name)) {
+			nl_object_get((struct nl_object *) entry->family);
+			return entry->family;
+		}
+	}
+
+	return NULL;
+}
+
+static void ctrl_cache_add(struct genl_family *family)
+{
+	struct ctrl_cache_entry *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+
+	nl_object_get((struct nl_object *) family);
+	entry->family = family;
+	nl_list_add_tail(&entry->list, &ctrl_family_cache);
+}
+
+static void ctrl_cache_del(struct ctrl_cache_entry *entry)
+{
+	nl_list_del(&entry->list);
+	genl_family_put(entry->family);
+	free(entry);
+}
+
+static int probe_response(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *tb[CTRL_ATTR_MAX+1];
+	struct ctrl_probe *probe = arg;
+
+	probe->err = genlmsg_parse(nlmsg_hdr(msg), 0, tb, CTRL_ATTR_MAX,
+				   ctrl_policy);
+	if (probe->err >= 0)
+		probe->err = ctrl_family_parse(probe->family, tb);
+
+	return NL_STOP;
+}
+
+static struct genl_family *ctrl_probe_by_name(struct nl_sock *sk,
+					      const char *name)
+{
+	struct ctrl_probe probe = { -NLE_OBJ_NOTFOUND, NULL };
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int err;
+
+	probe.family = genl_family_alloc();
+	if (!probe.family)
+		return NULL;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		goto errout;
+
+	cb = nl_cb_clone(sk->s_cb);
+	if (!cb)
+		goto errout_msg;
+
+	if (!genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, GENL_ID_CTRL, 0, 0,
+			 CTRL_CMD_GETFAMILY, CTRL_VERSION))
+		goto errout_cb;
+
+	NLA_PUT_STRING(msg, CTRL_ATTR_FAMILY_NAME, name);
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, probe_response, &probe);
+
+	err = nl_send_auto_complete(sk, msg);
+	if (err < 0)
+		goto errout_cb;
+
+	/* an unknown family is reported as error instead of a reply */
+	err = nl_recvmsgs(sk, cb);
+	if (err < 0 || probe.err < 0)
+		goto errout_cb;
+
+	if (!(sk->s_flags & NL_NO_AUTO_ACK) && nl_wait_for_ack(sk) < 0)
+		goto errout_cb;
+
+	nl_cb_put(cb);
+	nlmsg_free(msg);
+
+	return probe.family;
+
+nla_put_failure:
+errout_cb:
+	nl_cb_put(cb);
+errout_msg:
+	nlmsg_free(msg);
+errout:
+	genl_family_put(probe.family);
+	return NULL;
+}
+
+/**
+ * Look up a generic netlink family by name.
+ * @arg sk		Netlink socket.
+ * @arg name		Family name.
+ *
+ * Requests only the named family from the controller instead of dumping
+ * all registered families. Results are kept in a cache shared by all
+ * sockets of the process, see genl_ctrl_cache_invalidate() and
+ * genl_ctrl_cache_notify() for dropping stale entries. The caller will
+ * own a reference on the returned object which needs to be given back
+ * after usage using genl_family_put().
+ *
+ * @return Generic netlink family object or NULL if no match was found.
+ */
+struct genl_family *genl_ctrl_probe_by_name(struct nl_sock *sk,
+					    const char *name)
+{
+	struct genl_family *family;
+
+	family = ctrl_cache_lookup(name);
+	if (family)
+		return family;
+
+	family = ctrl_probe_by_name(sk, name);
+	if (family)
+		ctrl_cache_add(family);
+
+	return family;
+}
+
+/**
+ * Drop families from the lookup cache.
+ * @arg name		Family name or NULL to drop all families.
+ */
+void genl_ctrl_cache_invalidate(const char *name)
+{
+	struct ctrl_cache_entry *entry, *n;
+
+	nl_list_for_each_entry_safe(entry, n, &ctrl_family_cache, list) {
+		if (name && strcmp(name, entry->family->gf_name))
+			continue;
+
+		ctrl_cache_del(entry);
+	}
+}
+
+/**
+ * Update the lookup cache from a controller notification.
+ * @arg msg		Message received on the "notify" group of nlctrl.
+ *
+ * Long running processes which subscribe to the controller's "notify"
+ * multicast group should pass every received message, so that families
+ * which went away or changed their multicast groups are looked up again.
+ *
+ * @return 1 if the message was a controller notification, 0 otherwise.
+ */
+int genl_ctrl_cache_notify(struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *tb[CTRL_ATTR_MAX+1];
+	struct genlmsghdr *ghdr;
+
+	if (nlh->nlmsg_type != GENL_ID_CTRL || !genlmsg_valid_hdr(nlh, 0))
+		return 0;
+
+	ghdr = nlmsg_data(nlh);
+	switch (ghdr->cmd) {
+	case CTRL_CMD_DELFAMILY:
+	case CTRL_CMD_NEWMCAST_GRP:
+	case CTRL_CMD_DELMCAST_GRP:
+		break;
+	default:
+		return 1;
+	}
+
+	if (genlmsg_parse(nlh, 0, tb, CTRL_ATTR_MAX, ctrl_policy) < 0 ||
+	    !tb[CTRL_ATTR_FAMILY_NAME])
+		genl_ctrl_cache_invalidate(NULL);
+	else
+		genl_ctrl_cache_invalidate(nla_get_string(tb[CTRL_ATTR_FAMILY_NAME]));
+
+	return 1;
+}
+
+/** @cond SKIP */
+/*
+ * Called by recvmsgs() for every message received on a generic netlink
+ * socket. Controller notifications are passed to genl_ctrl_cache_notify(),
+ * and a request rejected with ENOENT or EINVAL drops the family it was sent
+ * to, as its id may have gone away or been reused by a reloaded module.
+ */
+void __genl_ctrl_cache_recv(struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct ctrl_cache_entry *entry, *n;
+	struct nlmsgerr *e;
+
+	if (nlh->nlmsg_type == GENL_ID_CTRL) {
+		genl_ctrl_cache_notify(msg);
+		return;
+	}
+
+	if (nlh->nlmsg_type != NLMSG_ERROR ||
+	    nlh->nlmsg_len < nlmsg_msg_size(sizeof(*e)))
+		return;
+
+	e = nlmsg_data(nlh);
+	if (e->error != -ENOENT && e->error != -EINVAL)
+		return;
+
+	nl_list_for_each_entry_safe(entry, n, &ctrl_family_cache, list) {
+		if (entry->family->gf_id == e->msg.nlmsg_type)
+			ctrl_cache_del(entry);
+	}
+}
+/** @endcond */
+
+/** @} */
+
 /**
  * Resolve generic netlink family name to its identifier
  * @arg sk		Netlink socket.
@@ -261,23 +505,15 @@ struct genl_family *genl_ctrl_search_by_name(struct nl_cache *cache,
  */
 int genl_ctrl_resolve(struct nl_sock *sk, const char *name)
 {
-	struct nl_cache *cache;
 	struct genl_family *family;
 	int err;
 
-	if ((err = genl_ctrl_alloc_cache(sk, &cache)) < 0)
-		return err;
-
-	family = genl_ctrl_search_by_name(cache, name);
-	if (family == NULL) {
-		err = -NLE_OBJ_NOTFOUND;
-		goto errout;
-	}
+	family = genl_ctrl_probe_by_name(sk, name);
+	if (family == NULL)
+		return -NLE_OBJ_NOTFOUND;
 
 	err = genl_family_get_id(family);
 	genl_family_put(family);
-errout:
-	nl_cache_free(cache);
 
 	return err;
 }
@@ -299,23 +535,15 @@ static int genl_ctrl_grp_by_name(const struct genl_family *family,
 int genl_ctrl_resolve_grp(struct nl_sock *sk, const char *family_name,
 	const char *grp_name)
 {
-	struct nl_cache *cache;
 	struct genl_family *family;
 	int err;
 
-	if ((err = genl_ctrl_alloc_cache(sk, &cache)) < 0)
-		return err;
-
-	family = genl_ctrl_search_by_name(cache, family_name);
-	if (family == NULL) {
-		err = -NLE_OBJ_NOTFOUND;
-		goto errout;
-	}
+	family = genl_ctrl_probe_by_name(sk, family_name);
+	if (family == NULL)
+		return -NLE_OBJ_NOTFOUND;
 
 	err = genl_ctrl_grp_by_name(family, grp_name);
 	genl_family_put(family);
-errout:
-	nl_cache_free(cache);
 
 	return err;
 }
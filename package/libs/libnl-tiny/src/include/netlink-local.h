@@ -97,6 +97,8 @@ extern int __str2flags(const char *, struct trans_tbl *, size_t);
 
 extern void dump_from_ops(struct nl_object *, struct nl_dump_params *);
 
+extern void __genl_ctrl_cache_recv(struct nl_msg *);
+
 #ifdef disabled
 static inline struct nl_cache *dp_cache(struct nl_object *obj)
 {
@@ -78,6 +78,43 @@ extern int		nla_validate(struct nlattr *, int, int,
 				     struct nla_policy *);
 extern struct nlattr *	nla_find(struct nlattr *, int, int);
 
+/**
+ * @ingroup attr
+ * Nested attribute to be indexed along with its parent.
+ */
+struct nla_nest_policy {
+	/** Type of the nested attribute */
+	int				type;
+
+	/** Compiled policy of the nested attribute stream */
+	const struct nla_cpolicy *	policy;
+};
+
+/**
+ * @ingroup attr
+ * Attribute stream iterator, see nla_iter_next().
+ */
+struct nla_iter {
+	struct nlattr *			pos;
+	int				rem;
+	const struct nla_cpolicy *	policy;
+	int				err;
+};
+
+/* Compiled policies */
+struct nla_cpolicy;
+extern struct nla_cpolicy *	nla_policy_compile(struct nla_policy *, int,
+					const struct nla_nest_policy *, int);
+extern void		nla_policy_free(struct nla_cpolicy *);
+extern int		nla_cpolicy_tb_size(const struct nla_cpolicy *);
+extern struct nlattr **	nla_nested_tb(const struct nla_cpolicy *,
+				      struct nlattr **, int);
+extern int		nla_parse_compiled(struct nlattr **, struct nlattr *,
+					   int, const struct nla_cpolicy *);
+extern void		nla_iter_init(struct nla_iter *, struct nlattr *, int,
+				      const struct nla_cpolicy *);
+extern struct nlattr *	nla_iter_next(struct nla_iter *);
+
 /* Unspecific attribute */
 extern struct nlattr *	nla_reserve(struct nl_msg *, int, int);
 extern int		nla_put(struct nl_msg *, int, int, const void *);
@@ -32,6 +32,10 @@ extern int			genl_ctrl_resolve(struct nl_sock *,
 extern int 			genl_ctrl_resolve_grp(struct nl_sock *sk,
 						      const char *family,
 						      const char *grp);
+extern struct genl_family *	genl_ctrl_probe_by_name(struct nl_sock *,
+							const char *);
+extern void			genl_ctrl_cache_invalidate(const char *);
+extern int			genl_ctrl_cache_notify(struct nl_msg *);
 
 #ifdef __cplusplus
 }
@@ -42,6 +42,7 @@ struct nla_policy;
 #define NL_AUTO_SEQ	0
 
 #define NL_MSG_CRED_PRESENT 1
+#define NL_MSG_POOLED 2
 
 struct nl_msg
 {
@@ -265,6 +266,7 @@ static inline int nlmsg_expand(struct nl_msg *n, size_t newlen)
 
 	n->nm_nlh = (struct nlmsghdr*)tmp;
 	n->nm_size = newlen;
+	n->nm_flags &= ~NL_MSG_POOLED;
 
 	return 0;
 }
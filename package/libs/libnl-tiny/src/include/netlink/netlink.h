@@ -59,6 +59,14 @@ extern int			nl_recvmsgs(struct nl_sock *sk, struct nl_cb *cb);
 
 extern int			nl_wait_for_ack(struct nl_sock *);
 
+/* Batched Requests */
+struct nl_batch;
+extern struct nl_batch *	nl_batch_alloc(struct nl_sock *);
+extern void			nl_batch_free(struct nl_batch *);
+extern int			nl_batch_add(struct nl_batch *, struct nl_msg *);
+extern int			nl_batch_commit(struct nl_batch *);
+extern int			nl_batch_error(struct nl_batch *, int);
+
 /* Netlink Family Translations */
 extern char *			nl_nlfamily2str(int, char *, size_t);
 extern int			nl_str2nlfamily(const char *);
@@ -168,6 +168,18 @@
 
 static size_t default_msg_size = 4096;
 
+/*
+ * Released messages whose buffer holds at least NL_MSG_POOL_BUFSIZE bytes
+ * are kept on a free list and handed out again by __nlmsg_alloc(), which
+ * saves two allocations per request and per received message. Like the
+ * rest of the library the pool is not thread safe.
+ */
+#define NL_MSG_POOL_BUFSIZE	4096
+#define NL_MSG_POOL_MAX		32
+
+static struct nl_msg *msg_pool[NL_MSG_POOL_MAX];
+static int msg_pool_len;
+
 /**
  * @name Attribute Access
  * @{
@@ -257,16 +269,29 @@ static struct nl_msg *__nlmsg_alloc(size_t len)
 {
 	struct nl_msg *nm;
 
+	if (len <= NL_MSG_POOL_BUFSIZE && msg_pool_len > 0) {
+		nm = msg_pool[--msg_pool_len];
+		memset(nm, 0, offsetof(struct nl_msg, nm_nlh));
+		nm->nm_flags = NL_MSG_POOLED;
+		goto init;
+	}
+
 	nm = calloc(1, sizeof(*nm));
 	if (!nm)
 		goto errout;
 
-	nm->nm_refcnt = 1;
-
-	nm->nm_nlh = malloc(len);
+	/* small buffers are allocated at pool size so they can be reused */
+	if (len <= NL_MSG_POOL_BUFSIZE) {
+		nm->nm_nlh = malloc(NL_MSG_POOL_BUFSIZE);
+		nm->nm_flags = NL_MSG_POOLED;
+	} else
+		nm->nm_nlh = malloc(len);
 	if (!nm->nm_nlh)
 		goto errout;
 
+init:
+	nm->nm_refcnt = 1;
+
 	memset(nm->nm_nlh, 0, sizeof(struct nlmsghdr));
 
 	nm->nm_protocol = -1;
@@ -508,11 +533,18 @@ void nlmsg_free(struct nl_msg *msg)
 	if (msg->nm_refcnt < 0)
 		BUG();
 
-	if (msg->nm_refcnt <= 0) {
-		free(msg->nm_nlh);
-		free(msg);
-		NL_DBG(2, "msg %p: Freed\n", msg);
+	if (msg->nm_refcnt > 0)
+		return;
+
+	if ((msg->nm_flags & NL_MSG_POOLED) && msg_pool_len < NL_MSG_POOL_MAX) {
+		msg_pool[msg_pool_len++] = msg;
+		NL_DBG(2, "msg %p: Returned to pool\n", msg);
+		return;
 	}
+
+	free(msg->nm_nlh);
+	free(msg);
+	NL_DBG(2, "msg %p: Freed\n", msg);
 }
 
 /** @} */
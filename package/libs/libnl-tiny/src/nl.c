@@ -519,6 +519,10 @@ continue_reading:
 		if (creds)
 			nlmsg_set_creds(msg, creds);
 
+		/* keep the shared genl family cache in sync */
+		if (sk->s_proto == NETLINK_GENERIC)
+			__genl_ctrl_cache_recv(msg);
+
 		/* Raw callback is the first, it gives the most control
 		 * to the user and he can do his very own parsing. */
 		if (cb->cb_set[NL_CB_MSG_IN])
@@ -717,4 +721,361 @@ int nl_wait_for_ack(struct nl_sock *sk)
 
 /** @} */
 
+/**
+ * @name Batched Requests
+ *
+ * A batch queues a number of requests and transmits them with as few
+ * system calls as possible. Every request asks for an ACK and the result
+ * of each one is looked up by its sequence number once the kernel
+ * answered, so a failing request does not abort the others.
+ *
+ * @code
+ * struct nl_batch *b = nl_batch_alloc(sk);
+ *
+ * for (i = 0; i < n; i++)
+ * 	nl_batch_add(b, build_request(i));
+ *
+ * if (nl_batch_commit(b) > 0)
+ * 	for (i = 0; i < n; i++)
+ * 		if ((err = nl_batch_error(b, i)) < 0)
+ * 			...
+ *
+ * nl_batch_free(b);
+ * @endcode
+ * @{
+ */
+
+/* requests in flight at once, bounds the ACKs queued on the socket */
+#define NL_BATCH_WINDOW		32
+
+/* result of a request that was not answered yet */
+#define NL_BATCH_PENDING	1
+
+struct nl_batch_req
+{
+	struct nl_msg *		msg;
+	unsigned int		seq;
+	int			err;
+};
+
+struct nl_batch
+{
+	struct nl_sock *	b_sk;
+	struct nl_batch_req *	b_req;
+	int			b_len;
+	int			b_alloc;
+	int			b_sent;
+};
+
+struct nl_batch_window
+{
+	struct nl_batch_req *	req;
+	int			len;
+	int			pending;
+};
+
+static int no_sendmmsg;
+
+/**
+ * Allocate an empty request batch.
+ * @arg sk		Netlink socket the requests will be sent on.
+ *
+ * @return Newly allocated batch or NULL.
+ */
+struct nl_batch *nl_batch_alloc(struct nl_sock *sk)
+{
+	struct nl_batch *b;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->b_sk = sk;
+
+	return b;
+}
+
+/**
+ * Release a request batch.
+ * @arg b		Batch.
+ *
+ * Drops the references held on all queued messages.
+ */
+void nl_batch_free(struct nl_batch *b)
+{
+	int i;
+
+	if (!b)
+		return;
+
+	for (i = 0; i < b->b_len; i++)
+		nlmsg_free(b->b_req[i].msg);
+
+	free(b->b_req);
+	free(b);
+}
+
+/**
+ * Queue a request.
+ * @arg b		Batch.
+ * @arg msg		Netlink message.
+ *
+ * Completes the message header like nl_send_auto_complete() does, except
+ * that an ACK is always requested. The batch takes its own reference on
+ * the message, the caller may release it right away.
+ *
+ * @return Index of the request within the batch or a negative error code.
+ */
+int nl_batch_add(struct nl_batch *b, struct nl_msg *msg)
+{
+	struct nl_sock *sk = b->b_sk;
+	struct nl_batch_req *req;
+	struct nlmsghdr *nlh;
+
+	if (b->b_len == b->b_alloc) {
+		int alloc = b->b_alloc ? 2 * b->b_alloc : NL_BATCH_WINDOW;
+
+		req = realloc(b->b_req, alloc * sizeof(*req));
+		if (!req)
+			return -NLE_NOMEM;
+
+		b->b_req = req;
+		b->b_alloc = alloc;
+	}
+
+	nlh = nlmsg_hdr(msg);
+	if (nlh->nlmsg_pid == 0)
+		nlh->nlmsg_pid = sk->s_local.nl_pid;
+
+	if (nlh->nlmsg_seq == 0)
+		nlh->nlmsg_seq = sk->s_seq_next++;
+
+	if (msg->nm_protocol == -1)
+		msg->nm_protocol = sk->s_proto;
+
+	nlh->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+
+	nlmsg_get(msg);
+
+	req = &b->b_req[b->b_len];
+	req->msg = msg;
+	req->seq = nlh->nlmsg_seq;
+	req->err = NL_BATCH_PENDING;
+
+	return b->b_len++;
+}
+
+/**
+ * Get the result of a request.
+ * @arg b		Batch.
+ * @arg idx		Index returned by nl_batch_add().
+ *
+ * @return 0 if the request was acknowledged, -NLE_AGAIN if it has not
+ *         been answered yet or the negative error code it failed with.
+ */
+int nl_batch_error(struct nl_batch *b, int idx)
+{
+	if (idx < 0 || idx >= b->b_len)
+		return -NLE_RANGE;
+
+	if (b->b_req[idx].err == NL_BATCH_PENDING)
+		return -NLE_AGAIN;
+
+	return b->b_req[idx].err;
+}
+
+static void batch_send_one(struct nl_sock *sk, struct nl_batch_req *req)
+{
+	int ret;
+
+	if (sk->s_cb->cb_send_ow)
+		ret = sk->s_cb->cb_send_ow(sk, req->msg);
+	else
+		ret = nl_send(sk, req->msg);
+
+	if (ret < 0)
+		req->err = ret;
+}
+
+static void batch_send(struct nl_sock *sk, struct nl_batch_window *w)
+{
+	struct mmsghdr vec[NL_BATCH_WINDOW];
+	struct iovec iov[NL_BATCH_WINDOW];
+	struct nl_batch_req *req[NL_BATCH_WINDOW];
+	struct nl_cb *cb = sk->s_cb;
+	int i, n = 0, done = 0, ret;
+
+	for (i = 0; i < w->len; i++) {
+		struct nl_batch_req *r = &w->req[i];
+		struct sockaddr_nl *dst;
+
+		/* fall back to nl_send() where it does more than sendmmsg() */
+		if (no_sendmmsg || cb->cb_send_ow || nlmsg_get_creds(r->msg)) {
+			batch_send_one(sk, r);
+			continue;
+		}
+
+		nlmsg_set_src(r->msg, &sk->s_local);
+		if (cb->cb_set[NL_CB_MSG_OUT] &&
+		    nl_cb_call(cb, NL_CB_MSG_OUT, r->msg) != NL_OK) {
+			r->err = 0;
+			continue;
+		}
+
+		dst = nlmsg_get_dst(r->msg);
+		if (dst->nl_family != AF_NETLINK)
+			dst = &sk->s_peer;
+
+		iov[n].iov_base = nlmsg_hdr(r->msg);
+		iov[n].iov_len = nlmsg_hdr(r->msg)->nlmsg_len;
+		memset(&vec[n], 0, sizeof(vec[n]));
+		vec[n].msg_hdr.msg_name = dst;
+		vec[n].msg_hdr.msg_namelen = sizeof(*dst);
+		vec[n].msg_hdr.msg_iov = &iov[n];
+		vec[n].msg_hdr.msg_iovlen = 1;
+		req[n++] = r;
+	}
+
+	while (done < n) {
+		ret = sendmmsg(sk->s_fd, vec + done, n - done, 0);
+		if (ret > 0) {
+			done += ret;
+			continue;
+		}
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0 && errno == ENOSYS) {
+			no_sendmmsg = 1;
+			for (; done < n; done++) {
+				ret = sendmsg(sk->s_fd, &vec[done].msg_hdr, 0);
+				if (ret < 0)
+					req[done]->err = -nl_syserr2nlerr(errno);
+			}
+			break;
+		}
+
+		/* the first unsent message is the one that failed */
+		req[done++]->err = ret < 0 ? -nl_syserr2nlerr(errno) :
+					     -NLE_FAILURE;
+	}
+
+	for (i = 0; i < w->len; i++)
+		if (w->req[i].err != NL_BATCH_PENDING)
+			w->pending--;
+}
+
+static struct nl_batch_req *batch_lookup(struct nl_batch_window *w,
+					 unsigned int seq)
+{
+	int i;
+
+	for (i = 0; i < w->len; i++)
+		if (w->req[i].seq == seq)
+			return &w->req[i];
+
+	return NULL;
+}
+
+static void batch_complete(struct nl_batch_window *w, unsigned int seq,
+			   int err)
+{
+	struct nl_batch_req *req = batch_lookup(w, seq);
+
+	if (!req || req->err != NL_BATCH_PENDING)
+		return;
+
+	req->err = err;
+	w->pending--;
+}
+
+static int batch_seq_check(struct nl_msg *msg, void *arg)
+{
+	if (!batch_lookup(arg, nlmsg_hdr(msg)->nlmsg_seq))
+		return NL_SKIP;
+
+	return NL_OK;
+}
+
+static int batch_ack_handler(struct nl_msg *msg, void *arg)
+{
+	batch_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+
+	return NL_OK;
+}
+
+static int batch_error_handler(struct sockaddr_nl *nla, struct nlmsgerr *e,
+			       void *arg)
+{
+	batch_complete(arg, e->msg.nlmsg_seq, -nl_syserr2nlerr(e->error));
+
+	return NL_SKIP;
+}
+
+/**
+ * Send all queued requests and collect their results.
+ * @arg b		Batch.
+ * @pre The netlink socket must be in blocking state.
+ *
+ * Sends the requests not sent yet with sendmmsg() in windows of
+ * NL_BATCH_WINDOW messages and waits for all of them to be answered
+ * before the next window goes out, so the ACKs never overrun the socket
+ * receive buffer. Replies other than ACKs and errors are passed to the
+ * callbacks configured in the socket. A request answered with a dump is
+ * considered complete when the dump is.
+ *
+ * @return Number of failed requests or a negative error code if the
+ *         socket failed while receiving.
+ */
+int nl_batch_commit(struct nl_batch *b)
+{
+	struct nl_sock *sk = b->b_sk;
+	struct nl_batch_window w;
+	struct nl_cb *cb;
+	int i, err = 0, failed = 0;
+
+	cb = nl_cb_clone(sk->s_cb);
+	if (cb == NULL)
+		return -NLE_NOMEM;
+
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, batch_seq_check, &w);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, batch_ack_handler, &w);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, batch_ack_handler, &w);
+	nl_cb_err(cb, NL_CB_CUSTOM, batch_error_handler, &w);
+
+	while (b->b_sent < b->b_len) {
+		w.req = &b->b_req[b->b_sent];
+		w.len = b->b_len - b->b_sent;
+		if (w.len > NL_BATCH_WINDOW)
+			w.len = NL_BATCH_WINDOW;
+		w.pending = w.len;
+		b->b_sent += w.len;
+
+		batch_send(sk, &w);
+
+		while (w.pending > 0) {
+			err = nl_recvmsgs(sk, cb);
+			if (err < 0)
+				goto out;
+		}
+
+		sk->s_seq_expect = w.req[w.len - 1].seq + 1;
+	}
+
+out:
+	nl_cb_put(cb);
+
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < b->b_len; i++)
+		if (b->b_req[i].err < 0)
+			failed++;
+
+	return failed;
+}
+
+/** @} */
+
 /** @} */
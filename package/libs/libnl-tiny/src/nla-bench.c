@@ -0,0 +1,854 @@
+/*
+ * nla-bench.c		Attribute parser benchmark
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ *
+ * Copyright (c) 2018 OpenWrt.org
+ *
+ * Times the ways of getting at the attributes of captured generic netlink
+ * dump replies: a full nla_parse(), nla_parse_compiled() and an nla_iter
+ * walk that stops at the one attribute a handler is after. -m sets the
+ * maximum type the index arrays are sized for, e.g. to the ATTR_MAX a
+ * handler of the family would use; by default it is the highest type
+ * found in the capture. With -w it
+ * captures such a dump instead, e.g. "-w wiphy.dump nl80211 1" for the
+ * wiphy dump on a device with a wireless driver. Captures are kept in
+ * fixtures/.
+ *
+ * -p scan or -p station reads nl80211 scan or station dumps the way iw
+ * does: nla_parse() of the message, then nla_parse_nested() of the BSS or
+ * station info with iw's policies, and for stations once more for the
+ * rx and tx bitrates. This is compared against a single
+ * nla_parse_compiled() with the same policies compiled as nested ones and
+ * against nla_iter walks with the compiled policies. -g writes synthetic
+ * dumps of that shape, built from the uapi attribute layout in the order
+ * the kernel sends them, for hosts without a wireless device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/ctrl.h>
+
+#include <linux/nl80211.h>
+
+struct dump {
+	unsigned char *buf;
+	int len;
+	int count;
+	int maxtype;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int capture(const char *file, const char *name, int cmd)
+{
+	struct sockaddr_nl nla;
+	struct nlmsghdr *hdr;
+	struct nl_sock *sk;
+	struct nl_msg *msg;
+	unsigned char *buf;
+	FILE *f = NULL;
+	int family, n, done = 0, ret = 1;
+
+	sk = nl_socket_alloc();
+	if (!sk || genl_connect(sk)) {
+		fprintf(stderr, "Failed to connect to generic netlink\n");
+		goto out;
+	}
+
+	family = genl_ctrl_resolve(sk, name);
+	if (family < 0) {
+		fprintf(stderr, "%s: family not found\n", name);
+		goto out;
+	}
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		goto out;
+
+	genlmsg_put(msg, 0, 0, family, 0, NLM_F_DUMP, cmd, 0);
+	n = nl_send_auto_complete(sk, msg);
+	nlmsg_free(msg);
+	if (n < 0)
+		goto out;
+
+	f = fopen(file, "w");
+	if (!f) {
+		perror(file);
+		goto out;
+	}
+
+	while (!done) {
+		n = nl_recv(sk, &nla, &buf, NULL);
+		if (n <= 0) {
+			fprintf(stderr, "%s: %s\n", name, nl_geterror(n));
+			goto out;
+		}
+
+		for (hdr = (struct nlmsghdr *) buf; nlmsg_ok(hdr, n);
+		     hdr = nlmsg_next(hdr, &n)) {
+			if (hdr->nlmsg_type == NLMSG_ERROR) {
+				fprintf(stderr, "%s: dump of command %d failed\n",
+					name, cmd);
+				free(buf);
+				goto out;
+			}
+
+			if (hdr->nlmsg_type == NLMSG_DONE) {
+				done = 1;
+				break;
+			}
+
+			fwrite(hdr, 1, NLMSG_ALIGN(hdr->nlmsg_len), f);
+		}
+
+		free(buf);
+	}
+
+	ret = 0;
+
+out:
+	if (f && fclose(f))
+		ret = 1;
+	nl_socket_free(sk);
+	return ret;
+}
+
+static struct genlmsghdr *dump_next(struct nlmsghdr **hdr, int *rem)
+{
+	struct nlmsghdr *h = *hdr;
+
+	if (!nlmsg_ok(h, *rem))
+		return NULL;
+
+	*hdr = nlmsg_next(h, rem);
+
+	return nlmsg_data(h);
+}
+
+static int load(const char *file, struct dump *d)
+{
+	struct genlmsghdr *gnlh;
+	struct nlmsghdr *hdr;
+	struct nlattr *nla;
+	FILE *f;
+	long len;
+	int rem, i;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+
+	if (fseek(f, 0, SEEK_END) || (len = ftell(f)) <= 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		fclose(f);
+		fprintf(stderr, "%s: empty or unreadable\n", file);
+		return -1;
+	}
+
+	memset(d, 0, sizeof(*d));
+	d->len = len;
+	d->buf = malloc(len);
+	if (!d->buf || fread(d->buf, 1, len, f) != len) {
+		fclose(f);
+		free(d->buf);
+		fprintf(stderr, "%s: read failed\n", file);
+		return -1;
+	}
+	fclose(f);
+
+	hdr = (struct nlmsghdr *) d->buf;
+	rem = d->len;
+	while ((gnlh = dump_next(&hdr, &rem))) {
+		nla_for_each_attr(nla, genlmsg_attrdata(gnlh, 0),
+				  genlmsg_attrlen(gnlh, 0), i)
+			if (nla_type(nla) > d->maxtype)
+				d->maxtype = nla_type(nla);
+		d->count++;
+	}
+
+	if (!d->count || !d->maxtype) {
+		free(d->buf);
+		fprintf(stderr, "%s: no attributes found\n", file);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* the last attribute type of the first message, the worst case for nla_iter */
+static int last_type(struct dump *d)
+{
+	struct genlmsghdr *gnlh = nlmsg_data((struct nlmsghdr *) d->buf);
+	struct nlattr *nla;
+	int type = 0, i;
+
+	nla_for_each_attr(nla, genlmsg_attrdata(gnlh, 0),
+			  genlmsg_attrlen(gnlh, 0), i)
+		type = nla_type(nla);
+
+	return type;
+}
+
+enum {
+	BENCH_PARSE,
+	BENCH_COMPILED,
+	BENCH_ITER,
+	__BENCH_MAX
+};
+
+static const char *bench_names[] = {
+	[BENCH_PARSE] = "nla_parse",
+	[BENCH_COMPILED] = "compiled",
+	[BENCH_ITER] = "nla_iter",
+};
+
+static int run(struct dump *d, int mode, int count, int type,
+	       const struct nla_cpolicy *cp, struct nlattr **tb)
+{
+	struct genlmsghdr *gnlh;
+	struct nlmsghdr *hdr;
+	struct nla_iter it;
+	struct nlattr *nla;
+	int i, rem, found = 0;
+
+	for (i = 0; i < count; i++) {
+		hdr = (struct nlmsghdr *) d->buf;
+		rem = d->len;
+		while ((gnlh = dump_next(&hdr, &rem))) {
+			struct nlattr *head = genlmsg_attrdata(gnlh, 0);
+			int len = genlmsg_attrlen(gnlh, 0);
+
+			switch (mode) {
+			case BENCH_PARSE:
+				nla_parse(tb, d->maxtype, head, len, NULL);
+				nla = tb[type];
+				break;
+			case BENCH_COMPILED:
+				nla_parse_compiled(tb, head, len, cp);
+				nla = tb[type];
+				break;
+			default:
+				nla_iter_init(&it, head, len, NULL);
+				while ((nla = nla_iter_next(&it)))
+					if (nla_type(nla) == type)
+						break;
+				break;
+			}
+
+			if (nla)
+				found++;
+		}
+	}
+
+	return found;
+}
+
+static int bench(const char *file, int count, int type, int maxtype)
+{
+	struct nla_cpolicy *cp;
+	struct nlattr **tb;
+	struct dump d;
+	int mode, found, ret = 1;
+
+	if (load(file, &d))
+		return 1;
+
+	if (!type)
+		type = last_type(&d);
+
+	if (maxtype > d.maxtype)
+		d.maxtype = maxtype;
+
+	if (type > d.maxtype) {
+		fprintf(stderr, "%s: no attribute of type %d\n", file, type);
+		free(d.buf);
+		return 1;
+	}
+
+	cp = nla_policy_compile(NULL, d.maxtype, NULL, 0);
+	tb = calloc(d.maxtype + 1, sizeof(*tb));
+	if (!cp || !tb)
+		goto out;
+
+	printf("%s: %d messages, %d bytes, max type %d, looking for type %d\n",
+	       file, d.count, d.len, d.maxtype, type);
+
+	for (mode = 0; mode < __BENCH_MAX; mode++) {
+		double start = now();
+
+		found = run(&d, mode, count, type, cp, tb);
+		printf("  %-10s %8.1f ns/message, found in %d\n",
+		       bench_names[mode],
+		       (now() - start) / ((double) count * d.count) * 1e9,
+		       found / count);
+	}
+
+	ret = 0;
+
+out:
+	free(tb);
+	if (cp)
+		nla_policy_free(cp);
+	free(d.buf);
+	return ret;
+}
+
+/* iw's policies, scan.c and station.c */
+static struct nla_policy bss_policy[NL80211_BSS_MAX + 1] = {
+	[NL80211_BSS_TSF] = { .type = NLA_U64 },
+	[NL80211_BSS_FREQUENCY] = { .type = NLA_U32 },
+	[NL80211_BSS_BSSID] = { },
+	[NL80211_BSS_BEACON_INTERVAL] = { .type = NLA_U16 },
+	[NL80211_BSS_CAPABILITY] = { .type = NLA_U16 },
+	[NL80211_BSS_INFORMATION_ELEMENTS] = { },
+	[NL80211_BSS_SIGNAL_MBM] = { .type = NLA_U32 },
+	[NL80211_BSS_SIGNAL_UNSPEC] = { .type = NLA_U8 },
+	[NL80211_BSS_STATUS] = { .type = NLA_U32 },
+	[NL80211_BSS_SEEN_MS_AGO] = { .type = NLA_U32 },
+	[NL80211_BSS_BEACON_IES] = { },
+};
+
+static struct nla_policy sta_policy[NL80211_STA_INFO_MAX + 1] = {
+	[NL80211_STA_INFO_INACTIVE_TIME] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_RX_BYTES64] = { .type = NLA_U64 },
+	[NL80211_STA_INFO_TX_BYTES64] = { .type = NLA_U64 },
+	[NL80211_STA_INFO_RX_PACKETS] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_TX_PACKETS] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_BEACON_RX] = { .type = NLA_U64 },
+	[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
+	[NL80211_STA_INFO_T_OFFSET] = { .type = NLA_U64 },
+	[NL80211_STA_INFO_TX_BITRATE] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_RX_BITRATE] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_LLID] = { .type = NLA_U16 },
+	[NL80211_STA_INFO_PLID] = { .type = NLA_U16 },
+	[NL80211_STA_INFO_PLINK_STATE] = { .type = NLA_U8 },
+	[NL80211_STA_INFO_TX_RETRIES] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_TX_FAILED] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_BEACON_LOSS] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_RX_DROP_MISC] = { .type = NLA_U64 },
+	[NL80211_STA_INFO_STA_FLAGS] =
+		{ .minlen = sizeof(struct nl80211_sta_flag_update) },
+	[NL80211_STA_INFO_LOCAL_PM] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_PEER_PM] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_NONPEER_PM] = { .type = NLA_U32 },
+	[NL80211_STA_INFO_CHAIN_SIGNAL] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_CHAIN_SIGNAL_AVG] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_TID_STATS] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_BSS_PARAM] = { .type = NLA_NESTED },
+	[NL80211_STA_INFO_RX_DURATION] = { .type = NLA_U64 },
+};
+
+static struct nla_policy rate_policy[NL80211_RATE_INFO_MAX + 1] = {
+	[NL80211_RATE_INFO_BITRATE] = { .type = NLA_U16 },
+	[NL80211_RATE_INFO_BITRATE32] = { .type = NLA_U32 },
+	[NL80211_RATE_INFO_MCS] = { .type = NLA_U8 },
+	[NL80211_RATE_INFO_40_MHZ_WIDTH] = { .type = NLA_FLAG },
+	[NL80211_RATE_INFO_SHORT_GI] = { .type = NLA_FLAG },
+};
+
+static void put_ies(struct nl_msg *msg, int type, int len, int seed)
+{
+	unsigned char ies[256];
+	int i;
+
+	/* SSID element and filler elements of up to 32 bytes */
+	for (i = 0; i < len; i++)
+		ies[i] = (i * 7 + seed) & 0xff;
+	for (i = 0; i < len; i += 34) {
+		ies[i] = i ? 221 : 0;
+		ies[i + 1] = len - i - 2 < 32 ? len - i - 2 : 32;
+	}
+	nla_put(msg, type, len, ies);
+}
+
+static void put_scan(struct nl_msg *msg, int i)
+{
+	unsigned char bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, i };
+	struct nlattr *bss;
+
+	nla_put_u32(msg, NL80211_ATTR_GENERATION, 42);
+	nla_put_u32(msg, NL80211_ATTR_IFINDEX, 3);
+	nla_put_u64(msg, NL80211_ATTR_WDEV, 1);
+
+	bss = nla_nest_start(msg, NL80211_ATTR_BSS);
+	nla_put(msg, NL80211_BSS_BSSID, sizeof(bssid), bssid);
+	if (i & 1)
+		nla_put_flag(msg, NL80211_BSS_PRESP_DATA);
+	nla_put_u64(msg, NL80211_BSS_TSF, 1000000ULL * i);
+	put_ies(msg, NL80211_BSS_INFORMATION_ELEMENTS, 160 + i % 64, i);
+	nla_put_u64(msg, NL80211_BSS_BEACON_TSF, 1000000ULL * i);
+	put_ies(msg, NL80211_BSS_BEACON_IES, 140 + i % 64, i + 1);
+	nla_put_u16(msg, NL80211_BSS_BEACON_INTERVAL, 100);
+	nla_put_u16(msg, NL80211_BSS_CAPABILITY, 0x0411);
+	nla_put_u32(msg, NL80211_BSS_FREQUENCY, i & 2 ? 5180 : 2412);
+	nla_put_u32(msg, NL80211_BSS_CHAN_WIDTH, 0);
+	nla_put_u32(msg, NL80211_BSS_SEEN_MS_AGO, 100 * i);
+	nla_put_u64(msg, NL80211_BSS_LAST_SEEN_BOOTTIME, 5000000000ULL);
+	nla_put_u32(msg, NL80211_BSS_SIGNAL_MBM, -4000 - 100 * i);
+	if (!i)
+		nla_put_u32(msg, NL80211_BSS_STATUS, NL80211_BSS_STATUS_ASSOCIATED);
+	nla_nest_end(msg, bss);
+}
+
+static void put_rate(struct nl_msg *msg, int type, int i)
+{
+	struct nlattr *rate = nla_nest_start(msg, type);
+
+	nla_put_u32(msg, NL80211_RATE_INFO_BITRATE32, 1300 + 10 * i);
+	nla_put_u16(msg, NL80211_RATE_INFO_BITRATE, 1300 + 10 * i);
+	nla_put_u8(msg, NL80211_RATE_INFO_MCS, i % 16);
+	nla_put_flag(msg, NL80211_RATE_INFO_40_MHZ_WIDTH);
+	if (i & 1)
+		nla_put_flag(msg, NL80211_RATE_INFO_SHORT_GI);
+	nla_nest_end(msg, rate);
+}
+
+static void put_station(struct nl_msg *msg, int i)
+{
+	unsigned char mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, i };
+	struct nl80211_sta_flag_update flags = { 0x7e, 0x62 };
+	struct nlattr *sta, *chains, *tids, *tid, *bss;
+	int j;
+
+	nla_put_u32(msg, NL80211_ATTR_IFINDEX, 3);
+	nla_put(msg, NL80211_ATTR_MAC, sizeof(mac), mac);
+	nla_put_u32(msg, NL80211_ATTR_GENERATION, 42);
+
+	sta = nla_nest_start(msg, NL80211_ATTR_STA_INFO);
+	nla_put_u32(msg, NL80211_STA_INFO_CONNECTED_TIME, 600 + i);
+	nla_put_u32(msg, NL80211_STA_INFO_INACTIVE_TIME, 10 * i);
+	nla_put_u64(msg, NL80211_STA_INFO_RX_BYTES64, 1000000ULL * i);
+	nla_put_u64(msg, NL80211_STA_INFO_TX_BYTES64, 2000000ULL * i);
+	nla_put_u32(msg, NL80211_STA_INFO_RX_BYTES, 1000000 * i);
+	nla_put_u32(msg, NL80211_STA_INFO_TX_BYTES, 2000000 * i);
+	nla_put_u64(msg, NL80211_STA_INFO_RX_DURATION, 300000ULL * i);
+	nla_put_u8(msg, NL80211_STA_INFO_SIGNAL, -40 - i);
+	nla_put_u8(msg, NL80211_STA_INFO_SIGNAL_AVG, -41 - i);
+	for (j = 0; j < 2; j++) {
+		int k;
+
+		chains = nla_nest_start(msg, j ? NL80211_STA_INFO_CHAIN_SIGNAL_AVG :
+					    NL80211_STA_INFO_CHAIN_SIGNAL);
+		for (k = 0; k < 2; k++)
+			nla_put_u8(msg, k, -42 - i - k);
+		nla_nest_end(msg, chains);
+	}
+	put_rate(msg, NL80211_STA_INFO_TX_BITRATE, i);
+	put_rate(msg, NL80211_STA_INFO_RX_BITRATE, i + 1);
+	nla_put_u32(msg, NL80211_STA_INFO_RX_PACKETS, 1000 * i);
+	nla_put_u32(msg, NL80211_STA_INFO_TX_PACKETS, 2000 * i);
+	nla_put_u32(msg, NL80211_STA_INFO_TX_RETRIES, 10 * i);
+	nla_put_u32(msg, NL80211_STA_INFO_TX_FAILED, i);
+	nla_put_u32(msg, NL80211_STA_INFO_BEACON_LOSS, 0);
+	nla_put_u64(msg, NL80211_STA_INFO_RX_DROP_MISC, i);
+	nla_put_u64(msg, NL80211_STA_INFO_BEACON_RX, 6000);
+	nla_put_u8(msg, NL80211_STA_INFO_BEACON_SIGNAL_AVG, -40);
+
+	bss = nla_nest_start(msg, NL80211_STA_INFO_BSS_PARAM);
+	nla_put_flag(msg, NL80211_STA_BSS_PARAM_SHORT_SLOT_TIME);
+	nla_put_u8(msg, NL80211_STA_BSS_PARAM_DTIM_PERIOD, 2);
+	nla_put_u16(msg, NL80211_STA_BSS_PARAM_BEACON_INTERVAL, 100);
+	nla_nest_end(msg, bss);
+
+	nla_put(msg, NL80211_STA_INFO_STA_FLAGS, sizeof(flags), &flags);
+	nla_put_u64(msg, NL80211_STA_INFO_T_OFFSET, 0);
+
+	/* mac80211 reports the 16 TIDs and the non-QoS one */
+	tids = nla_nest_start(msg, NL80211_STA_INFO_TID_STATS);
+	for (j = 1; j <= 17; j++) {
+		tid = nla_nest_start(msg, j);
+		nla_put_u64(msg, NL80211_TID_STATS_RX_MSDU, 100 * j);
+		nla_put_u64(msg, NL80211_TID_STATS_TX_MSDU, 200 * j);
+		nla_put_u64(msg, NL80211_TID_STATS_TX_MSDU_RETRIES, j);
+		nla_put_u64(msg, NL80211_TID_STATS_TX_MSDU_FAILED, 0);
+		nla_nest_end(msg, tid);
+	}
+	nla_nest_end(msg, tids);
+	nla_nest_end(msg, sta);
+}
+
+enum {
+	SHAPE_SCAN,
+	SHAPE_STATION,
+	__SHAPE_MAX
+};
+
+static const struct {
+	const char *name;
+	int cmd;
+	void (*put)(struct nl_msg *msg, int i);
+} shapes[] = {
+	[SHAPE_SCAN] = { "scan", NL80211_CMD_NEW_SCAN_RESULTS, put_scan },
+	[SHAPE_STATION] = { "station", NL80211_CMD_NEW_STATION, put_station },
+};
+
+static int shape_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < __SHAPE_MAX; i++)
+		if (!strcmp(shapes[i].name, name))
+			return i;
+
+	fprintf(stderr, "Unknown dump shape '%s'\n", name);
+	return -1;
+}
+
+static int generate(const char *file, int shape, int count)
+{
+	struct nlmsghdr *hdr;
+	struct nl_msg *msg;
+	FILE *f;
+	int i, ret = 0;
+
+	f = fopen(file, "w");
+	if (!f) {
+		perror(file);
+		return 1;
+	}
+
+	for (i = 0; i < count && !ret; i++) {
+		/* large enough for the IEs, unlike the default page size */
+		msg = nlmsg_alloc_size(4096);
+		if (!msg) {
+			ret = 1;
+			break;
+		}
+
+		genlmsg_put(msg, 0, 1, 0x1c, 0, NLM_F_MULTI, shapes[shape].cmd, 0);
+		shapes[shape].put(msg, i);
+
+		hdr = nlmsg_hdr(msg);
+		if (fwrite(hdr, 1, NLMSG_ALIGN(hdr->nlmsg_len), f) !=
+		    NLMSG_ALIGN(hdr->nlmsg_len))
+			ret = 1;
+		nlmsg_free(msg);
+	}
+
+	if (fclose(f) || ret) {
+		fprintf(stderr, "%s: write failed\n", file);
+		return 1;
+	}
+
+	return 0;
+}
+
+struct nested_cp {
+	struct nla_cpolicy *msg;
+	struct nla_cpolicy *inner;
+	struct nla_cpolicy *rate;
+};
+
+static void nested_cp_free(struct nested_cp *cp)
+{
+	if (cp->msg)
+		nla_policy_free(cp->msg);
+	if (cp->inner)
+		nla_policy_free(cp->inner);
+	if (cp->rate)
+		nla_policy_free(cp->rate);
+}
+
+static int nested_cp_compile(struct nested_cp *cp, int shape)
+{
+	struct nla_nest_policy nests[2];
+
+	memset(cp, 0, sizeof(*cp));
+
+	if (shape == SHAPE_SCAN) {
+		cp->inner = nla_policy_compile(bss_policy, NL80211_BSS_MAX,
+					       NULL, 0);
+		nests[0].type = NL80211_ATTR_BSS;
+	} else {
+		cp->rate = nla_policy_compile(rate_policy, NL80211_RATE_INFO_MAX,
+					      NULL, 0);
+		if (!cp->rate)
+			return -1;
+
+		nests[0].type = NL80211_STA_INFO_TX_BITRATE;
+		nests[0].policy = cp->rate;
+		nests[1].type = NL80211_STA_INFO_RX_BITRATE;
+		nests[1].policy = cp->rate;
+		cp->inner = nla_policy_compile(sta_policy, NL80211_STA_INFO_MAX,
+					       nests, 2);
+		nests[0].type = NL80211_ATTR_STA_INFO;
+	}
+
+	if (!cp->inner)
+		return -1;
+
+	nests[0].policy = cp->inner;
+	cp->msg = nla_policy_compile(NULL, NL80211_ATTR_MAX, nests, 1);
+
+	return cp->msg ? 0 : -1;
+}
+
+/*
+ * Reads the signal, and for stations the rx bitrate as well. Returns the
+ * number of values found, so nothing can be optimized away.
+ */
+static int nested_parse(struct nlattr *head, int len, int shape,
+			struct nlattr **tb)
+{
+	struct nlattr *inner[NL80211_STA_INFO_MAX + NL80211_BSS_MAX + 2];
+	struct nlattr *rate[NL80211_RATE_INFO_MAX + 1];
+
+	nla_parse(tb, NL80211_ATTR_MAX, head, len, NULL);
+
+	if (shape == SHAPE_SCAN) {
+		if (!tb[NL80211_ATTR_BSS] ||
+		    nla_parse_nested(inner, NL80211_BSS_MAX, tb[NL80211_ATTR_BSS],
+				     bss_policy))
+			return 0;
+
+		return !!inner[NL80211_BSS_SIGNAL_MBM];
+	}
+
+	if (!tb[NL80211_ATTR_STA_INFO] ||
+	    nla_parse_nested(inner, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], sta_policy))
+		return 0;
+
+	if (!inner[NL80211_STA_INFO_RX_BITRATE] ||
+	    nla_parse_nested(rate, NL80211_RATE_INFO_MAX,
+			     inner[NL80211_STA_INFO_RX_BITRATE], rate_policy))
+		return !!inner[NL80211_STA_INFO_SIGNAL];
+
+	return !!inner[NL80211_STA_INFO_SIGNAL] +
+	       !!rate[NL80211_RATE_INFO_BITRATE32];
+}
+
+static int nested_compiled(struct nlattr *head, int len, int shape,
+			   const struct nested_cp *cp, struct nlattr **tb)
+{
+	struct nlattr **inner, **rate;
+
+	if (nla_parse_compiled(tb, head, len, cp->msg))
+		return 0;
+
+	if (shape == SHAPE_SCAN) {
+		inner = nla_nested_tb(cp->msg, tb, NL80211_ATTR_BSS);
+		return !!inner[NL80211_BSS_SIGNAL_MBM];
+	}
+
+	inner = nla_nested_tb(cp->msg, tb, NL80211_ATTR_STA_INFO);
+	rate = nla_nested_tb(cp->inner, inner, NL80211_STA_INFO_RX_BITRATE);
+
+	return !!inner[NL80211_STA_INFO_SIGNAL] +
+	       !!rate[NL80211_RATE_INFO_BITRATE32];
+}
+
+static struct nlattr *iter_find(struct nlattr *head, int len, int type,
+				const struct nla_cpolicy *cp)
+{
+	struct nla_iter it;
+	struct nlattr *nla;
+
+	nla_iter_init(&it, head, len, cp);
+	while ((nla = nla_iter_next(&it)))
+		if (nla_type(nla) == type)
+			return nla;
+
+	return NULL;
+}
+
+static int nested_iter(struct nlattr *head, int len, int shape,
+		       const struct nested_cp *cp)
+{
+	struct nlattr *outer, *nla, *signal = NULL, *rate = NULL;
+	struct nla_iter it;
+	int found;
+
+	outer = iter_find(head, len, shape == SHAPE_SCAN ? NL80211_ATTR_BSS :
+			  NL80211_ATTR_STA_INFO, cp->msg);
+	if (!outer)
+		return 0;
+
+	if (shape == SHAPE_SCAN)
+		return !!iter_find(nla_data(outer), nla_len(outer),
+				   NL80211_BSS_SIGNAL_MBM, cp->inner);
+
+	/* both are wanted, so walk the station info once */
+	nla_iter_init(&it, nla_data(outer), nla_len(outer), cp->inner);
+	while ((nla = nla_iter_next(&it)) && !(signal && rate)) {
+		if (nla_type(nla) == NL80211_STA_INFO_SIGNAL)
+			signal = nla;
+		else if (nla_type(nla) == NL80211_STA_INFO_RX_BITRATE)
+			rate = nla;
+	}
+
+	found = !!signal;
+	if (rate && iter_find(nla_data(rate), nla_len(rate),
+			      NL80211_RATE_INFO_BITRATE32, cp->rate))
+		found++;
+
+	return found;
+}
+
+static int run_nested(struct dump *d, int mode, int count, int shape,
+		      const struct nested_cp *cp, struct nlattr **tb)
+{
+	struct genlmsghdr *gnlh;
+	struct nlmsghdr *hdr;
+	int i, rem, found = 0;
+
+	for (i = 0; i < count; i++) {
+		hdr = (struct nlmsghdr *) d->buf;
+		rem = d->len;
+		while ((gnlh = dump_next(&hdr, &rem))) {
+			struct nlattr *head = genlmsg_attrdata(gnlh, 0);
+			int len = genlmsg_attrlen(gnlh, 0);
+
+			switch (mode) {
+			case BENCH_PARSE:
+				found += nested_parse(head, len, shape, tb);
+				break;
+			case BENCH_COMPILED:
+				found += nested_compiled(head, len, shape, cp, tb);
+				break;
+			default:
+				found += nested_iter(head, len, shape, cp);
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+static int bench_nested(const char *file, int count, int shape)
+{
+	struct nested_cp cp;
+	struct nlattr **tb = NULL;
+	struct dump d;
+	int mode, found, ret = 1;
+
+	if (load(file, &d))
+		return 1;
+
+	if (nested_cp_compile(&cp, shape))
+		goto out;
+
+	tb = calloc(nla_cpolicy_tb_size(cp.msg), sizeof(*tb));
+	if (!tb)
+		goto out;
+
+	printf("%s: %d %s messages, %d bytes, index of %d entries\n",
+	       file, d.count, shapes[shape].name, d.len,
+	       nla_cpolicy_tb_size(cp.msg));
+
+	for (mode = 0; mode < __BENCH_MAX; mode++) {
+		double start = now();
+
+		found = run_nested(&d, mode, count, shape, &cp, tb);
+		printf("  %-10s %8.1f ns/message, %d values found\n",
+		       bench_names[mode],
+		       (now() - start) / ((double) count * d.count) * 1e9,
+		       found / count);
+	}
+
+	ret = 0;
+
+out:
+	free(tb);
+	nested_cp_free(&cp);
+	free(d.buf);
+	return ret;
+}
+
+static int usage(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [-n <count>] [-t <type>] [-m <maxtype>] <file>...\n"
+		"       %s [-n <count>] -p scan|station <file>...\n"
+		"       %s -w <file> <family> <command>\n"
+		"       %s -g <file> scan|station <messages>\n",
+		progname, progname, progname, progname);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out = NULL, *gen = NULL;
+	int count = 10000;
+	int type = 0, maxtype = 0, shape = -1;
+	int i, ch;
+
+	while ((ch = getopt(argc, argv, "g:m:n:p:t:w:")) != -1) {
+		switch (ch) {
+		case 'g':
+			gen = optarg;
+			break;
+		case 'p':
+			shape = shape_find(optarg);
+			if (shape < 0)
+				return usage(argv[0]);
+			break;
+		case 'm':
+			maxtype = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 't':
+			type = atoi(optarg);
+			break;
+		case 'w':
+			out = optarg;
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (out) {
+		if (optind + 2 != argc)
+			return usage(argv[0]);
+
+		return capture(out, argv[optind], atoi(argv[optind + 1]));
+	}
+
+	if (gen) {
+		if (optind + 2 != argc)
+			return usage(argv[0]);
+
+		shape = shape_find(argv[optind]);
+		if (shape < 0 || atoi(argv[optind + 1]) < 1)
+			return usage(argv[0]);
+
+		return generate(gen, shape, atoi(argv[optind + 1]));
+	}
+
+	if (optind == argc || count < 1 || type < 0 || maxtype < 0)
+		return usage(argv[0]);
+
+	for (i = optind; i < argc; i++) {
+		if (shape >= 0 ? bench_nested(argv[i], count, shape) :
+				 bench(argv[i], count, type, maxtype))
+			return 1;
+	}
+
+	return 0;
+}
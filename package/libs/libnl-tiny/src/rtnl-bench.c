@@ -0,0 +1,197 @@
+/*
+ * rtnl-bench.c		rtnetlink request benchmark
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ *
+ * Copyright (c) 2018 OpenWrt.org
+ *
+ * Adds and deletes a number of IPv4 addresses on an interface, e.g. a
+ * dummy one created with "ip link add bench0 type dummy", once with one
+ * request and ACK at a time and once through nl_batch, and reports the
+ * requests per second of each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/rtnetlink.h>
+
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct nl_msg *addr_msg(int cmd, int ifindex, int i)
+{
+	struct ifaddrmsg ifa = {
+		.ifa_family = AF_INET,
+		.ifa_prefixlen = 32,
+		.ifa_index = ifindex,
+	};
+	struct nl_msg *msg;
+	uint32_t addr;
+	int flags = 0;
+
+	if (cmd == RTM_NEWADDR)
+		flags = NLM_F_CREATE | NLM_F_EXCL;
+
+	msg = nlmsg_alloc_simple(cmd, flags);
+	if (!msg)
+		return NULL;
+
+	/* 10.200.0.1 onwards */
+	addr = htonl(0x0ac80000 + i + 1);
+
+	if (nlmsg_append(msg, &ifa, sizeof(ifa), 0) ||
+	    nla_put_u32(msg, IFA_LOCAL, addr) ||
+	    nla_put_u32(msg, IFA_ADDRESS, addr)) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+
+	return msg;
+}
+
+static int run_single(struct nl_sock *sk, int cmd, int ifindex, int count)
+{
+	struct nl_msg *msg;
+	int i, err, failed = 0;
+
+	for (i = 0; i < count; i++) {
+		msg = addr_msg(cmd, ifindex, i);
+		if (!msg)
+			return -NLE_NOMEM;
+
+		err = nl_send_auto_complete(sk, msg);
+		nlmsg_free(msg);
+		if (err < 0)
+			return err;
+
+		if (nl_wait_for_ack(sk) < 0)
+			failed++;
+	}
+
+	return failed;
+}
+
+static int run_batch(struct nl_sock *sk, int cmd, int ifindex, int count)
+{
+	struct nl_batch *b;
+	struct nl_msg *msg;
+	int i, err, failed = 0;
+
+	b = nl_batch_alloc(sk);
+	if (!b)
+		return -NLE_NOMEM;
+
+	for (i = 0; i < count; i++) {
+		msg = addr_msg(cmd, ifindex, i);
+		if (!msg) {
+			nl_batch_free(b);
+			return -NLE_NOMEM;
+		}
+
+		err = nl_batch_add(b, msg);
+		nlmsg_free(msg);
+		if (err < 0) {
+			nl_batch_free(b);
+			return err;
+		}
+	}
+
+	err = nl_batch_commit(b);
+	for (i = 0; !err && i < count; i++)
+		if (nl_batch_error(b, i))
+			failed++;
+
+	nl_batch_free(b);
+
+	return err < 0 ? err : failed;
+}
+
+static int run(struct nl_sock *sk, const char *name, int batch,
+	       int ifindex, int count)
+{
+	static const int cmds[] = { RTM_NEWADDR, RTM_DELADDR };
+	int i, ret;
+
+	for (i = 0; i < 2; i++) {
+		double start = now();
+
+		if (batch)
+			ret = run_batch(sk, cmds[i], ifindex, count);
+		else
+			ret = run_single(sk, cmds[i], ifindex, count);
+
+		if (ret < 0) {
+			fprintf(stderr, "%s: %s\n", name, nl_geterror(ret));
+			return 1;
+		}
+
+		printf("%-6s %s: %6d requests, %d failed, %9.0f requests/s\n",
+		       name, cmds[i] == RTM_NEWADDR ? "add" : "del", count, ret,
+		       count / (now() - start));
+	}
+
+	return 0;
+}
+
+static int usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [-n <count>] <interface>\n", progname);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct nl_sock *sk;
+	int count = 2000;
+	int ifindex, ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (optind + 1 != argc || count < 1 || count > 0xffff)
+		return usage(argv[0]);
+
+	ifindex = if_nametoindex(argv[optind]);
+	if (!ifindex) {
+		fprintf(stderr, "Unknown interface %s\n", argv[optind]);
+		return 1;
+	}
+
+	sk = nl_socket_alloc();
+	if (!sk || nl_connect(sk, NETLINK_ROUTE)) {
+		fprintf(stderr, "Failed to connect to rtnetlink\n");
+		return 1;
+	}
+
+	if (run(sk, "single", 0, ifindex, count) ||
+	    run(sk, "batch", 1, ifindex, count))
+		return 1;
+
+	nl_socket_free(sk);
+
+	return 0;
+}
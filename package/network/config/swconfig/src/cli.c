@@ -44,6 +44,9 @@ enum {
 	CMD_PORTMAP,
 };
 
+/* print counter arrays as a table instead of a per port listing */
+static int machine_readable;
+
 static void
 print_attrs(const struct switch_attr *attr)
 {
@@ -63,6 +66,9 @@ print_attrs(const struct switch_attr *attr)
 			case SWITCH_TYPE_NOVAL:
 				type = "none";
 				break;
+			case SWITCH_TYPE_COUNTERS:
+				type = "counters";
+				break;
 			default:
 				type = "unknown";
 				break;
@@ -101,6 +107,35 @@ speed_str(int speed)
 	return "unknown";
 }
 
+static void
+print_counters(const struct switch_counters *c)
+{
+	int i, j;
+
+	if (!c->names)
+		return;
+
+	if (machine_readable) {
+		printf("port");
+		for (j = 0; j < c->n_counters; j++)
+			printf("\t%s", c->names[j]);
+
+		for (i = 0; i < c->n_ports; i++) {
+			printf("\n%d", i);
+			for (j = 0; j < c->n_counters; j++)
+				printf("\t%" PRIu64, c->values[i * c->n_counters + j]);
+		}
+		return;
+	}
+
+	for (i = 0; i < c->n_ports; i++) {
+		printf("\nPort %d:", i);
+		for (j = 0; j < c->n_counters; j++)
+			printf("\n\t%-12s: %" PRIu64, c->names[j],
+			       c->values[i * c->n_counters + j]);
+	}
+}
+
 static void
 print_attr_val(const struct switch_attr *attr, const struct switch_val *val)
 {
@@ -137,6 +172,9 @@ print_attr_val(const struct switch_attr *attr, const struct switch_val *val)
 		else
 			printf("port:%d link:down", val->port_vlan);
 		break;
+	case SWITCH_TYPE_COUNTERS:
+		print_counters(val->value.counters);
+		break;
 	default:
 		printf("?unknown-type?");
 	}
@@ -146,7 +184,9 @@ static void
 show_attrs(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *val)
 {
 	while (attr) {
-		if (attr->type != SWITCH_TYPE_NOVAL) {
+		/* counter snapshots are only fetched with get, like the mib text */
+		if (attr->type != SWITCH_TYPE_NOVAL &&
+		    attr->type != SWITCH_TYPE_COUNTERS) {
 			printf("\t%s: ", attr->name);
 			if (swlib_get_attr(dev, attr, val) < 0)
 				printf("???");
@@ -202,7 +242,8 @@ static void
 print_usage(void)
 {
 	printf("swconfig list\n");
-	printf("swconfig dev <dev> [port <port>|vlan <vlan>] (help|set <key> <value>|get <key>|load <config>|show)\n");
+	printf("swconfig [-m] dev <dev> [port <port>|vlan <vlan>] (help|set <key> <value>|get <key>|load <config>|show)\n");
+	printf("  -m: print counter attributes as a tab separated table\n");
 	exit(1);
 }
 
@@ -248,6 +289,12 @@ int main(int argc, char **argv)
 	char *cvalue = NULL;
 	char *csegment = NULL;
 
+	if ((argc > 1) && !strcmp(argv[1], "-m")) {
+		machine_readable = 1;
+		argv++;
+		argc--;
+	}
+
 	if((argc == 2) && !strcmp(argv[1], "list")) {
 		swlib_list();
 		return 0;
@@ -355,6 +402,8 @@ int main(int argc, char **argv)
 		}
 		print_attr_val(a, &val);
 		putchar('\n');
+		if (a->type == SWITCH_TYPE_COUNTERS)
+			swlib_free_counters(val.value.counters);
 		break;
 	case CMD_LOAD:
 		swconfig_load_uci(dev, ckey);
@@ -20,8 +20,10 @@
 #include <errno.h>
 #include <stdint.h>
 #include <getopt.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <linux/switch.h>
 #include "swlib.h"
 #include <netlink/netlink.h>
@@ -36,10 +38,25 @@
 #endif
 
 static struct nl_sock *handle;
-static struct nl_cache *cache;
 static struct genl_family *family;
 static struct nlattr *tb[SWITCH_ATTR_MAX + 1];
 static int refcount = 0;
+static int batch_unsupported = 0;
+
+/*
+ * Batched set operations are collected in a scratch netlink message
+ * without a genl header and copied into a SWITCH_CMD_SET_BATCH request
+ * when the batch is flushed. The error ACK for a request echoes the
+ * request itself, so keep it well below the netlink receive buffer.
+ */
+#define SWLIB_BATCH_SIZE	8192
+
+struct swlib_batch {
+	struct switch_dev *dev;
+	struct nl_msg *msg;
+	int apply;
+	int err;
+};
 
 static struct nla_policy port_policy[SWITCH_ATTR_MAX] = {
 	[SWITCH_PORT_ID] = { .type = NLA_U32 },
@@ -51,6 +68,11 @@ static struct nla_policy portmap_policy[SWITCH_PORTMAP_MAX] = {
 	[SWITCH_PORTMAP_VIRT] = { .type = NLA_U32 },
 };
 
+static struct nla_policy counters_policy[SWITCH_COUNTERS_ATTR_MAX] = {
+	[SWITCH_COUNTERS_PORT_ID] = { .type = NLA_U32 },
+	[SWITCH_COUNTERS_VALUES] = { .type = NLA_UNSPEC },
+};
+
 static struct nla_policy link_policy[SWITCH_LINK_ATTR_MAX] = {
 	[SWITCH_LINK_FLAG_LINK] = { .type = NLA_FLAG },
 	[SWITCH_LINK_FLAG_DUPLEX] = { .type = NLA_FLAG },
@@ -85,8 +107,8 @@ wait_handler(struct nl_msg *msg, void *arg)
 
 /* helper function for performing netlink requests */
 static int
-swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
-		int (*data)(struct nl_msg *, void *), void *arg)
+swlib_call_size(int cmd, int (*call)(struct nl_msg *, void *),
+		int (*data)(struct nl_msg *, void *), void *arg, size_t size)
 {
 	struct nl_msg *msg;
 	struct nl_cb *cb = NULL;
@@ -94,7 +116,10 @@ swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
 	int flags = 0;
 	int err;
 
-	msg = nlmsg_alloc();
+	if (size)
+		msg = nlmsg_alloc_size(size);
+	else
+		msg = nlmsg_alloc();
 	if (!msg) {
 		fprintf(stderr, "Out of memory!\n");
 		exit(1);
@@ -147,6 +172,13 @@ nla_put_failure:
 	return err;
 }
 
+static int
+swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
+		int (*data)(struct nl_msg *, void *), void *arg)
+{
+	return swlib_call_size(cmd, call, data, arg, 0);
+}
+
 static int
 send_attr(struct nl_msg *msg, void *arg)
 {
@@ -241,11 +273,103 @@ out:
 	return err;
 }
 
+static int
+store_counters_val(struct nl_msg *msg, struct nlattr *nla, struct switch_val *val)
+{
+	struct switch_counters *counters;
+	struct nlattr *p, *n;
+	int rem, nrem;
+
+	counters = swlib_alloc(sizeof(*counters));
+	if (!counters)
+		return -ENOMEM;
+
+	counters->n_ports = val->attr->dev->ports;
+
+	nla_for_each_nested(p, nla, rem) {
+		struct nlattr *tb[SWITCH_COUNTERS_ATTR_MAX];
+		unsigned int port;
+		int len;
+
+		switch (nla_type(p)) {
+		case SWITCH_COUNTERS_NAMES:
+			if (counters->names)
+				break;
+
+			nla_for_each_nested(n, p, nrem)
+				counters->n_counters++;
+
+			counters->names = swlib_alloc(counters->n_counters * sizeof(char *));
+			counters->values = swlib_alloc(counters->n_ports *
+				counters->n_counters * sizeof(uint64_t));
+			if (!counters->names || !counters->values)
+				goto nomem;
+
+			counters->n_counters = 0;
+			nla_for_each_nested(n, p, nrem) {
+				char *name = strdup(nla_get_string(n));
+
+				if (!name)
+					goto nomem;
+
+				counters->names[counters->n_counters++] = name;
+			}
+			break;
+		case SWITCH_COUNTERS_PORT:
+			if (!counters->values)
+				break;
+
+			if (nla_parse_nested(tb, SWITCH_COUNTERS_ATTR_MAX - 1, p, counters_policy) < 0)
+				break;
+
+			if (!tb[SWITCH_COUNTERS_PORT_ID] || !tb[SWITCH_COUNTERS_VALUES])
+				break;
+
+			port = nla_get_u32(tb[SWITCH_COUNTERS_PORT_ID]);
+			if (port >= counters->n_ports)
+				break;
+
+			len = nla_len(tb[SWITCH_COUNTERS_VALUES]);
+			if (len > counters->n_counters * sizeof(uint64_t))
+				len = counters->n_counters * sizeof(uint64_t);
+
+			memcpy(&counters->values[port * counters->n_counters],
+			       nla_data(tb[SWITCH_COUNTERS_VALUES]), len);
+			break;
+		}
+	}
+
+	val->value.counters = counters;
+	return 0;
+
+nomem:
+	/* names holds n_counters entries, zeroed beyond the strdup'ed ones */
+	swlib_free_counters(counters);
+	return -ENOMEM;
+}
+
+void
+swlib_free_counters(struct switch_counters *counters)
+{
+	int i;
+
+	if (!counters)
+		return;
+
+	for (i = 0; counters->names && i < counters->n_counters; i++)
+		free(counters->names[i]);
+
+	free(counters->names);
+	free(counters->values);
+	free(counters);
+}
+
 static int
 store_val(struct nl_msg *msg, void *arg)
 {
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct switch_val *val = arg;
+	int err = 0;
 
 	if (!val)
 		goto error;
@@ -260,11 +384,13 @@ store_val(struct nl_msg *msg, void *arg)
 	else if (tb[SWITCH_ATTR_OP_VALUE_STR])
 		val->value.s = strdup(nla_get_string(tb[SWITCH_ATTR_OP_VALUE_STR]));
 	else if (tb[SWITCH_ATTR_OP_VALUE_PORTS])
-		val->err = store_port_val(msg, tb[SWITCH_ATTR_OP_VALUE_PORTS], val);
+		err = store_port_val(msg, tb[SWITCH_ATTR_OP_VALUE_PORTS], val);
 	else if (tb[SWITCH_ATTR_OP_VALUE_LINK])
-		val->err = store_link_val(msg, tb[SWITCH_ATTR_OP_VALUE_LINK], val);
+		err = store_link_val(msg, tb[SWITCH_ATTR_OP_VALUE_LINK], val);
+	else if (tb[SWITCH_ATTR_OP_VALUE_COUNTERS])
+		err = store_counters_val(msg, tb[SWITCH_ATTR_OP_VALUE_COUNTERS], val);
 
-	val->err = 0;
+	val->err = err;
 	return 0;
 
 error:
@@ -397,29 +523,232 @@ nla_put_failure:
 	return -1;
 }
 
-int
-swlib_set_attr(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *val)
+static int
+set_attr_cmd(struct switch_attr *attr)
 {
-	int cmd;
-
 	switch(attr->atype) {
 	case SWLIB_ATTR_GROUP_GLOBAL:
-		cmd = SWITCH_CMD_SET_GLOBAL;
-		break;
+		return SWITCH_CMD_SET_GLOBAL;
 	case SWLIB_ATTR_GROUP_PORT:
-		cmd = SWITCH_CMD_SET_PORT;
-		break;
+		return SWITCH_CMD_SET_PORT;
 	case SWLIB_ATTR_GROUP_VLAN:
-		cmd = SWITCH_CMD_SET_VLAN;
-		break;
+		return SWITCH_CMD_SET_VLAN;
 	default:
 		return -EINVAL;
 	}
+}
+
+int
+swlib_set_attr(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *val)
+{
+	int cmd;
+
+	cmd = set_attr_cmd(attr);
+	if (cmd < 0)
+		return cmd;
 
 	val->attr = attr;
 	return swlib_call(cmd, NULL, send_attr_val, val);
 }
 
+struct swlib_batch *
+swlib_batch_alloc(struct switch_dev *dev)
+{
+	struct swlib_batch *batch;
+
+	batch = swlib_alloc(sizeof(*batch));
+	if (!batch)
+		return NULL;
+
+	batch->dev = dev;
+	if (batch_unsupported)
+		return batch;
+
+	batch->msg = nlmsg_alloc_size(SWLIB_BATCH_SIZE);
+	if (!batch->msg) {
+		free(batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+static int
+send_batch(struct nl_msg *msg, void *arg)
+{
+	struct swlib_batch *batch = arg;
+
+	NLA_PUT_U32(msg, SWITCH_ATTR_ID, batch->dev->id);
+	if (nla_put_nested(msg, SWITCH_ATTR_BATCH, batch->msg) < 0)
+		goto nla_put_failure;
+	if (batch->apply)
+		NLA_PUT_FLAG(msg, SWITCH_ATTR_BATCH_APPLY);
+
+	return 0;
+
+nla_put_failure:
+	return -1;
+}
+
+static int
+send_batch_op(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *op = arg;
+	struct nlattr *nla;
+	int rem;
+
+	nla_for_each_nested(nla, op, rem) {
+		if (nla_type(nla) == SWITCH_ATTR_BATCH_CMD)
+			continue;
+
+		if (nla_put(msg, nla_type(nla), nla_len(nla), nla_data(nla)) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* replay a batch as individual set requests for kernels without batch support */
+static int
+swlib_batch_replay(struct swlib_batch *batch)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(batch->msg);
+	struct nlattr *op, *cmd;
+	int err = 0;
+	int rem;
+
+	nla_for_each_attr(op, nlmsg_data(hdr), nlmsg_len(hdr), rem) {
+		int ret;
+
+		cmd = nla_find(nla_data(op), nla_len(op), SWITCH_ATTR_BATCH_CMD);
+		if (!cmd)
+			continue;
+
+		ret = swlib_call(nla_get_u32(cmd), NULL, send_batch_op, op);
+		if (ret && !err)
+			err = ret;
+	}
+
+	if (batch->apply) {
+		struct switch_attr *attr;
+		struct switch_val val;
+		int ret;
+
+		attr = swlib_lookup_attr(batch->dev, SWLIB_ATTR_GROUP_GLOBAL, "apply");
+		if (attr) {
+			memset(&val, 0, sizeof(val));
+			ret = swlib_set_attr(batch->dev, attr, &val);
+			if (ret && !err)
+				err = ret;
+		}
+	}
+
+	return err;
+}
+
+static int
+swlib_batch_flush(struct swlib_batch *batch)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(batch->msg);
+	int err;
+
+	if (!nlmsg_len(hdr) && !batch->apply)
+		return 0;
+
+	if (!batch_unsupported) {
+		err = swlib_call_size(SWITCH_CMD_SET_BATCH, NULL, send_batch, batch,
+				      SWLIB_BATCH_SIZE + 256);
+		if (err == -NLE_OPNOTSUPP)
+			batch_unsupported = 1;
+	}
+
+	if (batch_unsupported)
+		err = swlib_batch_replay(batch);
+
+	hdr->nlmsg_len = NLMSG_HDRLEN;
+
+	return err;
+}
+
+static int
+swlib_batch_put(struct swlib_batch *batch, int cmd, struct switch_val *val)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(batch->msg);
+	uint32_t len = hdr->nlmsg_len;
+	struct nlattr *n;
+
+	n = nla_nest_start(batch->msg, SWITCH_ATTR_BATCH_OP);
+	if (!n)
+		goto nla_put_failure;
+	NLA_PUT_U32(batch->msg, SWITCH_ATTR_BATCH_CMD, cmd);
+	if (send_attr_val(batch->msg, val) < 0)
+		goto nla_put_failure;
+	nla_nest_end(batch->msg, n);
+
+	return 0;
+
+nla_put_failure:
+	hdr->nlmsg_len = len;
+	return -1;
+}
+
+int
+swlib_batch_set_attr(struct swlib_batch *batch, struct switch_attr *attr,
+		struct switch_val *val)
+{
+	int err;
+	int cmd;
+
+	cmd = set_attr_cmd(attr);
+	if (cmd < 0)
+		return cmd;
+
+	if (!batch->msg)
+		return swlib_set_attr(batch->dev, attr, val);
+
+	val->attr = attr;
+	if (!swlib_batch_put(batch, cmd, val))
+		return 0;
+
+	/* batch is full, send it off and start a new one */
+	err = swlib_batch_flush(batch);
+	if (err && !batch->err)
+		batch->err = err;
+
+	if (!swlib_batch_put(batch, cmd, val))
+		return 0;
+
+	/* does not fit into an empty batch either */
+	return swlib_set_attr(batch->dev, attr, val);
+}
+
+int
+swlib_batch_commit(struct swlib_batch *batch, int apply)
+{
+	int err = 0;
+
+	if (batch->msg) {
+		batch->apply = apply;
+		err = swlib_batch_flush(batch);
+		nlmsg_free(batch->msg);
+	} else if (apply) {
+		struct switch_attr *attr;
+		struct switch_val val;
+
+		attr = swlib_lookup_attr(batch->dev, SWLIB_ATTR_GROUP_GLOBAL, "apply");
+		if (attr) {
+			memset(&val, 0, sizeof(val));
+			err = swlib_set_attr(batch->dev, attr, &val);
+		}
+	}
+
+	if (batch->err)
+		err = batch->err;
+
+	free(batch);
+	return err;
+}
+
 enum {
 	CMD_NONE,
 	CMD_DUPLEX,
@@ -427,7 +756,9 @@ enum {
 	CMD_SPEED,
 };
 
-int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *a, int port_vlan, const char *str)
+static int
+__swlib_set_attr_string(struct switch_dev *dev, struct swlib_batch *batch,
+		struct switch_attr *a, int port_vlan, const char *str)
 {
 	struct switch_port *ports;
 	struct switch_port_link *link;
@@ -529,9 +860,22 @@ int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *a, int por
 	default:
 		return -1;
 	}
+	if (batch)
+		return swlib_batch_set_attr(batch, a, &val);
+
 	return swlib_set_attr(dev, a, &val);
 }
 
+int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *a, int port_vlan, const char *str)
+{
+	return __swlib_set_attr_string(dev, NULL, a, port_vlan, str);
+}
+
+int swlib_batch_set_attr_string(struct swlib_batch *batch, struct switch_attr *a, int port_vlan, const char *str)
+{
+	return __swlib_set_attr_string(batch->dev, batch, a, port_vlan, str);
+}
+
 
 struct attrlist_arg {
 	int id;
@@ -553,20 +897,14 @@ nla_put_failure:
 	return -1;
 }
 
-static int
-add_attr(struct nl_msg *msg, void *ptr)
+static struct switch_attr *
+append_attr(struct attrlist_arg *arg)
 {
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	struct attrlist_arg *arg = ptr;
 	struct switch_attr *new;
 
-	if (nla_parse(tb, SWITCH_ATTR_MAX - 1, genlmsg_attrdata(gnlh, 0),
-			genlmsg_attrlen(gnlh, 0), NULL) < 0)
-		goto done;
-
 	new = swlib_alloc(sizeof(struct switch_attr));
 	if (!new)
-		goto done;
+		return NULL;
 
 	new->dev = arg->dev;
 	new->atype = arg->atype;
@@ -578,6 +916,24 @@ add_attr(struct nl_msg *msg, void *ptr)
 	*arg->head = new;
 	arg->head = &new->next;
 
+	return new;
+}
+
+static int
+add_attr(struct nl_msg *msg, void *ptr)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct attrlist_arg *arg = ptr;
+	struct switch_attr *new;
+
+	if (nla_parse(tb, SWITCH_ATTR_MAX - 1, genlmsg_attrdata(gnlh, 0),
+			genlmsg_attrlen(gnlh, 0), NULL) < 0)
+		goto done;
+
+	new = append_attr(arg);
+	if (!new)
+		goto done;
+
 	if (tb[SWITCH_ATTR_OP_ID])
 		new->id = nla_get_u32(tb[SWITCH_ATTR_OP_ID]);
 	if (tb[SWITCH_ATTR_OP_TYPE])
@@ -591,30 +947,188 @@ done:
 	return NL_SKIP;
 }
 
+/*
+ * The attribute lists of a switch only change when its driver is loaded
+ * again or the driver reports a new attribute set generation, so they are
+ * kept in a file on tmpfs and later invocations of swconfig can skip the
+ * three list dumps. The cache is keyed by device name, switch id, driver
+ * name and generation; kernels without generation support are not cached.
+ */
+#define SWLIB_CACHE_DIR		"/var/run/swconfig"
+#define SWLIB_CACHE_MAGIC	"swconfig-schema 1"
+
+static void swlib_free_attributes(struct switch_attr **head);
+
+static struct switch_attr **
+attr_group_head(struct switch_dev *dev, int atype)
+{
+	switch (atype) {
+	case SWLIB_ATTR_GROUP_GLOBAL:
+		return &dev->ops;
+	case SWLIB_ATTR_GROUP_PORT:
+		return &dev->port_ops;
+	case SWLIB_ATTR_GROUP_VLAN:
+		return &dev->vlan_ops;
+	}
+
+	return NULL;
+}
+
+static void
+swlib_cache_path(struct switch_dev *dev, char *path, size_t len, const char *suffix)
+{
+	snprintf(path, len, SWLIB_CACHE_DIR "/%s%s", dev->dev_name, suffix);
+}
+
+static int
+swlib_cache_load(struct switch_dev *dev)
+{
+	struct attrlist_arg arg[3];
+	struct switch_attr *new;
+	char path[64];
+	char *line = NULL;
+	size_t size = 0;
+	unsigned int id, gen;
+	int atype, aid, atype_val, off, i;
+	int err = -1;
+	FILE *f;
+
+	if (!dev->generation)
+		return -1;
+
+	swlib_cache_path(dev, path, sizeof(path), "");
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	if (getline(&line, &size, f) < 0 ||
+	    sscanf(line, SWLIB_CACHE_MAGIC " %u %u %n", &id, &gen, &off) < 2 ||
+	    id != dev->id || gen != dev->generation)
+		goto out;
+
+	line[strcspn(line, "\n")] = 0;
+	if (strcmp(line + off, dev->name ? dev->name : ""))
+		goto out;
+
+	for (i = 0; i < 3; i++) {
+		arg[i].atype = i;
+		arg[i].dev = dev;
+		arg[i].prev = NULL;
+		arg[i].head = attr_group_head(dev, i);
+	}
+
+	while (getline(&line, &size, f) > 0) {
+		char *name, *desc;
+
+		line[strcspn(line, "\n")] = 0;
+		if (sscanf(line, "%d %d %d %n", &atype, &aid, &atype_val, &off) < 3 ||
+		    atype < 0 || atype > 2)
+			goto out;
+
+		name = line + off;
+		desc = strchr(name, '\t');
+		if (!desc)
+			goto out;
+		*desc++ = 0;
+
+		new = append_attr(&arg[atype]);
+		if (!new)
+			goto out;
+
+		new->id = aid;
+		new->type = atype_val;
+		new->name = strdup(name);
+		new->description = strdup(desc);
+
+		/* fall back to the list dumps rather than lose attributes */
+		if (!new->name || !new->description)
+			goto out;
+	}
+
+	err = 0;
+
+out:
+	if (err) {
+		swlib_free_attributes(&dev->ops);
+		swlib_free_attributes(&dev->port_ops);
+		swlib_free_attributes(&dev->vlan_ops);
+	}
+	free(line);
+	fclose(f);
+	return err;
+}
+
+static void
+swlib_cache_save(struct switch_dev *dev)
+{
+	struct switch_attr *a;
+	char path[64], tmp[64];
+	int i;
+	FILE *f;
+
+	if (!dev->generation)
+		return;
+
+	mkdir(SWLIB_CACHE_DIR, 0755);
+	swlib_cache_path(dev, tmp, sizeof(tmp), ".tmp");
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	fprintf(f, SWLIB_CACHE_MAGIC " %u %u %s\n", dev->id, dev->generation,
+		dev->name ? dev->name : "");
+
+	for (i = 0; i < 3; i++) {
+		for (a = *attr_group_head(dev, i); a; a = a->next)
+			fprintf(f, "%d %d %d %s\t%s\n", i, a->id, a->type,
+				a->name ? a->name : "",
+				a->description ? a->description : "");
+	}
+
+	if (fclose(f)) {
+		unlink(tmp);
+		return;
+	}
+
+	swlib_cache_path(dev, path, sizeof(path), "");
+	if (rename(tmp, path))
+		unlink(tmp);
+}
+
 int
 swlib_scan(struct switch_dev *dev)
 {
 	struct attrlist_arg arg;
+	int err = 0;
 
 	if (dev->ops || dev->port_ops || dev->vlan_ops)
 		return 0;
 
+	if (!swlib_cache_load(dev))
+		return 0;
+
 	arg.atype = SWLIB_ATTR_GROUP_GLOBAL;
 	arg.dev = dev;
 	arg.id = dev->id;
 	arg.prev = NULL;
 	arg.head = &dev->ops;
-	swlib_call(SWITCH_CMD_LIST_GLOBAL, add_attr, add_id, &arg);
+	if (swlib_call(SWITCH_CMD_LIST_GLOBAL, add_attr, add_id, &arg) < 0)
+		err = -1;
 
 	arg.atype = SWLIB_ATTR_GROUP_PORT;
 	arg.prev = NULL;
 	arg.head = &dev->port_ops;
-	swlib_call(SWITCH_CMD_LIST_PORT, add_attr, add_id, &arg);
+	if (swlib_call(SWITCH_CMD_LIST_PORT, add_attr, add_id, &arg) < 0)
+		err = -1;
 
 	arg.atype = SWLIB_ATTR_GROUP_VLAN;
 	arg.prev = NULL;
 	arg.head = &dev->vlan_ops;
-	swlib_call(SWITCH_CMD_LIST_VLAN, add_attr, add_id, &arg);
+	if (swlib_call(SWITCH_CMD_LIST_VLAN, add_attr, add_id, &arg) < 0)
+		err = -1;
+
+	if (!err)
+		swlib_cache_save(dev);
 
 	return 0;
 }
@@ -652,20 +1166,15 @@ swlib_priv_free(void)
 {
 	if (family)
 		nl_object_put((struct nl_object*)family);
-	if (cache)
-		nl_cache_free(cache);
 	if (handle)
 		nl_socket_free(handle);
 	family = NULL;
 	handle = NULL;
-	cache = NULL;
 }
 
 static int
 swlib_priv_init(void)
 {
-	int ret;
-
 	handle = nl_socket_alloc();
 	if (!handle) {
 		DPRINTF("Failed to create handle\n");
@@ -677,13 +1186,7 @@ swlib_priv_init(void)
 		goto err;
 	}
 
-	ret = genl_ctrl_alloc_cache(handle, &cache);
-	if (ret < 0) {
-		DPRINTF("Failed to allocate netlink cache\n");
-		goto err;
-	}
-
-	family = genl_ctrl_search_by_name(cache, "switch");
+	family = genl_ctrl_probe_by_name(handle, "switch");
 	if (!family) {
 		DPRINTF("Switch API not present\n");
 		goto err;
@@ -773,6 +1276,8 @@ add_switch(struct nl_msg *msg, void *arg)
 		dev->vlans = nla_get_u32(tb[SWITCH_ATTR_VLANS]);
 	if (tb[SWITCH_ATTR_CPU_PORT])
 		dev->cpu_port = nla_get_u32(tb[SWITCH_ATTR_CPU_PORT]);
+	if (tb[SWITCH_ATTR_GENERATION])
+		dev->generation = nla_get_u32(tb[SWITCH_ATTR_GENERATION]);
 	if (tb[SWITCH_ATTR_PORTMAP])
 		add_port_map(dev, tb[SWITCH_ATTR_PORTMAP]);
 
@@ -52,6 +52,15 @@ Usage of the library functions:
   switch_set_attr() and switch_get_attr() can alter or request the values
   of attributes.
 
+  To set many attributes at once, allocate a batch with
+    batch = swlib_batch_alloc(dev);
+  queue the settings with swlib_batch_set_attr() or
+  swlib_batch_set_attr_string() and send them with
+    swlib_batch_commit(batch, apply);
+  The settings are sent in as few netlink requests as possible and are
+  applied by the kernel in order, under a single lock of the switch.
+  If apply is set, the configuration is activated once at the end.
+
 Usage of the switch_attr struct:
 
   ->atype: attribute group, one of:
@@ -89,6 +98,9 @@ Usage of the switch_val struct:
   When getting string attributes, val->value.s must be freed by the caller
   When getting port list attributes, an internal static buffer is used,
   which changes from call to call.
+  When getting counter attributes (SWITCH_TYPE_COUNTERS), val->value.counters
+  holds one array of n_counters values per port, described by a name table.
+  It must be freed by the caller with swlib_free_counters().
 
  */
 
@@ -115,7 +127,9 @@ struct switch_attr;
 struct switch_port;
 struct switch_port_map;
 struct switch_port_link;
+struct switch_counters;
 struct switch_val;
+struct swlib_batch;
 struct uci_package;
 
 struct switch_dev {
@@ -126,6 +140,7 @@ struct switch_dev {
 	int ports;
 	int vlans;
 	int cpu_port;
+	unsigned int generation;
 	struct switch_attr *ops;
 	struct switch_attr *port_ops;
 	struct switch_attr *vlan_ops;
@@ -144,6 +159,7 @@ struct switch_val {
 		int i;
 		struct switch_port *ports;
 		struct switch_port_link *link;
+		struct switch_counters *counters;
 	} value;
 };
 
@@ -167,6 +183,14 @@ struct switch_portmap {
 	char *segment;
 };
 
+struct switch_counters {
+	int n_ports;
+	int n_counters;
+	char **names;
+	/* n_counters values for each port */
+	uint64_t *values;
+};
+
 struct switch_port_link {
 	int link:1;
 	int duplex:1;
@@ -248,6 +272,42 @@ int swlib_set_attr(struct switch_dev *dev, struct switch_attr *attr,
 int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *attr,
 		int port_vlan, const char *str);
 
+/**
+ * swlib_batch_alloc: start a batch of attribute settings
+ * @dev: switch device struct
+ * returns NULL on allocation failure
+ */
+struct swlib_batch *swlib_batch_alloc(struct switch_dev *dev);
+
+/**
+ * swlib_batch_set_attr: queue an attribute setting in a batch
+ * @batch: batch returned by swlib_batch_alloc
+ * @attr: switch attribute struct
+ * @val: attribute value pointer, only used during the call
+ * returns 0 on success
+ */
+int swlib_batch_set_attr(struct swlib_batch *batch, struct switch_attr *attr,
+		struct switch_val *val);
+
+/**
+ * swlib_batch_set_attr_string: queue an attribute setting with type conversion
+ * @batch: batch returned by swlib_batch_alloc
+ * @attr: switch attribute struct
+ * @port_vlan: port or vlan (if applicable)
+ * @str: string value
+ * returns 0 on success
+ */
+int swlib_batch_set_attr_string(struct swlib_batch *batch, struct switch_attr *attr,
+		int port_vlan, const char *str);
+
+/**
+ * swlib_batch_commit: send all queued settings and free the batch
+ * @batch: batch returned by swlib_batch_alloc
+ * @apply: activate the configuration after the last setting
+ * returns 0 on success or the first error reported for the batch
+ */
+int swlib_batch_commit(struct swlib_batch *batch, int apply);
+
 /**
  * swlib_get_attr: get the value for an attribute
  * @dev: switch device struct
@@ -259,6 +319,12 @@ int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *attr,
 int swlib_get_attr(struct switch_dev *dev, struct switch_attr *attr,
 		struct switch_val *val);
 
+/**
+ * swlib_free_counters: free a counter array returned by swlib_get_attr
+ * @counters: counter array
+ */
+void swlib_free_counters(struct switch_counters *counters);
+
 /**
  * swlib_apply_from_uci: set up the switch from a uci configuration
  * @dev: switch device struct
@@ -107,12 +107,11 @@ skip:
 
 int swlib_apply_from_uci(struct switch_dev *dev, struct uci_package *p)
 {
-	struct switch_attr *attr;
+	struct swlib_batch *batch;
 	struct uci_element *e;
 	struct uci_section *s;
 	struct uci_option *o;
 	struct uci_ptr ptr;
-	struct switch_val val;
 	int i;
 
 	settings = NULL;
@@ -217,30 +216,29 @@ found:
 		}
 	}
 
+	batch = swlib_batch_alloc(dev);
+	if (!batch)
+		return -1;
+
 	for (i = 0; i < ARRAY_SIZE(early_settings); i++) {
 		struct swlib_setting *st = &early_settings[i];
 		if (!st->attr || !st->val)
 			continue;
-		swlib_set_attr_string(dev, st->attr, st->port_vlan, st->val);
+		swlib_batch_set_attr_string(batch, st->attr, st->port_vlan, st->val);
 
 	}
 
 	while (settings) {
 		struct swlib_setting *st = settings;
 
-		swlib_set_attr_string(dev, st->attr, st->port_vlan, st->val);
+		swlib_batch_set_attr_string(batch, st->attr, st->port_vlan, st->val);
 		st = st->next;
 		free(settings);
 		settings = st;
 	}
 
-	/* Apply the config */
-	attr = swlib_lookup_attr(dev, SWLIB_ATTR_GROUP_GLOBAL, "apply");
-	if (!attr)
-		return 0;
-
-	memset(&val, 0, sizeof(val));
-	swlib_set_attr(dev, attr, &val);
+	/* Send all settings and apply the config */
+	swlib_batch_commit(batch, 1);
 
 	return 0;
 }
@@ -34,6 +34,45 @@ struct ubus_banned_client {
 	u8 addr[ETH_ALEN];
 };
 
+/* verdicts are per frame type, allowing probes must not allow assoc */
+struct ubus_decision_key {
+	u8 addr[ETH_ALEN];
+	u8 type;
+};
+
+/*
+ * Cached admission verdict of the notify_response subscribers for one
+ * client and frame type. While the verdict is being requested, the entry
+ * only tracks the in-flight notification and management frames fall back
+ * to the miss policy.
+ */
+struct ubus_decision {
+	struct avl_node avl;
+	struct ubus_notify_request nreq;
+	struct hostapd_data *hapd;
+	struct ubus_decision_key key;
+	bool pending;
+	bool valid;
+	bool deny;
+};
+
+#define UBUS_DECISION_TIMEOUT	100
+
+#define UBUS_PROBE_MAX_FREQS	4
+
+/* probe requests of one client, collected over one aggregation interval */
+struct ubus_probe_client {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u32 count;
+	u32 n_signal;
+	int signal_min;
+	int signal_max;
+	int signal_last;
+	int n_freqs;
+	int freqs[UBUS_PROBE_MAX_FREQS];
+};
+
 static void ubus_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct ubus_context *ctx = eloop_ctx;
@@ -139,6 +178,43 @@ hostapd_bss_ban_client(struct hostapd_data *hapd, u8 *addr, int time)
 	eloop_register_timeout(0, time * 1000, hostapd_bss_del_ban, ban, hapd);
 }
 
+static void
+blobmsg_add_macaddr(struct blob_buf *buf, const char *name, const u8 *addr)
+{
+	char *s;
+
+	s = blobmsg_alloc_string_buffer(buf, name, 20);
+	sprintf(s, MACSTR, MAC2STR(addr));
+	blobmsg_add_string_buffer(buf);
+}
+
+static const struct {
+	const char *name;
+	uint32_t flag;
+} sta_flags[] = {
+	{ "auth", WLAN_STA_AUTH },
+	{ "assoc", WLAN_STA_ASSOC },
+	{ "authorized", WLAN_STA_AUTHORIZED },
+	{ "preauth", WLAN_STA_PREAUTH },
+	{ "wds", WLAN_STA_WDS },
+	{ "wmm", WLAN_STA_WMM },
+	{ "ht", WLAN_STA_HT },
+	{ "vht", WLAN_STA_VHT },
+	{ "wps", WLAN_STA_WPS },
+	{ "mfp", WLAN_STA_MFP },
+};
+
+static void
+hostapd_bss_add_sta_flags(struct sta_info *sta)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
+		blobmsg_add_u8(&b, sta_flags[i].name,
+			       !!(sta->flags & sta_flags[i].flag));
+	blobmsg_add_u32(&b, "aid", sta->aid);
+}
+
 static int
 hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 			struct ubus_request_data *req, const char *method,
@@ -148,37 +224,201 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 	struct sta_info *sta;
 	void *list, *c;
 	char mac_buf[20];
-	static const struct {
-		const char *name;
-		uint32_t flag;
-	} sta_flags[] = {
-		{ "auth", WLAN_STA_AUTH },
-		{ "assoc", WLAN_STA_ASSOC },
-		{ "authorized", WLAN_STA_AUTHORIZED },
-		{ "preauth", WLAN_STA_PREAUTH },
-		{ "wds", WLAN_STA_WDS },
-		{ "wmm", WLAN_STA_WMM },
-		{ "ht", WLAN_STA_HT },
-		{ "vht", WLAN_STA_VHT },
-		{ "wps", WLAN_STA_WPS },
-		{ "mfp", WLAN_STA_MFP },
-	};
 
 	blob_buf_init(&b, 0);
 	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
 	list = blobmsg_open_table(&b, "clients");
 	for (sta = hapd->sta_list; sta; sta = sta->next) {
-		int i;
+		sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
+		c = blobmsg_open_table(&b, mac_buf);
+		hostapd_bss_add_sta_flags(sta);
+		blobmsg_close_table(&b, c);
+	}
+	blobmsg_close_array(&b, list);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+/*
+ * Generation of the last change of a station for the delta mode of
+ * get_clients_stats, bumped by the station add/assoc/authorize/remove paths.
+ * Entries of stations that went away are kept for a while as tombstones,
+ * so that pollers can learn about the removal.
+ */
+struct ubus_sta_gen {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u32 gen;
+	bool removed;
+};
+
+#define UBUS_STA_TOMBSTONE_TIME	60
+
+enum {
+	CLIENT_STATS_SINCE,
+	__CLIENT_STATS_MAX
+};
+
+static const struct blobmsg_policy client_stats_policy[__CLIENT_STATS_MAX] = {
+	[CLIENT_STATS_SINCE] = { "since", BLOBMSG_TYPE_INT32 },
+};
+
+static void
+hostapd_bss_del_sta_gen(void *eloop_data, void *user_ctx)
+{
+	struct ubus_sta_gen *sg = eloop_data;
+	struct hostapd_data *hapd = user_ctx;
+
+	if (sg->removed && sg->gen > hapd->ubus.sta_generation_pruned)
+		hapd->ubus.sta_generation_pruned = sg->gen;
+
+	avl_delete(&hapd->ubus.sta_gen, &sg->avl);
+	free(sg);
+}
+
+static void
+hostapd_bss_flush_sta_gen(struct hostapd_data *hapd)
+{
+	struct ubus_sta_gen *sg, *tmp;
+
+	avl_for_each_element_safe(&hapd->ubus.sta_gen, sg, avl, tmp) {
+		eloop_cancel_timeout(hostapd_bss_del_sta_gen, sg, hapd);
+		hostapd_bss_del_sta_gen(sg, hapd);
+	}
+}
+
+void hostapd_ubus_sta_update(struct hostapd_data *hapd, const u8 *addr,
+			     int removed)
+{
+	struct ubus_sta_gen *sg;
+
+	if (!hapd->ubus.obj.id)
+		return;
+
+	sg = avl_find_element(&hapd->ubus.sta_gen, addr, sg, avl);
+	if (!sg) {
+		if (removed)
+			return;
+
+		/* without an entry the station is part of every delta */
+		sg = os_zalloc(sizeof(*sg));
+		if (!sg)
+			return;
+
+		memcpy(sg->addr, addr, sizeof(sg->addr));
+		sg->avl.key = sg->addr;
+		avl_insert(&hapd->ubus.sta_gen, &sg->avl);
+	} else if (sg->removed) {
+		/* station came back before its tombstone expired */
+		eloop_cancel_timeout(hostapd_bss_del_sta_gen, sg, hapd);
+	}
+
+	sg->removed = removed;
+	sg->gen = ++hapd->ubus.sta_generation;
+
+	if (removed)
+		eloop_register_timeout(UBUS_STA_TOMBSTONE_TIME, 0,
+				       hostapd_bss_del_sta_gen, sg, hapd);
+}
+
+static void
+hostapd_bss_add_sta_stats(struct sta_info *sta,
+			  const struct hostap_sta_driver_data *data)
+{
+	struct os_reltime now, age;
+	void *r;
+
+	hostapd_bss_add_sta_flags(sta);
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, &sta->connected_time, &age);
+	blobmsg_add_u32(&b, "connected_time", age.sec);
+
+	if (!data)
+		return;
+
+	r = blobmsg_open_table(&b, "bytes");
+	blobmsg_add_u64(&b, "rx", data->rx_bytes);
+	blobmsg_add_u64(&b, "tx", data->tx_bytes);
+	blobmsg_close_table(&b, r);
+
+	r = blobmsg_open_table(&b, "packets");
+	blobmsg_add_u32(&b, "rx", data->rx_packets);
+	blobmsg_add_u32(&b, "tx", data->tx_packets);
+	blobmsg_close_table(&b, r);
+
+	r = blobmsg_open_table(&b, "rate");
+	blobmsg_add_u32(&b, "rx", data->current_rx_rate * 100);
+	blobmsg_add_u32(&b, "tx", data->current_tx_rate * 100);
+	blobmsg_close_table(&b, r);
+
+	blobmsg_add_u32(&b, "signal", data->signal);
+	blobmsg_add_u32(&b, "inactive", data->inactive_msec);
+}
+
+static int
+hostapd_bss_get_clients_stats(struct ubus_context *ctx, struct ubus_object *obj,
+			      struct ubus_request_data *req, const char *method,
+			      struct blob_attr *msg)
+{
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct blob_attr *tb[__CLIENT_STATS_MAX];
+	struct hostap_sta_driver_data data;
+	struct ubus_sta_gen *sg;
+	struct sta_info *sta;
+	void *list, *c;
+	char mac_buf[20];
+	bool full = true;
+	u32 since = 0;
+
+	blobmsg_parse(client_stats_policy, __CLIENT_STATS_MAX, tb,
+		      blob_data(msg), blob_len(msg));
+
+	if (tb[CLIENT_STATS_SINCE])
+		since = blobmsg_get_u32(tb[CLIENT_STATS_SINCE]);
+
+	/* removals older than the expired tombstones can not be reported */
+	if (since && since >= hapd->ubus.sta_generation_pruned &&
+	    since <= hapd->ubus.sta_generation)
+		full = false;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
+	blobmsg_add_u8(&b, "full", full);
+
+	/*
+	 * Only membership, association and authorization changes count as
+	 * changes; counters, rates and signal are current values of the
+	 * stations that are reported anyway.
+	 */
+	list = blobmsg_open_table(&b, "clients");
+	for (sta = hapd->sta_list; sta; sta = sta->next) {
+		if (!full) {
+			sg = avl_find_element(&hapd->ubus.sta_gen, sta->addr,
+					      sg, avl);
+			if (sg && sg->gen <= since)
+				continue;
+		}
 
 		sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
 		c = blobmsg_open_table(&b, mac_buf);
-		for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
-			blobmsg_add_u8(&b, sta_flags[i].name,
-				       !!(sta->flags & sta_flags[i].flag));
-		blobmsg_add_u32(&b, "aid", sta->aid);
+		os_memset(&data, 0, sizeof(data));
+		if (hostapd_drv_read_sta_data(hapd, &data, sta->addr))
+			hostapd_bss_add_sta_stats(sta, NULL);
+		else
+			hostapd_bss_add_sta_stats(sta, &data);
 		blobmsg_close_table(&b, c);
 	}
+	blobmsg_close_table(&b, list);
+
+	list = blobmsg_open_array(&b, "removed");
+	avl_for_each_element(&hapd->ubus.sta_gen, sg, avl)
+		if (!full && sg->removed && sg->gen > since)
+			blobmsg_add_macaddr(&b, NULL, sg->addr);
 	blobmsg_close_array(&b, list);
+
+	blobmsg_add_u32(&b, "generation", hapd->ubus.sta_generation);
 	ubus_send_reply(ctx, req, b.head);
 
 	return 0;
@@ -186,13 +426,19 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 
 enum {
 	NOTIFY_RESPONSE,
+	NOTIFY_DECISION_TTL,
+	NOTIFY_DECISION_MISS,
 	__NOTIFY_MAX
 };
 
 static const struct blobmsg_policy notify_policy[__NOTIFY_MAX] = {
 	[NOTIFY_RESPONSE] = { "notify_response", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_DECISION_TTL] = { "decision_ttl", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_DECISION_MISS] = { "decision_miss", BLOBMSG_TYPE_STRING },
 };
 
+static void hostapd_bss_flush_decisions(struct hostapd_data *hapd);
+
 static int
 hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 			struct ubus_request_data *req, const char *method,
@@ -200,9 +446,8 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 {
 	struct blob_attr *tb[__NOTIFY_MAX];
 	struct hostapd_data *hapd = get_hapd_from_object(obj);
-	struct wpabuf *elems;
-	const char *pos;
-	size_t len;
+	bool miss_deny = hapd->ubus.decision_miss_deny;
+	int ttl = 0;
 
 	blobmsg_parse(notify_policy, __NOTIFY_MAX, tb,
 		      blob_data(msg), blob_len(msg));
@@ -210,7 +455,71 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 	if (!tb[NOTIFY_RESPONSE])
 		return UBUS_STATUS_INVALID_ARGUMENT;
 
+	if (tb[NOTIFY_DECISION_TTL]) {
+		ttl = blobmsg_get_u32(tb[NOTIFY_DECISION_TTL]);
+		if (ttl < 0)
+			return UBUS_STATUS_INVALID_ARGUMENT;
+	}
+
+	if (tb[NOTIFY_DECISION_MISS]) {
+		const char *policy = blobmsg_get_string(tb[NOTIFY_DECISION_MISS]);
+
+		if (!strcmp(policy, "deny"))
+			miss_deny = true;
+		else if (!strcmp(policy, "allow"))
+			miss_deny = false;
+		else
+			return UBUS_STATUS_INVALID_ARGUMENT;
+	}
+
 	hapd->ubus.notify_response = blobmsg_get_u32(tb[NOTIFY_RESPONSE]);
+	hapd->ubus.decision_ttl = hapd->ubus.notify_response ? ttl : 0;
+	hapd->ubus.decision_miss_deny = miss_deny;
+	hostapd_bss_flush_decisions(hapd);
+
+	return UBUS_STATUS_OK;
+}
+
+enum {
+	PROBE_AGGR_INTERVAL,
+	PROBE_AGGR_MAX_CLIENTS,
+	__PROBE_AGGR_MAX
+};
+
+static const struct blobmsg_policy probe_aggr_policy[__PROBE_AGGR_MAX] = {
+	[PROBE_AGGR_INTERVAL] = { "interval", BLOBMSG_TYPE_INT32 },
+	[PROBE_AGGR_MAX_CLIENTS] = { "max_clients", BLOBMSG_TYPE_INT32 },
+};
+
+static void hostapd_bss_flush_probes(struct hostapd_data *hapd);
+
+static int
+hostapd_probe_aggregation(struct ubus_context *ctx, struct ubus_object *obj,
+			  struct ubus_request_data *req, const char *method,
+			  struct blob_attr *msg)
+{
+	struct blob_attr *tb[__PROBE_AGGR_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	int interval, max_clients = 0;
+
+	blobmsg_parse(probe_aggr_policy, __PROBE_AGGR_MAX, tb,
+		      blob_data(msg), blob_len(msg));
+
+	if (!tb[PROBE_AGGR_INTERVAL])
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	interval = blobmsg_get_u32(tb[PROBE_AGGR_INTERVAL]);
+	if (tb[PROBE_AGGR_MAX_CLIENTS])
+		max_clients = blobmsg_get_u32(tb[PROBE_AGGR_MAX_CLIENTS]);
+
+	if (interval < 0 || max_clients < 0)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	/* report what has been collected so far with the old settings */
+	hostapd_bss_flush_probes(hapd);
+
+	hapd->ubus.probe_interval = interval;
+	hapd->ubus.probe_max_clients = max_clients;
 
 	return UBUS_STATUS_OK;
 }
@@ -273,16 +582,6 @@ hostapd_bss_del_client(struct ubus_context *ctx, struct ubus_object *obj,
 	return 0;
 }
 
-static void
-blobmsg_add_macaddr(struct blob_buf *buf, const char *name, const u8 *addr)
-{
-	char *s;
-
-	s = blobmsg_alloc_string_buffer(buf, name, 20);
-	sprintf(s, MACSTR, MAC2STR(addr));
-	blobmsg_add_string_buffer(buf);
-}
-
 static int
 hostapd_bss_list_bans(struct ubus_context *ctx, struct ubus_object *obj,
 		      struct ubus_request_data *req, const char *method,
@@ -615,6 +914,7 @@ invalid:
 
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("get_clients", hostapd_bss_get_clients),
+	UBUS_METHOD("get_clients_stats", hostapd_bss_get_clients_stats, client_stats_policy),
 	UBUS_METHOD("del_client", hostapd_bss_del_client, del_policy),
 	UBUS_METHOD_NOARG("list_bans", hostapd_bss_list_bans),
 	UBUS_METHOD_NOARG("wps_start", hostapd_bss_wps_start),
@@ -625,6 +925,7 @@ static const struct ubus_method bss_methods[] = {
 #endif
 	UBUS_METHOD("set_vendor_elements", hostapd_vendor_elements, ve_policy),
 	UBUS_METHOD("notify_response", hostapd_notify_response, notify_policy),
+	UBUS_METHOD("probe_aggregation", hostapd_probe_aggregation, probe_aggr_policy),
 	UBUS_METHOD_NOARG("rrm_nr_get_own", hostapd_rrm_nr_get_own),
 	UBUS_METHOD_NOARG("rrm_nr_list", hostapd_rrm_nr_list),
 	UBUS_METHOD("rrm_nr_set", hostapd_rrm_nr_set, nr_set_policy),
@@ -638,6 +939,14 @@ static int avl_compare_macaddr(const void *k1, const void *k2, void *ptr)
 	return memcmp(k1, k2, ETH_ALEN);
 }
 
+static int avl_compare_decision(const void *k1, const void *k2, void *ptr)
+{
+	const struct ubus_decision_key *d1 = k1, *d2 = k2;
+	int ret = memcmp(d1->addr, d2->addr, ETH_ALEN);
+
+	return ret ? ret : (int) d1->type - (int) d2->type;
+}
+
 void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 {
 	struct ubus_object *obj = &hapd->ubus.obj;
@@ -651,6 +960,9 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 		return;
 
 	avl_init(&hapd->ubus.banned, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.decisions, avl_compare_decision, false, NULL);
+	avl_init(&hapd->ubus.probes, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.sta_gen, avl_compare_macaddr, false, NULL);
 	obj->name = name;
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
@@ -667,6 +979,11 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 	if (!ctx)
 		return;
 
+	hostapd_bss_flush_decisions(hapd);
+	hapd->ubus.probe_interval = 0;
+	hostapd_bss_flush_probes(hapd);
+	hostapd_bss_flush_sta_gen(hapd);
+
 	if (obj->id) {
 		ubus_remove_object(ctx, obj);
 		hostapd_ubus_ref_dec();
@@ -689,6 +1006,203 @@ ubus_event_cb(struct ubus_notify_request *req, int idx, int ret)
 		ureq->deny = true;
 }
 
+static void
+hostapd_bss_del_decision(void *eloop_data, void *user_ctx)
+{
+	struct ubus_decision *dec = eloop_data;
+	struct hostapd_data *hapd = user_ctx;
+
+	if (dec->pending)
+		ubus_abort_request(ctx, &dec->nreq.req);
+
+	avl_delete(&hapd->ubus.decisions, &dec->avl);
+	free(dec);
+}
+
+static void
+hostapd_bss_flush_decisions(struct hostapd_data *hapd)
+{
+	struct ubus_decision *dec, *tmp;
+
+	avl_for_each_element_safe(&hapd->ubus.decisions, dec, avl, tmp) {
+		eloop_cancel_timeout(hostapd_bss_del_decision, dec, hapd);
+		hostapd_bss_del_decision(dec, hapd);
+	}
+}
+
+static void
+ubus_decision_status_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_decision *dec = container_of(req, struct ubus_decision, nreq);
+
+	if (ret)
+		dec->deny = true;
+}
+
+static void
+ubus_decision_complete_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_decision *dec = container_of(req, struct ubus_decision, nreq);
+	struct hostapd_data *hapd = dec->hapd;
+
+	eloop_cancel_timeout(hostapd_bss_del_decision, dec, hapd);
+	dec->pending = false;
+	dec->valid = true;
+	eloop_register_timeout(hapd->ubus.decision_ttl / 1000,
+			       (hapd->ubus.decision_ttl % 1000) * 1000,
+			       hostapd_bss_del_decision, dec, hapd);
+}
+
+static int
+hostapd_ubus_decide(struct hostapd_data *hapd, int req_type, const char *type,
+		    const u8 *addr)
+{
+	struct ubus_decision_key key = { .type = req_type };
+	struct ubus_decision *dec;
+
+	memcpy(key.addr, addr, sizeof(key.addr));
+	dec = avl_find_element(&hapd->ubus.decisions, &key, dec, avl);
+	if (dec && dec->valid) {
+		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
+		return dec->deny ? -1 : 0;
+	}
+
+	if (!dec) {
+		dec = os_zalloc(sizeof(*dec));
+		if (!dec)
+			goto miss;
+
+		dec->hapd = hapd;
+		dec->key = key;
+		dec->avl.key = &dec->key;
+		avl_insert(&hapd->ubus.decisions, &dec->avl);
+	}
+
+	/* still publish the frame, only the first one waits for a reply */
+	if (dec->pending) {
+		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
+		goto miss;
+	}
+
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &dec->nreq)) {
+		hostapd_bss_del_decision(dec, hapd);
+		goto miss;
+	}
+
+	dec->nreq.status_cb = ubus_decision_status_cb;
+	dec->nreq.complete_cb = ubus_decision_complete_cb;
+	dec->pending = true;
+	ubus_complete_request_async(ctx, &dec->nreq.req);
+
+	/* drop the request if not all subscribers reply in time */
+	eloop_register_timeout(0, UBUS_DECISION_TIMEOUT * 1000,
+			       hostapd_bss_del_decision, dec, hapd);
+
+miss:
+	return hapd->ubus.decision_miss_deny ? -1 : 0;
+}
+
+static void
+hostapd_bss_probe_timeout(void *eloop_data, void *user_ctx)
+{
+	struct hostapd_data *hapd = eloop_data;
+	struct ubus_probe_client *pc, *tmp;
+	void *c, *t, *f;
+	char mac_buf[20];
+	int i;
+
+	if (hapd->ubus.obj.has_subscribers && hapd->ubus.probe_interval) {
+		blob_buf_init(&b, 0);
+		blobmsg_add_u32(&b, "interval", hapd->ubus.probe_interval);
+		blobmsg_add_u32(&b, "dropped", hapd->ubus.probe_dropped);
+		c = blobmsg_open_table(&b, "clients");
+		avl_for_each_element(&hapd->ubus.probes, pc, avl) {
+			sprintf(mac_buf, MACSTR, MAC2STR(pc->addr));
+			t = blobmsg_open_table(&b, mac_buf);
+			blobmsg_add_u32(&b, "count", pc->count);
+			if (pc->n_signal) {
+				blobmsg_add_u32(&b, "signal_min", pc->signal_min);
+				blobmsg_add_u32(&b, "signal_max", pc->signal_max);
+				blobmsg_add_u32(&b, "signal", pc->signal_last);
+			}
+			f = blobmsg_open_array(&b, "freq");
+			for (i = 0; i < pc->n_freqs; i++)
+				blobmsg_add_u32(&b, NULL, pc->freqs[i]);
+			blobmsg_close_array(&b, f);
+			blobmsg_close_table(&b, t);
+		}
+		blobmsg_close_table(&b, c);
+		ubus_notify(ctx, &hapd->ubus.obj, "probe_summary", b.head, -1);
+	}
+
+	avl_for_each_element_safe(&hapd->ubus.probes, pc, avl, tmp) {
+		avl_delete(&hapd->ubus.probes, &pc->avl);
+		free(pc);
+	}
+	hapd->ubus.probe_dropped = 0;
+}
+
+static void
+hostapd_bss_flush_probes(struct hostapd_data *hapd)
+{
+	if (eloop_cancel_timeout(hostapd_bss_probe_timeout, hapd, NULL))
+		hostapd_bss_probe_timeout(hapd, NULL);
+}
+
+static void
+hostapd_ubus_probe_aggregate(struct hostapd_data *hapd, const u8 *addr,
+			     const struct hostapd_frame_info *fi)
+{
+	struct ubus_probe_client *pc;
+	int freq;
+	int i;
+
+	pc = avl_find_element(&hapd->ubus.probes, addr, pc, avl);
+	if (!pc) {
+		if (hapd->ubus.probe_max_clients &&
+		    hapd->ubus.probes.count >= hapd->ubus.probe_max_clients) {
+			hapd->ubus.probe_dropped++;
+			return;
+		}
+
+		pc = os_zalloc(sizeof(*pc));
+		if (!pc)
+			return;
+
+		memcpy(pc->addr, addr, sizeof(pc->addr));
+		pc->avl.key = pc->addr;
+
+		if (avl_is_empty(&hapd->ubus.probes))
+			eloop_register_timeout(hapd->ubus.probe_interval / 1000,
+					       (hapd->ubus.probe_interval % 1000) * 1000,
+					       hostapd_bss_probe_timeout, hapd, NULL);
+		avl_insert(&hapd->ubus.probes, &pc->avl);
+	}
+
+	pc->count++;
+	if (!fi)
+		return;
+
+	if (!pc->n_signal++) {
+		pc->signal_min = fi->ssi_signal;
+		pc->signal_max = fi->ssi_signal;
+	}
+	pc->signal_last = fi->ssi_signal;
+	if (fi->ssi_signal < pc->signal_min)
+		pc->signal_min = fi->ssi_signal;
+	if (fi->ssi_signal > pc->signal_max)
+		pc->signal_max = fi->ssi_signal;
+
+	/* the channel the probe was heard on, not the one of the BSS */
+	freq = fi->freq ? fi->freq : hapd->iface->freq;
+	for (i = 0; i < pc->n_freqs; i++)
+		if (pc->freqs[i] == freq)
+			return;
+
+	if (pc->n_freqs < UBUS_PROBE_MAX_FREQS)
+		pc->freqs[pc->n_freqs++] = freq;
+}
+
 int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req)
 {
 	struct ubus_banned_client *ban;
@@ -713,6 +1227,12 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 	if (!hapd->ubus.obj.has_subscribers)
 		return 0;
 
+	if (req->type == HOSTAPD_UBUS_PROBE_REQ && hapd->ubus.probe_interval &&
+	    !hapd->ubus.notify_response) {
+		hostapd_ubus_probe_aggregate(hapd, addr, req->frame_info);
+		return 0;
+	}
+
 	if (req->type < ARRAY_SIZE(types))
 		type = types[req->type];
 
@@ -729,11 +1249,14 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 		return 0;
 	}
 
+	if (hapd->ubus.decision_ttl)
+		return hostapd_ubus_decide(hapd, req->type, type, addr);
+
 	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
 		return 0;
 
 	ureq.nreq.status_cb = ubus_event_cb;
-	ubus_complete_request(ctx, &ureq.nreq.req, 100);
+	ubus_complete_request(ctx, &ureq.nreq.req, UBUS_DECISION_TIMEOUT);
 
 	if (ureq.deny)
 		return -1;
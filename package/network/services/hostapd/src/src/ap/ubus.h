@@ -37,7 +37,17 @@ struct hostapd_ubus_iface {
 struct hostapd_ubus_bss {
 	struct ubus_object obj;
 	struct avl_tree banned;
+	struct avl_tree decisions;
+	struct avl_tree probes;
+	struct avl_tree sta_gen;
+	u32 sta_generation;
+	u32 sta_generation_pruned;
 	int notify_response;
+	int decision_ttl;
+	bool decision_miss_deny;
+	int probe_interval;
+	int probe_max_clients;
+	int probe_dropped;
 };
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface);
@@ -47,6 +57,7 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd);
 
 int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req);
 void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *mac);
+void hostapd_ubus_sta_update(struct hostapd_data *hapd, const u8 *addr, int removed);
 
 #else
 
@@ -78,6 +89,10 @@ static inline int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct ho
 static inline void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *mac)
 {
 }
+
+static inline void hostapd_ubus_sta_update(struct hostapd_data *hapd, const u8 *addr, int removed)
+{
+}
 #endif
 
 #endif
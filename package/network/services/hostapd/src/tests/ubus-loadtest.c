@@ -0,0 +1,508 @@
+/*
+ * Load test for the ubus admission decisions of hostapd
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * Acts as the notify_response subscriber of hostapd.<iface>, answering the
+ * probe/auth/assoc notifications after a configurable delay with a per
+ * type verdict, while injecting a probe request storm through a monitor
+ * interface of a second radio (mac80211_hwsim), either generated from
+ * random client addresses or replayed from a radiotap pcap capture.
+ * Meanwhile a get_clients call is issued every 100 ms, its round trip
+ * time shows how long hostapd's eloop is blocked by the decisions.
+ *
+ * This software may be distributed under the terms of the BSD license.
+ */
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <libubox/uloop.h>
+#include <libubox/blobmsg.h>
+#include <libubus.h>
+
+#define PING_INTERVAL	100
+#define STORM_TICK	10
+#define MAX_FRAME	2048
+
+enum {
+	TYPE_PROBE,
+	TYPE_AUTH,
+	TYPE_ASSOC,
+	TYPE_OTHER,
+	__TYPE_MAX
+};
+
+static const char * const type_names[__TYPE_MAX] = {
+	[TYPE_PROBE] = "probe",
+	[TYPE_AUTH] = "auth",
+	[TYPE_ASSOC] = "assoc",
+	[TYPE_OTHER] = "other",
+};
+
+struct deferred_reply {
+	struct uloop_timeout timeout;
+	struct ubus_request_data req;
+	int status;
+};
+
+static struct ubus_context *ctx;
+static struct ubus_subscriber sub;
+static struct blob_buf b;
+static uint32_t hostapd_id;
+
+static int reply_delay;
+static bool deny[__TYPE_MAX];
+static unsigned long notified[__TYPE_MAX];
+
+static int mon_fd = -1;
+static int storm_rate = 1000;
+static int storm_clients = 256;
+static int storm_auth;
+static uint8_t bssid[ETH_ALEN];
+static unsigned long frames_sent, frames_failed;
+
+static unsigned char *pcap_buf;
+static size_t pcap_len, pcap_pos;
+
+static struct ubus_request ping_req;
+static bool ping_pending;
+static double ping_start, ping_max, ping_sum;
+static unsigned long ping_count, ping_skipped;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+type_index(const char *method)
+{
+	int i;
+
+	for (i = 0; i < TYPE_OTHER; i++)
+		if (!strcmp(method, type_names[i]))
+			return i;
+
+	return TYPE_OTHER;
+}
+
+static void
+deferred_reply_cb(struct uloop_timeout *t)
+{
+	struct deferred_reply *dr = container_of(t, struct deferred_reply, timeout);
+
+	ubus_complete_deferred_request(ctx, &dr->req, dr->status);
+	free(dr);
+}
+
+static int
+notify_cb(struct ubus_context *ctx, struct ubus_object *obj,
+	  struct ubus_request_data *req, const char *method,
+	  struct blob_attr *msg)
+{
+	int type = type_index(method);
+	int status = deny[type] ? UBUS_STATUS_PERMISSION_DENIED : UBUS_STATUS_OK;
+	struct deferred_reply *dr;
+
+	notified[type]++;
+
+	if (!reply_delay)
+		return status;
+
+	dr = calloc(1, sizeof(*dr));
+	if (!dr)
+		return status;
+
+	dr->status = status;
+	dr->timeout.cb = deferred_reply_cb;
+	ubus_defer_request(ctx, req, &dr->req);
+	uloop_timeout_set(&dr->timeout, reply_delay);
+
+	return 0;
+}
+
+static void
+ping_complete_cb(struct ubus_request *req, int ret)
+{
+	double rtt = now() - ping_start;
+
+	ping_pending = false;
+	ping_count++;
+	ping_sum += rtt;
+	if (rtt > ping_max)
+		ping_max = rtt;
+}
+
+static void
+ping_cb(struct uloop_timeout *t)
+{
+	uloop_timeout_set(t, PING_INTERVAL);
+
+	/* a ping still outstanding is counted in ping_max once it returns */
+	if (ping_pending) {
+		ping_skipped++;
+		return;
+	}
+
+	blob_buf_init(&b, 0);
+	if (ubus_invoke_async(ctx, hostapd_id, "get_clients", b.head, &ping_req))
+		return;
+
+	ping_req.complete_cb = ping_complete_cb;
+	ping_pending = true;
+	ping_start = now();
+	ubus_complete_request_async(ctx, &ping_req);
+}
+
+static struct uloop_timeout ping_timer = {
+	.cb = ping_cb,
+};
+
+/* radiotap header without any fields, mac80211 picks the rate */
+static const uint8_t radiotap_hdr[] = { 0, 0, 8, 0, 0, 0, 0, 0 };
+
+static size_t
+build_frame(uint8_t *buf, unsigned int client, bool auth)
+{
+	static const uint8_t rates[] = { 0x01, 0x04, 0x82, 0x84, 0x8b, 0x96 };
+	static uint16_t seq;
+	uint8_t *hdr = buf + sizeof(radiotap_hdr);
+	uint8_t *body = hdr + 24;
+
+	memcpy(buf, radiotap_hdr, sizeof(radiotap_hdr));
+	memset(hdr, 0, 24);
+	hdr[0] = auth ? 0xb0 : 0x40;
+
+	/* locally administered client addresses */
+	hdr[10] = 0x02;
+	hdr[13] = client >> 16;
+	hdr[14] = client >> 8;
+	hdr[15] = client;
+
+	if (auth) {
+		memcpy(hdr + 4, bssid, ETH_ALEN);
+		memcpy(hdr + 16, bssid, ETH_ALEN);
+	} else {
+		memset(hdr + 4, 0xff, ETH_ALEN);
+		memset(hdr + 16, 0xff, ETH_ALEN);
+	}
+
+	hdr[22] = (seq << 4) & 0xf0;
+	hdr[23] = seq >> 4;
+	seq++;
+
+	if (auth) {
+		/* open system, transaction 1, status 0 */
+		memset(body, 0, 6);
+		body[2] = 1;
+		return body + 6 - buf;
+	}
+
+	/* wildcard SSID and 802.11b rates */
+	body[0] = 0;
+	body[1] = 0;
+	memcpy(body + 2, rates, sizeof(rates));
+	return body + 2 + sizeof(rates) - buf;
+}
+
+/* next frame of the pcap capture, restarting at its end */
+static size_t
+pcap_next_frame(uint8_t *buf)
+{
+	uint32_t len;
+
+	if (pcap_pos + 16 > pcap_len)
+		pcap_pos = 24;
+
+	memcpy(&len, pcap_buf + pcap_pos + 8, sizeof(len));
+	if (len > MAX_FRAME || pcap_pos + 16 + len > pcap_len) {
+		pcap_pos = 24;
+		return 0;
+	}
+
+	memcpy(buf, pcap_buf + pcap_pos + 16, len);
+	pcap_pos += 16 + len;
+
+	return len;
+}
+
+static void
+storm_cb(struct uloop_timeout *t)
+{
+	static unsigned int client;
+	uint8_t buf[MAX_FRAME];
+	int i, n = storm_rate * STORM_TICK / 1000;
+	size_t len;
+
+	uloop_timeout_set(t, STORM_TICK);
+
+	for (i = 0; i < n; i++) {
+		if (pcap_buf) {
+			len = pcap_next_frame(buf);
+		} else {
+			client = (client + 1) % storm_clients;
+			len = build_frame(buf, client,
+					  storm_auth && !(frames_sent % storm_auth));
+		}
+
+		if (len && send(mon_fd, buf, len, MSG_DONTWAIT) == (ssize_t) len)
+			frames_sent++;
+		else
+			frames_failed++;
+	}
+}
+
+static struct uloop_timeout storm_timer = {
+	.cb = storm_cb,
+};
+
+static void
+end_cb(struct uloop_timeout *t)
+{
+	uloop_end();
+}
+
+static int
+open_monitor(const char *ifname)
+{
+	struct sockaddr_ll sll = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(ETH_P_ALL),
+	};
+	int fd;
+
+	sll.sll_ifindex = if_nametoindex(ifname);
+	if (!sll.sll_ifindex) {
+		fprintf(stderr, "Unknown interface %s\n", ifname);
+		return -1;
+	}
+
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (fd < 0 || bind(fd, (struct sockaddr *) &sll, sizeof(sll)) < 0) {
+		perror("monitor socket");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+load_pcap(const char *file)
+{
+	FILE *f = fopen(file, "r");
+	uint32_t magic, linktype;
+	long size;
+
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+
+	pcap_buf = malloc(size);
+	if (!pcap_buf || size < 24 || fread(pcap_buf, 1, size, f) != (size_t) size) {
+		fprintf(stderr, "Cannot read %s\n", file);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	memcpy(&magic, pcap_buf, sizeof(magic));
+	memcpy(&linktype, pcap_buf + 20, sizeof(linktype));
+
+	/* native byte order pcap with radiotap headers only */
+	if (magic != 0xa1b2c3d4 || linktype != 127) {
+		fprintf(stderr, "%s: not a native radiotap pcap file\n", file);
+		return -1;
+	}
+
+	pcap_len = size;
+	pcap_pos = 24;
+
+	return 0;
+}
+
+static int
+parse_mac(const char *str, uint8_t *addr)
+{
+	unsigned int a[ETH_ALEN];
+	int i;
+
+	if (sscanf(str, "%x:%x:%x:%x:%x:%x",
+		   &a[0], &a[1], &a[2], &a[3], &a[4], &a[5]) != ETH_ALEN)
+		return -1;
+
+	for (i = 0; i < ETH_ALEN; i++)
+		addr[i] = a[i];
+
+	return 0;
+}
+
+static int
+set_notify_response(int ttl, const char *miss)
+{
+	int ret;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "notify_response", 1);
+	blobmsg_add_u32(&b, "decision_ttl", ttl);
+	if (miss)
+		blobmsg_add_string(&b, "decision_miss", miss);
+
+	ret = ubus_invoke(ctx, hostapd_id, "notify_response", b.head,
+			  NULL, NULL, 1000);
+	if (ret)
+		fprintf(stderr, "notify_response failed: %s\n", ubus_strerror(ret));
+
+	return ret;
+}
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<options>] <iface> <monitor iface>\n"
+		"\n"
+		"Options:\n"
+		"  -t <seconds>:		Duration of the storm (default: 10)\n"
+		"  -r <rate>:		Frames per second (default: 1000)\n"
+		"  -c <count>:		Number of client addresses (default: 256)\n"
+		"  -a <n>:		Send every <n>th frame as auth to -b\n"
+		"  -b <bssid>:		BSSID of <iface> for auth frames\n"
+		"  -f <file>:		Replay frames from a radiotap pcap file\n"
+		"  -d <msec>:		Delay of the subscriber replies (default: 0)\n"
+		"  -D <type>:		Deny probe, auth or assoc (repeatable)\n"
+		"  -T <seconds>:		decision_ttl, 0 for blocking decisions (default: 0)\n"
+		"  -m <policy>:		decision_miss: allow or deny\n"
+		"\n", progname);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct uloop_timeout end = { .cb = end_cb };
+	const char *miss = NULL;
+	char path[64];
+	int duration = 10;
+	int ttl = 0;
+	int i, ch;
+
+	while ((ch = getopt(argc, argv, "a:b:c:d:D:f:m:r:t:T:")) != -1) {
+		switch (ch) {
+		case 'a':
+			storm_auth = atoi(optarg);
+			break;
+		case 'b':
+			if (parse_mac(optarg, bssid))
+				return usage(argv[0]);
+			break;
+		case 'c':
+			storm_clients = atoi(optarg);
+			break;
+		case 'd':
+			reply_delay = atoi(optarg);
+			break;
+		case 'D':
+			i = type_index(optarg);
+			if (i == TYPE_OTHER)
+				return usage(argv[0]);
+			deny[i] = true;
+			break;
+		case 'f':
+			if (load_pcap(optarg))
+				return 1;
+			break;
+		case 'm':
+			miss = optarg;
+			break;
+		case 'r':
+			storm_rate = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		case 'T':
+			ttl = atoi(optarg);
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != 2 || storm_clients < 1 || storm_rate < 1)
+		return usage(argv[0]);
+
+	mon_fd = open_monitor(argv[optind + 1]);
+	if (mon_fd < 0)
+		return 1;
+
+	uloop_init();
+	ctx = ubus_connect(NULL);
+	if (!ctx) {
+		fprintf(stderr, "Failed to connect to ubus\n");
+		return 1;
+	}
+	ubus_add_uloop(ctx);
+
+	snprintf(path, sizeof(path), "hostapd.%s", argv[optind]);
+	if (ubus_lookup_id(ctx, path, &hostapd_id)) {
+		fprintf(stderr, "%s not found\n", path);
+		return 1;
+	}
+
+	sub.cb = notify_cb;
+	if (ubus_register_subscriber(ctx, &sub) ||
+	    ubus_subscribe(ctx, &sub, hostapd_id)) {
+		fprintf(stderr, "Failed to subscribe to %s\n", path);
+		return 1;
+	}
+
+	if (set_notify_response(ttl, miss))
+		return 1;
+
+	uloop_timeout_set(&ping_timer, PING_INTERVAL);
+	uloop_timeout_set(&storm_timer, STORM_TICK);
+	uloop_timeout_set(&end, duration * 1000);
+	uloop_run();
+
+	/* leave hostapd answering on its own again */
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "notify_response", 0);
+	ubus_invoke(ctx, hostapd_id, "notify_response", b.head, NULL, NULL, 1000);
+
+	printf("frames: %lu sent, %lu failed (%d/s for %ds)\n",
+	       frames_sent, frames_failed, storm_rate, duration);
+	printf("notifications:");
+	for (i = 0; i < __TYPE_MAX; i++)
+		printf(" %s %lu", type_names[i], notified[i]);
+	printf("\n");
+	printf("get_clients: %lu calls, avg %.1f ms, max %.1f ms, %lu skipped while busy\n",
+	       ping_count, ping_count ? ping_sum / ping_count * 1000 : 0,
+	       ping_max * 1000, ping_skipped);
+
+	ubus_free(ctx);
+	uloop_done();
+	close(mon_fd);
+
+	return 0;
+}
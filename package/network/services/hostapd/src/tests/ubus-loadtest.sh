@@ -0,0 +1,55 @@
+#!/bin/sh
+# Runs ubus-loadtest against hostapd on a mac80211_hwsim radio, once with
+# blocking decisions (decision_ttl 0) and once with cached ones.
+#
+# usage: ubus-loadtest.sh [<rate> [<reply delay ms>]]
+# Needs root, ubusd, hostapd with ubus support and ubus-loadtest in PATH.
+
+RATE="${1:-1000}"
+DELAY="${2:-20}"
+DIR="$(mktemp -d /tmp/ubus-loadtest.XXXXXX)"
+
+cleanup() {
+	[ -n "$HOSTAPD_PID" ] && kill "$HOSTAPD_PID"
+	[ -n "$UBUSD_PID" ] && kill "$UBUSD_PID"
+	ip link del mon1 2>/dev/null
+	rmmod mac80211_hwsim 2>/dev/null
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+modprobe mac80211_hwsim radios=2 || exit 1
+sleep 1
+
+PHY1="$(basename "$(readlink /sys/class/net/wlan1/phy80211)")"
+iw phy "$PHY1" interface add mon1 type monitor || exit 1
+ip link set wlan1 down
+ip link set mon1 up
+iw dev mon1 set channel 1
+
+cat > "$DIR/hostapd.conf" <<EOF
+interface=wlan0
+driver=nl80211
+ssid=loadtest
+hw_mode=g
+channel=1
+EOF
+
+# hostapd connects to the default socket
+ubusd &
+UBUSD_PID=$!
+sleep 1
+
+hostapd "$DIR/hostapd.conf" &
+HOSTAPD_PID=$!
+sleep 3
+
+BSSID="$(cat /sys/class/net/wlan0/address)"
+
+run() {
+	echo "== $*"
+	ubus-loadtest -r "$RATE" -d "$DELAY" -a 10 -b "$BSSID" -D auth "$@" wlan0 mon1
+}
+
+run -T 0
+run -T 10 -m allow
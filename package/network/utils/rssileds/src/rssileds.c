@@ -26,11 +26,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <poll.h>
+#include <time.h>
+
+#include <netlink/netlink.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/ctrl.h>
+#include <linux/nl80211.h>
 
 #include "iwinfo.h"
 
@@ -38,8 +47,20 @@
 #define LEDS_BASEPATH		"/sys/class/leds/"
 #define BACKEND_RETRY_DELAY	500000
 
-char *ifname;
-int qual_max;
+/*
+ * Station interfaces of nl80211 drivers get CQM RSSI thresholds at every
+ * quality value where an LED changes, and are only looked at again when
+ * the kernel reports that the signal crossed one of them. Everything
+ * else is polled every refresh interval as before.
+ */
+#define CQM_MAX_THRESHOLDS	64
+#define CQM_HYSTERESIS		1
+
+/* iwinfo reports nl80211 quality as signal + 110 dBm */
+#define NL80211_QUALITY_OFFSET	110
+
+/* NL80211_EXT_FEATURE_CQM_RSSI_LIST, not in all kernel headers yet */
+#define EXT_FEATURE_CQM_RSSI_LIST	13
 
 struct led {
 	char *sysfspath;
@@ -57,6 +78,32 @@ struct rule {
 	rule_t *next;
 };
 
+typedef struct iface iface_t;
+struct iface {
+	char *ifname;
+	int refresh;
+	int threshold;
+	int qual_max;
+	int q0;
+	int ifindex;
+	int phy;
+	int cqm;
+	long long next_poll;
+	const struct iwinfo_ops *iw;
+	rule_t *rules;
+	iface_t *next;
+};
+
+static struct nl_sock *nl_cmd, *nl_event;
+static struct nl_cb *nl_event_cb;
+static int nl80211_id = -1;
+
+/* events are only matched by interface, the rest of them is skipped */
+static struct nla_policy event_policy[NL80211_ATTR_IFINDEX + 1] = {
+	[NL80211_ATTR_IFINDEX] = { .type = NLA_U32 },
+};
+static struct nla_cpolicy *event_cpolicy;
+
 void log_rules(rule_t *rules)
 {
 	rule_t *rule = rules;
@@ -158,20 +205,20 @@ void close_led(struct led **led)
 }
 
 
-int quality(const struct iwinfo_ops *iw, const char *ifname)
+int quality(iface_t *iface)
 {
 	int qual;
 
-	if ( ! iw ) return -1;
+	if ( ! iface->iw ) return -1;
 
-	if (qual_max < 1)
-		if (iw->quality_max(ifname, &qual_max))
+	if (iface->qual_max < 1)
+		if (iface->iw->quality_max(iface->ifname, &iface->qual_max))
 			return -1;
 
-	if (iw->quality(ifname, &qual))
+	if (iface->iw->quality(iface->ifname, &qual))
 		return -1;
 
-	return ( qual * 100 ) / qual_max ;
+	return ( qual * 100 ) / iface->qual_max ;
 }
 
 int open_backend(const struct iwinfo_ops **iw, const char *ifname)
@@ -206,82 +253,515 @@ void update_leds(rule_t *rules, int q)
 	}
 }
 
-int main(int argc, char **argv)
+long long now_ms(void)
 {
-	int i,q,q0,r,s;
-	const struct iwinfo_ops *iw = NULL;
-	rule_t *headrule = NULL, *currentrule = NULL;
+	struct timespec ts;
 
-	if (argc < 9 || ( (argc-4) % 5 != 0 ) )
-	{
-		printf("syntax: %s (ifname) (refresh) (threshold) (rule) [rule] ...\n", argv[0]);
-		printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
-		return 1;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int read_sysfs_int(const char *fmt, const char *ifname)
+{
+	char path[64];
+	FILE *f;
+	int val = -1;
+
+	snprintf(path, sizeof(path), fmt, ifname);
+	f = fopen(path, "r");
+	if ( ! f )
+		return -1;
+
+	if ( fscanf(f, "%d", &val) != 1 )
+		val = -1;
+
+	fclose(f);
+
+	return val;
+}
+
+void poll_iface(iface_t *iface, long long now)
+{
+	int q;
+
+	iface->next_poll = now + iface->refresh / 1000;
+
+	if ( ! iface->iw && open_backend(&iface->iw, iface->ifname) ) {
+		iface->next_poll = now + BACKEND_RETRY_DELAY / 1000;
+		return;
+	}
+
+	q = quality(iface);
+	if ( q < iface->q0 - iface->threshold || q > iface->q0 + iface->threshold ) {
+		update_leds(iface->rules, q);
+		iface->q0 = q;
+	}
+
+	// re-open backend...
+	if ( q == -1 && iface->q0 == -1 ) {
+		iwinfo_finish();
+		iface->iw = NULL;
+		iface->next_poll = now + BACKEND_RETRY_DELAY / 1000;
+	}
+}
+
+static int nl_finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int nl_ack_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+
+	*ret = 0;
+	return NL_STOP;
+}
+
+static int nl_error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			    void *arg)
+{
+	int *ret = arg;
+
+	*ret = err->error;
+	return NL_STOP;
+}
+
+int nl80211_request(struct nl_msg *msg,
+		    int (*valid)(struct nl_msg *, void *), void *arg)
+{
+	struct nl_cb *cb;
+	int ret = 1;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if ( ! cb ) {
+		nlmsg_free(msg);
+		return -1;
+	}
+
+	if (valid)
+		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, valid, arg);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nl_finish_handler, &ret);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, nl_ack_handler, &ret);
+	nl_cb_err(cb, NL_CB_CUSTOM, nl_error_handler, &ret);
+
+	if (nl_send_auto_complete(nl_cmd, msg) < 0)
+		ret = -1;
+
+	while (ret > 0)
+		if (nl_recvmsgs(nl_cmd, cb) < 0 && ret > 0)
+			ret = -1;
+
+	nl_cb_put(cb);
+	nlmsg_free(msg);
+
+	return ret;
+}
+
+static int ext_feature_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nla_iter it;
+	struct nlattr *nla;
+	int *supported = arg;
+	uint8_t *features;
+
+	/* the split wiphy dump is large, only look for the one attribute */
+	nla_iter_init(&it, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+		      NULL);
+	while ( (nla = nla_iter_next(&it)) )
+		if ( nla_type(nla) == NL80211_ATTR_EXT_FEATURES )
+			break;
+
+	if ( ! nla )
+		return NL_SKIP;
+
+	features = nla_data(nla);
+	if ( nla_len(nla) > EXT_FEATURE_CQM_RSSI_LIST / 8 &&
+	     features[EXT_FEATURE_CQM_RSSI_LIST / 8] & (1 << (EXT_FEATURE_CQM_RSSI_LIST % 8)) )
+		*supported = 1;
+
+	return NL_SKIP;
+}
+
+int cqm_list_supported(iface_t *iface)
+{
+	struct nl_msg *msg;
+	int supported = 0;
+
+	msg = nlmsg_alloc();
+	if ( ! msg )
+		return 0;
+
+	genlmsg_put(msg, 0, 0, nl80211_id, 0, NLM_F_DUMP, NL80211_CMD_GET_WIPHY, 0);
+	nla_put_flag(msg, NL80211_ATTR_SPLIT_WIPHY_DUMP);
+	nla_put_u32(msg, NL80211_ATTR_WIPHY, iface->phy);
+
+	if (nl80211_request(msg, ext_feature_handler, &supported) < 0)
+		return 0;
+
+	return supported;
+}
+
+/* adds the threshold for quality q unless it is already in the list */
+static int add_threshold(iface_t *iface, int32_t *thold, int n, int q)
+{
+	int32_t t;
+	int i;
+
+	if ( q < 1 || q > 100 )
+		return n;
+
+	t = (q * iface->qual_max + 99) / 100 - NL80211_QUALITY_OFFSET;
+	for (i = 0; i < n; i++)
+		if ( thold[i] == t )
+			return n;
+
+	thold[n] = t;
+
+	return n + 1;
+}
+
+static int cmp_threshold(const void *a, const void *b)
+{
+	return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+/* points where the brightness of a rule changes, every step quality values */
+static int add_ramp(iface_t *iface, int32_t *thold, int n, int step)
+{
+	rule_t *rule;
+	int q, lo, hi;
+
+	for (rule = iface->rules; rule; rule = rule->next) {
+		if ( ! rule->bfactor )
+			continue;
+
+		/* the brightness ramps up until it saturates */
+		lo = rule->minq;
+		hi = rule->maxq;
+		if ( rule->bfactor > 0 ) {
+			if ( lo < -rule->boffset )
+				lo = -rule->boffset;
+			if ( hi > 255 / rule->bfactor - rule->boffset + 1 )
+				hi = 255 / rule->bfactor - rule->boffset + 1;
+		}
+		if ( lo < 0 )
+			lo = 0;
+		if ( hi > 100 )
+			hi = 100;
+
+		for (q = lo + step; q <= hi; q += step)
+			n = add_threshold(iface, thold, n, q);
+	}
+
+	return n;
+}
+
+/*
+ * Quality values at which the output of any rule changes, in dBm. The
+ * rule boundaries always get a threshold, the brightness ramps share
+ * what is left with a step coarse enough to fit. Returns -1 if not even
+ * the boundaries fit, the interface is then polled.
+ */
+int cqm_thresholds(iface_t *iface, int32_t *thold)
+{
+	/* qualities 1..100 map to at most 100 distinct thresholds */
+	int32_t all[100];
+	rule_t *rule;
+	int step = iface->threshold > 0 ? iface->threshold : 1;
+	int n, nb = 0;
+
+	for (rule = iface->rules; rule; rule = rule->next) {
+		nb = add_threshold(iface, all, nb, rule->minq);
+		nb = add_threshold(iface, all, nb, rule->maxq + 1);
 	}
 
-	ifname = argv[1];
+	if ( nb > CQM_MAX_THRESHOLDS )
+		return -1;
+
+	/* a step of 100 adds nothing, so this ends */
+	while ( (n = add_ramp(iface, all, nb, step)) > CQM_MAX_THRESHOLDS )
+		step++;
+
+	if ( step > iface->threshold && step > 1 )
+		syslog(LOG_INFO, "%s: brightness thresholds every %d%%\n",
+		       iface->ifname, step);
+
+	memcpy(thold, all, n * sizeof(*thold));
+	qsort(thold, n, sizeof(*thold), cmp_threshold);
+
+	return n;
+}
+
+int cqm_setup(iface_t *iface)
+{
+	int32_t thold[CQM_MAX_THRESHOLDS];
+	struct nl_msg *msg;
+	struct nlattr *cqm;
+	const char *type;
+	int n;
+
+	if ( nl80211_id < 0 || ! iface->iw )
+		return -1;
+
+	type = iwinfo_type(iface->ifname);
+	if ( ! type || strcmp(type, "nl80211") )
+		return -1;
+
+	if ( iface->qual_max < 1 &&
+	     iface->iw->quality_max(iface->ifname, &iface->qual_max) )
+		return -1;
+
+	iface->ifindex = read_sysfs_int("/sys/class/net/%s/ifindex", iface->ifname);
+	iface->phy = read_sysfs_int("/sys/class/net/%s/phy80211/index", iface->ifname);
+	if ( iface->ifindex < 0 || iface->phy < 0 )
+		return -1;
+
+	n = cqm_thresholds(iface, thold);
+	if ( n < 1 || ( n > 1 && ! cqm_list_supported(iface) ) )
+		return -1;
+
+	msg = nlmsg_alloc();
+	if ( ! msg )
+		return -1;
+
+	genlmsg_put(msg, 0, 0, nl80211_id, 0, 0, NL80211_CMD_SET_CQM, 0);
+	nla_put_u32(msg, NL80211_ATTR_IFINDEX, iface->ifindex);
+	cqm = nla_nest_start(msg, NL80211_ATTR_CQM);
+	nla_put(msg, NL80211_ATTR_CQM_RSSI_THOLD, n * sizeof(*thold), thold);
+	nla_put_u32(msg, NL80211_ATTR_CQM_RSSI_HYST, CQM_HYSTERESIS);
+	nla_nest_end(msg, cqm);
+
+	if (nl80211_request(msg, NULL, NULL))
+		return -1;
+
+	syslog(LOG_INFO, "%s: using %d signal thresholds\n", iface->ifname, n);
+
+	return 0;
+}
+
+void update_iface(iface_t *iface)
+{
+	int q = quality(iface);
+
+	update_leds(iface->rules, q);
+	iface->q0 = q;
+}
+
+static int nl80211_event(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nla_iter it;
+	struct nlattr *nla;
+	iface_t *iface;
+	int ifindex;
+
+	/* every mlme event of every interface ends up here */
+	nla_iter_init(&it, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0),
+		      event_cpolicy);
+	while ( (nla = nla_iter_next(&it)) )
+		if ( nla_type(nla) == NL80211_ATTR_IFINDEX )
+			break;
+
+	if ( ! nla )
+		return NL_SKIP;
+
+	ifindex = nla_get_u32(nla);
+	for (iface = arg; iface; iface = iface->next)
+		if ( iface->cqm && iface->ifindex == ifindex )
+			break;
+
+	if ( ! iface )
+		return NL_SKIP;
+
+	switch (gnlh->cmd) {
+	case NL80211_CMD_CONNECT:
+		/* thresholds may be gone after the interface went down */
+		if (cqm_setup(iface)) {
+			iface->cqm = 0;
+			iface->next_poll = now_ms();
+			break;
+		}
+		/* fall through */
+	case NL80211_CMD_NOTIFY_CQM:
+	case NL80211_CMD_DISCONNECT:
+		update_iface(iface);
+		break;
+	}
+
+	return NL_SKIP;
+}
+
+int nl80211_init(iface_t *ifaces)
+{
+	int mlme;
+
+	nl_cmd = nl_socket_alloc();
+	nl_event = nl_socket_alloc();
+	nl_event_cb = nl_cb_alloc(NL_CB_DEFAULT);
+	event_cpolicy = nla_policy_compile(event_policy, NL80211_ATTR_IFINDEX,
+					   NULL, 0);
+	if ( ! nl_cmd || ! nl_event || ! nl_event_cb || ! event_cpolicy )
+		goto err;
+
+	if ( genl_connect(nl_cmd) || genl_connect(nl_event) )
+		goto err;
+
+	nl80211_id = genl_ctrl_resolve(nl_cmd, "nl80211");
+	mlme = genl_ctrl_resolve_grp(nl_cmd, "nl80211", "mlme");
+	if ( nl80211_id < 0 || mlme < 0 )
+		goto err;
+
+	if ( nl_socket_add_membership(nl_event, mlme) )
+		goto err;
+
+	nl_socket_disable_seq_check(nl_event);
+	nl_socket_set_nonblocking(nl_event);
+	nl_cb_set(nl_event_cb, NL_CB_VALID, NL_CB_CUSTOM, nl80211_event, ifaces);
+
+	return 0;
+
+err:
+	if (event_cpolicy)
+		nla_policy_free(event_cpolicy);
+	if (nl_event_cb)
+		nl_cb_put(nl_event_cb);
+	if (nl_event)
+		nl_socket_free(nl_event);
+	if (nl_cmd)
+		nl_socket_free(nl_cmd);
+	event_cpolicy = NULL;
+	nl_event_cb = NULL;
+	nl_event = NULL;
+	nl_cmd = NULL;
+	nl80211_id = -1;
+
+	return -1;
+}
+
+/* (ifname) (refresh) (threshold) (rule) [rule] ... up to "--" or the end */
+int parse_iface(int argc, char **argv, int i, iface_t **ifacep)
+{
+	iface_t *iface;
+	rule_t **rulep;
+
+	if ( argc - i < 8 )
+		return -1;
+
+	iface = calloc(sizeof(iface_t), 1);
+	if ( ! iface )
+		return -1;
+
+	iface->ifname = argv[i];
+	iface->q0 = -1;
 
 	/* refresh interval */
-	if ( sscanf(argv[2], "%d", &r) != 1 )
-		return 1;
+	if ( sscanf(argv[i+1], "%d", &iface->refresh) != 1 )
+		return -1;
+
+	if ( iface->refresh < 1000 )
+		iface->refresh = 1000;
 
 	/* sustain threshold */
-	if ( sscanf(argv[3], "%d", &s) != 1 )
-		return 1;
+	if ( sscanf(argv[i+2], "%d", &iface->threshold) != 1 )
+		return -1;
+
+	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n",
+		iface->ifname, iface->refresh, iface->threshold);
+
+	rulep = &iface->rules;
+	for (i = i + 3; i < argc && strcmp(argv[i], "--"); i = i + 5) {
+		if ( argc - i < 5 )
+			return -1;
+
+		*rulep = calloc(sizeof(rule_t), 1);
+		if ( ! *rulep )
+			return -1;
+
+		if ( init_led(&((*rulep)->led), argv[i]) )
+			return -1;
+
+		if ( sscanf(argv[i+1], "%d", &((*rulep)->minq)) != 1 )
+			return -1;
+
+		if ( sscanf(argv[i+2], "%d", &((*rulep)->maxq)) != 1 )
+			return -1;
+
+		if ( sscanf(argv[i+3], "%d", &((*rulep)->boffset)) != 1 )
+			return -1;
+
+		if ( sscanf(argv[i+4], "%d", &((*rulep)->bfactor)) != 1 )
+			return -1;
+
+		rulep = &(*rulep)->next;
+	}
+	log_rules(iface->rules);
+
+	*ifacep = iface;
+
+	/* skip the separator */
+	return i < argc ? i + 1 : i;
+}
+
+int main(int argc, char **argv)
+{
+	iface_t *ifaces = NULL, **ifacep = &ifaces, *iface;
+	struct pollfd pfd;
+	long long now;
+	int i, timeout;
 
 	openlog("rssileds", LOG_PID, LOG_DAEMON);
-	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n", ifname, r, s);
 
-	currentrule = headrule;
-	for (i=4; i<argc; i=i+5) {
-		if (! currentrule)
+	for (i = 1; i < argc || ! ifaces; ifacep = &(*ifacep)->next) {
+		i = parse_iface(argc, argv, i, ifacep);
+		if ( i < 0 )
 		{
-			/* first element in the list */
-			currentrule = calloc(sizeof(rule_t),1);
-			headrule = currentrule;
-		}
-		else
-		{
-			/* follow-up element */
-			currentrule->next = calloc(sizeof(rule_t),1);
-			currentrule = currentrule->next;
+			printf("syntax: %s (ifname) (refresh) (threshold) (rule) [rule] ... [-- (ifname) ...]\n", argv[0]);
+			printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
+			return 1;
 		}
+	}
 
-		if ( init_led(&(currentrule->led), argv[i]) )
-			return 1;
-		
-		if ( sscanf(argv[i+1], "%d", &(currentrule->minq)) != 1 )
-			return 1;
+	if (nl80211_init(ifaces))
+		syslog(LOG_INFO, "nl80211 not available, polling all interfaces\n");
 
-		if ( sscanf(argv[i+2], "%d", &(currentrule->maxq)) != 1 )
-			return 1;
-		
-		if ( sscanf(argv[i+3], "%d", &(currentrule->boffset)) != 1 )
-			return 1;
-		
-		if ( sscanf(argv[i+4], "%d", &(currentrule->bfactor)) != 1 )
-			return 1;
+	for (iface = ifaces; iface; iface = iface->next) {
+		if ( open_backend(&iface->iw, iface->ifname) || cqm_setup(iface) )
+			continue;
+
+		iface->cqm = 1;
+		update_iface(iface);
 	}
-	log_rules(headrule);
 
-	q0 = -1;
+	pfd.fd = nl_event ? nl_socket_get_fd(nl_event) : -1;
+	pfd.events = POLLIN;
+
 	do {
-		q = quality(iw, ifname);
-		if ( q < q0 - s || q > q0 + s ) {
-			update_leds(headrule, q);
-			q0=q;
-		};
-		// re-open backend...
-		if ( q == -1 && q0 == -1 ) {
-			if (iw) {
-				iwinfo_finish();
-				iw=NULL;
-				usleep(BACKEND_RETRY_DELAY);
-			}
-			while (open_backend(&iw, ifname))
-				usleep(BACKEND_RETRY_DELAY);
+		now = now_ms();
+		timeout = -1;
+
+		for (iface = ifaces; iface; iface = iface->next) {
+			if ( iface->cqm )
+				continue;
+
+			if ( iface->next_poll <= now )
+				poll_iface(iface, now);
+
+			if ( timeout < 0 || iface->next_poll - now < timeout )
+				timeout = iface->next_poll - now;
+		}
+
+		if ( poll(&pfd, 1, timeout) > 0 && nl_recvmsgs(nl_event, nl_event_cb) < 0 ) {
+			/* events were lost, resynchronize */
+			for (iface = ifaces; iface; iface = iface->next)
+				if ( iface->cqm )
+					update_iface(iface);
 		}
-		usleep(r);
 	} while(1);
 
 	iwinfo_finish();
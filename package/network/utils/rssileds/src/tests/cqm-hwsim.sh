@@ -0,0 +1,121 @@
+#!/bin/sh
+# Checks that rssileds follows the signal of a mac80211_hwsim station
+# through CQM events with the four LED setup of the cpe830/cpe870 boards
+# (factor 13, threshold 1). The refresh interval is 200 s, so the LEDs
+# only track the sweep if the events arrive.
+#
+# The station signal is the AP tx power - 50 dBm in mac80211_hwsim, the
+# sweep moves the AP tx power. The LEDs are userspace LEDs from uleds.
+#
+# usage: cqm-hwsim.sh
+# Needs root, hostapd, iw and rssileds in PATH.
+
+DIR="$(mktemp -d /tmp/cqm-hwsim.XXXXXX)"
+FAIL=0
+
+cleanup() {
+	[ -n "$RSSILEDS_PID" ] && kill "$RSSILEDS_PID"
+	[ -n "$HOSTAPD_PID" ] && kill "$HOSTAPD_PID"
+	exec 3>&- 4>&- 5>&- 6>&-
+	rmmod mac80211_hwsim 2>/dev/null
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+# struct uleds_user_dev: char name[64], int max_brightness (255, LE)
+add_led() {
+	{
+		printf '%s' "$1"
+		head -c $((64 - ${#1})) /dev/zero
+		printf '\377\000\000\000'
+	} | dd bs=68 count=1 iflag=fullblock status=none
+}
+
+modprobe uleds || exit 1
+modprobe mac80211_hwsim radios=2 || exit 1
+sleep 1
+
+exec 3<>/dev/uleds 4<>/dev/uleds 5<>/dev/uleds 6<>/dev/uleds
+add_led cqm0 >&3 && add_led cqm1 >&4 && add_led cqm2 >&5 && add_led cqm3 >&6 || exit 1
+
+cat > "$DIR/hostapd.conf" <<EOF
+interface=wlan0
+driver=nl80211
+ssid=cqm-hwsim
+hw_mode=g
+channel=1
+EOF
+
+hostapd "$DIR/hostapd.conf" &
+HOSTAPD_PID=$!
+sleep 3
+
+iw dev wlan0 set txpower fixed 0
+ip link set wlan1 up
+iw dev wlan1 connect cqm-hwsim || exit 1
+sleep 3
+
+rssileds wlan1 200000 1 \
+	cqm0 1 100 0 13 \
+	cqm1 26 100 -25 13 \
+	cqm2 51 100 -50 13 \
+	cqm3 76 100 -75 13 &
+RSSILEDS_PID=$!
+sleep 2
+
+clamp() {
+	[ "$1" -lt 0 ] && echo 0 && return
+	[ "$1" -gt 255 ] && echo 255 && return
+	echo "$1"
+}
+
+# brightness of a rule for quality $1: minq offset
+expect() {
+	[ "$1" -lt "$2" ] && echo 0 && return
+	clamp $((($1 + $3) * 13))
+}
+
+# the brightness may lag a threshold step and the hysteresis behind
+TOLERANCE=26
+SEEN=""
+
+for power in 0 2 4 6 8 10 12 14 16 18 20 18 16 14 12 10 8 6 4 2 0; do
+	iw dev wlan0 set txpower fixed "${power}00"
+	sleep 3
+
+	signal="$(iw dev wlan1 link | awk '/signal:/ { print $2 }')"
+	[ -n "$signal" ] || { echo "wlan1 not associated"; exit 1; }
+
+	# iwinfo: quality = signal + 110 of at most 70, in percent
+	qual=$((signal + 110))
+	[ "$qual" -gt 70 ] && qual=70
+	q=$((qual * 100 / 70))
+
+	line="signal $signal q $q:"
+	i=0
+	for rule in "1 0" "26 -25" "51 -50" "76 -75"; do
+		want="$(expect "$q" $rule)"
+		have="$(cat /sys/class/leds/cqm$i/brightness)"
+		diff=$((have - want))
+		[ "$diff" -lt 0 ] && diff=$((-diff))
+		if [ "$diff" -gt "$TOLERANCE" ]; then
+			line="$line cqm$i=$have (want $want) !"
+			FAIL=1
+		else
+			line="$line cqm$i=$have"
+		fi
+		i=$((i + 1))
+	done
+	echo "$line"
+
+	SEEN="$SEEN $(cat /sys/class/leds/cqm3/brightness)"
+done
+
+# the top LED must have moved, it is the one that froze before
+if [ "$(echo $SEEN | tr ' ' '\n' | sort -u | wc -l)" -lt 3 ]; then
+	echo "cqm3 did not follow the signal:$SEEN"
+	FAIL=1
+fi
+
+[ "$FAIL" = 0 ] && echo "PASS" || echo "FAIL"
+exit "$FAIL"
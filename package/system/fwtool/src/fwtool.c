@@ -11,6 +11,7 @@
  * GNU General Public License for more details.
  */
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <getopt.h>
 #include <stdbool.h>
@@ -27,6 +28,9 @@
 
 #define BUFLEN			(METADATA_MAXLEN + SIGNATURE_MAXLEN + 1024)
 
+#define READ_BUFLEN		(64 * 1024)
+#define MAX_TRAILERS		16
+
 enum {
 	MODE_DEFAULT = -1,
 	MODE_EXTRACT = 0,
@@ -40,6 +44,21 @@ struct data_buf {
 	int file_len;
 };
 
+enum trailer_action {
+	TRAILER_SKIP,
+	TRAILER_EXTRACT,
+	TRAILER_SIZE_ERROR,
+};
+
+struct trailer_pos {
+	struct fwimage_trailer tr;
+	off_t offset;
+	off_t data_offset;
+	int data_len;
+	uint32_t crc32;
+	enum trailer_action action;
+};
+
 static FILE *signature_file, *metadata_file, *firmware_file;
 static int file_mode = MODE_DEFAULT;
 static bool truncate_file;
@@ -273,12 +292,185 @@ validate_metadata(struct fwimage_header *hdr, int data_len)
 	 return 0;
 }
 
+static int
+file_crc32(int fd, struct trailer_pos *t, int n)
+{
+	off_t end = t[0].offset;
+	off_t base, done = 0;
+	uint32_t crc32 = ~0;
+	ssize_t len;
+	char *buf;
+	int i = n - 1;
+
+	/*
+	 * Single forward pass over everything in front of the outermost
+	 * trailer, recording the running CRC at the start of each trailer.
+	 */
+	if (posix_memalign((void **) &buf, 4096, READ_BUFLEN))
+		return 1;
+
+	for (base = 0; base < end; base += len) {
+		len = pread(fd, buf, READ_BUFLEN, base);
+		if (len <= 0) {
+			free(buf);
+			return 1;
+		}
+
+		if (len > end - base)
+			len = end - base;
+
+		while (i >= 0 && t[i].offset <= base + len) {
+			crc32 = crc32_block(crc32, buf + (done - base),
+					    t[i].offset - done, crc_table);
+			done = t[i].offset;
+			t[i--].crc32 = crc32;
+		}
+
+		crc32 = crc32_block(crc32, buf + (done - base),
+				    base + len - done, crc_table);
+		done = base + len;
+	}
+
+	while (i >= 0)
+		t[i--].crc32 = crc32;
+
+	free(buf);
+	return 0;
+}
+
+static int
+copy_data(int fd, off_t offset, int len, FILE *out)
+{
+	char buf[4096];
+
+	while (len > 0) {
+		ssize_t cur = len;
+
+		if (cur > (ssize_t) sizeof(buf))
+			cur = sizeof(buf);
+
+		cur = pread(fd, buf, cur, offset);
+		if (cur <= 0)
+			return 1;
+
+		fwrite(buf, cur, 1, out);
+		offset += cur;
+		len -= cur;
+	}
+
+	return 0;
+}
+
+static int
+extract_data_file(int fd, off_t file_len)
+{
+	struct trailer_pos t[MAX_TRAILERS];
+	struct fwimage_header hdr;
+	const char *err = NULL;
+	off_t end = file_len;
+	int ret = 1;
+	int i, n;
+
+	/* walk the trailer chain from the end without reading the image */
+	for (n = 0; n < MAX_TRAILERS; n++) {
+		struct trailer_pos *cur = &t[n];
+
+		if (end < (off_t) sizeof(cur->tr))
+			break;
+
+		cur->offset = end - sizeof(cur->tr);
+		if (pread(fd, &cur->tr, sizeof(cur->tr), cur->offset) !=
+		    sizeof(cur->tr))
+			break;
+
+		if (cur->tr.magic != cpu_to_be32(FWIMAGE_MAGIC)) {
+			err = "Data not found\n";
+			break;
+		}
+
+		cur->data_len = be32_to_cpu(cur->tr.size) - sizeof(cur->tr);
+		cur->data_offset = cur->offset - cur->data_len;
+		cur->action = TRAILER_SKIP;
+
+		if (cur->data_len < 0 || cur->data_len > BUFLEN ||
+		    cur->data_offset < 0) {
+			cur->action = TRAILER_SIZE_ERROR;
+			n++;
+			break;
+		}
+
+		end = cur->data_offset;
+
+		if (cur->tr.type == FWIMAGE_SIGNATURE) {
+			if (!signature_file)
+				continue;
+		} else if (cur->tr.type == FWIMAGE_INFO) {
+			if (!metadata_file) {
+				n++;
+				break;
+			}
+
+			if (cur->data_len < (int) sizeof(hdr) ||
+			    pread(fd, &hdr, sizeof(hdr), cur->data_offset) !=
+			    sizeof(hdr) ||
+			    validate_metadata(&hdr, cur->data_len - sizeof(hdr)))
+				continue;
+
+			cur->data_offset += sizeof(hdr);
+			cur->data_len -= sizeof(hdr);
+		} else {
+			continue;
+		}
+
+		cur->action = TRAILER_EXTRACT;
+		n++;
+		break;
+	}
+
+	if (n && file_crc32(fd, t, n))
+		return 1;
+
+	for (i = 0; i < n; i++) {
+		if (be32_to_cpu(t[i].tr.crc32) != t[i].crc32) {
+			msg("CRC error\n");
+			return 1;
+		}
+
+		if (t[i].action == TRAILER_SIZE_ERROR) {
+			msg("Size error\n");
+			return 1;
+		}
+
+		if (t[i].action != TRAILER_EXTRACT)
+			continue;
+
+		ret = copy_data(fd, t[i].data_offset, t[i].data_len,
+				signature_file ? signature_file : metadata_file);
+		if (ret)
+			return ret;
+
+		if (t[i].tr.type == FWIMAGE_INFO)
+			t[i].data_offset -= sizeof(hdr);
+
+		if (truncate_file)
+			ftruncate(fd, t[i].data_offset);
+
+		return 0;
+	}
+
+	if (err && i == n)
+		msg("%s", err);
+
+	return ret;
+}
+
 static int
 extract_data(const char *name)
 {
 	struct fwimage_header *hdr;
 	struct fwimage_trailer tr;
 	struct data_buf dbuf = {};
+	struct stat st;
 	uint32_t crc32 = ~0;
 	int ret = 1;
 	void *buf;
@@ -294,6 +486,10 @@ extract_data(const char *name)
 		return 1;
 	}
 
+	/* regular files are validated in place, pipes need to be buffered */
+	if (!fstat(fileno(firmware_file), &st) && S_ISREG(st.st_mode))
+		return extract_data_file(fileno(firmware_file), st.st_size);
+
 	buf = malloc(BUFLEN);
 	if (!buf)
 		return 1;
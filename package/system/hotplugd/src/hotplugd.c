@@ -0,0 +1,988 @@
+/*
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Resident dispatcher for /etc/hotplug.d. /sbin/hotplug-call hands its
+ * environment over a unix socket instead of running the scripts itself.
+ * The script list of each subsystem is kept in memory and refreshed
+ * through inotify. Scripts may declare in their header which events
+ * they care about:
+ *
+ *   # hotplug-match: ACTION=ifup,ifdown INTERFACE=wan*
+ *
+ * Every listed variable has to match one of the comma separated
+ * patterns, other scripts are skipped without being run. The matching
+ * scripts of an event run in one shell, events of different devices
+ * run in parallel up to a worker limit while events of the same device
+ * keep their order. hotplug-call waits for its event and gets the exit
+ * status of the scripts back. When the queue is full, clients are not
+ * read from until it drains.
+ */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+
+#include <libubox/uloop.h>
+#include <libubox/list.h>
+#include <libubox/utils.h>
+
+#define HOTPLUG_DIR	"/etc/hotplug.d"
+#define SOCK_PATH	"/var/run/hotplugd.sock"
+#define MSG_MAXLEN	16384
+#define HEADER_LINES	16
+#define MATCH_TAG	"hotplug-match:"
+#define QUEUE_MAX	256
+
+/* exit status of -s if the event could not be handed over */
+#define EXIT_UNHANDLED	255
+
+#define MSG_EVENT	'E'
+#define MSG_CALL	'C'
+#define MSG_SYNC	'S'
+
+struct match {
+	char *key;
+	char **patterns;
+};
+
+struct script {
+	char *path;
+	struct match *match;
+	int n_match;
+};
+
+struct subsys {
+	struct list_head list;
+	char *name;
+	int wd;
+	bool valid;
+
+	struct script *scripts;
+	int n_scripts;
+};
+
+struct client;
+
+struct event {
+	struct list_head list;
+	struct uloop_process proc;
+	bool running;
+
+	/* waiting for the exit status, MSG_CALL only */
+	struct client *cl;
+
+	const char *type;
+	const char *key;
+	char **env;
+	char *data;
+};
+
+struct client {
+	struct list_head list;
+	struct uloop_fd fd;
+	bool sync;
+
+	/* message held back while the queue is full */
+	char *pending;
+	int pending_len;
+};
+
+static const char runner[] =
+	". /lib/functions.sh\n"
+	"for script in \"$@\"; do (\n"
+	"\t[ -f \"$script\" ] && . \"$script\"\n"
+	"); done\n";
+
+static LIST_HEAD(subsystems);
+static LIST_HEAD(queue);
+static LIST_HEAD(clients);
+static struct uloop_fd server_fd, inotify_fd;
+static int top_wd = -1;
+static int n_running, max_workers;
+static int n_queued, max_queued = QUEUE_MAX;
+static FILE *log_file;
+
+extern char **environ;
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<options>]\n"
+		"\n"
+		"Options:\n"
+		"  -j <count>:		Maximum number of events handled in parallel\n"
+		"  -q <count>:		Maximum number of queued events (default: %d)\n"
+		"  -l <file>:		Record received events for replaying them later\n"
+		"  -s <type>:		Run an event with the current environment and\n"
+		"			exit with the status of its scripts\n"
+		"  -r <file>:		Replay recorded events and report the event rate\n"
+		"\n", progname, QUEUE_MAX);
+	return 1;
+}
+
+static void
+free_scripts(struct subsys *s)
+{
+	int i, j;
+
+	for (i = 0; i < s->n_scripts; i++) {
+		struct script *sc = &s->scripts[i];
+
+		for (j = 0; j < sc->n_match; j++) {
+			free(sc->match[j].key);
+			free(sc->match[j].patterns);
+		}
+		free(sc->match);
+		free(sc->path);
+	}
+
+	free(s->scripts);
+	s->scripts = NULL;
+	s->n_scripts = 0;
+}
+
+/* KEY=pattern[,pattern...], the patterns share the allocation of the key */
+static int
+parse_match(struct script *sc, char *word)
+{
+	struct match *m;
+	char *val, *p, *save;
+	int n = 2;
+
+	val = strchr(word, '=');
+	if (!val || val == word)
+		return -1;
+
+	for (p = val; *p; p++)
+		if (*p == ',')
+			n++;
+
+	m = realloc(sc->match, (sc->n_match + 1) * sizeof(*m));
+	if (!m)
+		return -1;
+
+	sc->match = m;
+	m = &sc->match[sc->n_match];
+	m->key = strdup(word);
+	m->patterns = calloc(n, sizeof(char *));
+	if (!m->key || !m->patterns) {
+		free(m->key);
+		free(m->patterns);
+		return -1;
+	}
+
+	val = m->key + (val - word);
+	*val++ = 0;
+	for (n = 0, p = strtok_r(val, ",", &save); p; p = strtok_r(NULL, ",", &save))
+		m->patterns[n++] = p;
+
+	sc->n_match++;
+	return 0;
+}
+
+static void
+parse_header(struct script *sc)
+{
+	char line[256];
+	char *p, *word, *save;
+	FILE *f;
+	int i;
+
+	f = fopen(sc->path, "r");
+	if (!f)
+		return;
+
+	for (i = 0; i < HEADER_LINES && fgets(line, sizeof(line), f); i++) {
+		p = line + strspn(line, " \t");
+		if (*p == '\n' || !*p)
+			continue;
+
+		if (*p != '#')
+			break;
+
+		p += strspn(p, "# \t");
+		if (strncmp(p, MATCH_TAG, strlen(MATCH_TAG)) != 0)
+			continue;
+
+		p += strlen(MATCH_TAG);
+		for (word = strtok_r(p, " \t\n", &save); word;
+		     word = strtok_r(NULL, " \t\n", &save)) {
+			if (parse_match(sc, word))
+				fprintf(stderr, "%s: invalid match '%s'\n",
+					sc->path, word);
+		}
+	}
+
+	fclose(f);
+}
+
+static int
+script_filter(const struct dirent *d)
+{
+	return d->d_name[0] != '.';
+}
+
+static void
+subsys_scan(struct subsys *s)
+{
+	struct dirent **names;
+	struct stat st;
+	char path[PATH_MAX];
+	int i, n;
+
+	free_scripts(s);
+	s->valid = true;
+
+	snprintf(path, sizeof(path), "%s/%s", HOTPLUG_DIR, s->name);
+	if (s->wd < 0)
+		s->wd = inotify_add_watch(inotify_fd.fd, path,
+					  IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+					  IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB |
+					  IN_DELETE_SELF);
+
+	n = scandir(path, &names, script_filter, alphasort);
+	if (n < 0)
+		return;
+
+	s->scripts = calloc(n, sizeof(*s->scripts));
+	for (i = 0; i < n; i++) {
+		struct script *sc;
+
+		snprintf(path, sizeof(path), "%s/%s/%s", HOTPLUG_DIR, s->name,
+			 names[i]->d_name);
+		free(names[i]);
+
+		if (!s->scripts || stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		sc = &s->scripts[s->n_scripts++];
+		sc->path = strdup(path);
+		parse_header(sc);
+	}
+
+	free(names);
+}
+
+static struct subsys *
+subsys_find(const char *name, int wd)
+{
+	struct subsys *s;
+
+	list_for_each_entry(s, &subsystems, list) {
+		if (name ? !strcmp(s->name, name) : s->wd == wd)
+			return s;
+	}
+
+	return NULL;
+}
+
+static struct subsys *
+subsys_get(const char *name)
+{
+	struct subsys *s = subsys_find(name, -1);
+
+	if (!s) {
+		s = calloc(1, sizeof(*s));
+		if (!s)
+			return NULL;
+
+		s->name = strdup(name);
+		s->wd = -1;
+		list_add_tail(&s->list, &subsystems);
+	}
+
+	if (!s->valid)
+		subsys_scan(s);
+
+	return s;
+}
+
+static void
+inotify_cb(struct uloop_fd *u, unsigned int events)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	struct subsys *s;
+	ssize_t len;
+	char *p;
+
+	while ((len = read(u->fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *) p;
+
+			/* changes were lost, any script list may be stale */
+			if (ev->mask & IN_Q_OVERFLOW) {
+				list_for_each_entry(s, &subsystems, list)
+					s->valid = false;
+				continue;
+			}
+
+			if (ev->wd == top_wd)
+				s = ev->len ? subsys_find(ev->name, -1) : NULL;
+			else
+				s = subsys_find(NULL, ev->wd);
+
+			if (!s)
+				continue;
+
+			s->valid = false;
+			if (ev->mask & IN_IGNORED)
+				s->wd = -1;
+		}
+	}
+}
+
+static const char *
+event_getenv(struct event *ev, const char *name)
+{
+	size_t len = strlen(name);
+	char **e;
+
+	for (e = ev->env; *e; e++) {
+		if (!strncmp(*e, name, len) && (*e)[len] == '=')
+			return *e + len + 1;
+	}
+
+	return NULL;
+}
+
+static bool
+script_matches(struct script *sc, struct event *ev)
+{
+	const char *val;
+	char **pat;
+	int i;
+
+	for (i = 0; i < sc->n_match; i++) {
+		val = event_getenv(ev, sc->match[i].key);
+		if (!val)
+			val = "";
+
+		for (pat = sc->match[i].patterns; *pat; pat++) {
+			if (!fnmatch(*pat, val, 0))
+				break;
+		}
+
+		if (!*pat)
+			return false;
+	}
+
+	return true;
+}
+
+static void
+client_reply(struct client *cl, const char *msg, int len)
+{
+	if (send(cl->fd.fd, msg, len, MSG_NOSIGNAL) < 0 && errno != EAGAIN)
+		cl->fd.eof = true;
+}
+
+static void
+check_idle(void)
+{
+	struct client *cl;
+
+	if (!list_empty(&queue))
+		return;
+
+	list_for_each_entry(cl, &clients, list) {
+		if (!cl->sync)
+			continue;
+
+		cl->sync = false;
+		client_reply(cl, (char []) { MSG_SYNC }, 1);
+	}
+}
+
+/* hands the exit status to a waiting client and drops the event */
+static void
+event_finish(struct event *ev, int status)
+{
+	if (ev->cl) {
+		/* 255 tells hotplug-call that the event was not handled */
+		if (status >= EXIT_UNHANDLED)
+			status = EXIT_UNHANDLED - 1;
+
+		client_reply(ev->cl, (char []) { MSG_CALL, status }, 2);
+	}
+
+	list_del(&ev->list);
+	n_queued--;
+	free(ev->env);
+	free(ev->data);
+	free(ev);
+}
+
+static void dispatch(void);
+
+static void
+event_exit(struct uloop_process *p, int ret)
+{
+	struct event *ev = container_of(p, struct event, proc);
+
+	n_running--;
+	if (WIFEXITED(ret))
+		event_finish(ev, WEXITSTATUS(ret));
+	else
+		event_finish(ev, 128 + WTERMSIG(ret));
+	dispatch();
+}
+
+/*
+ * Returns false if no process was started for the event, with the exit
+ * status to report in *status: 0 if there was nothing to run.
+ */
+static bool
+event_start(struct event *ev, int *status)
+{
+	struct subsys *s = subsys_get(ev->type);
+	const char **argv;
+	int i, n = 0;
+	pid_t pid;
+
+	*status = 0;
+	if (!s || !s->n_scripts)
+		return false;
+
+	*status = 1;
+	argv = calloc(s->n_scripts + 5, sizeof(*argv));
+	if (!argv)
+		return false;
+
+	argv[n++] = "sh";
+	argv[n++] = "-c";
+	argv[n++] = runner;
+	argv[n++] = "hotplug-call";
+	for (i = 0; i < s->n_scripts; i++) {
+		if (script_matches(&s->scripts[i], ev))
+			argv[n++] = s->scripts[i].path;
+	}
+
+	if (n == 4) {
+		free(argv);
+		*status = 0;
+		return false;
+	}
+
+	pid = fork();
+	if (!pid) {
+		execve("/bin/sh", (char **) argv, ev->env);
+		_exit(127);
+	}
+
+	free(argv);
+	if (pid < 0)
+		return false;
+
+	ev->proc.pid = pid;
+	ev->proc.cb = event_exit;
+	uloop_process_add(&ev->proc);
+	ev->running = true;
+	n_running++;
+
+	return true;
+}
+
+/* events of a device have to wait for all earlier ones of the same device */
+static bool
+event_blocked(struct event *ev)
+{
+	struct event *cur;
+
+	list_for_each_entry(cur, &queue, list) {
+		if (cur == ev)
+			break;
+
+		if (!strcmp(cur->key, ev->key))
+			return true;
+	}
+
+	return false;
+}
+
+static int client_msg(struct client *cl, const char *buf, int len);
+
+/* takes the held back messages of clients while there is room again */
+static bool
+resume_clients(void)
+{
+	struct client *cl;
+	bool resumed = false;
+	char *msg;
+
+	list_for_each_entry(cl, &clients, list) {
+		if (!cl->pending || n_queued >= max_queued)
+			continue;
+
+		msg = cl->pending;
+		cl->pending = NULL;
+		if (client_msg(cl, msg, cl->pending_len) < 0)
+			shutdown(cl->fd.fd, SHUT_RDWR);
+		free(msg);
+
+		uloop_fd_add(&cl->fd, ULOOP_READ);
+		resumed = true;
+	}
+
+	return resumed;
+}
+
+static void
+dispatch(void)
+{
+	struct event *ev, *tmp;
+	int status;
+
+	do {
+		list_for_each_entry_safe(ev, tmp, &queue, list) {
+			if (n_running >= max_workers)
+				break;
+
+			if (ev->running || event_blocked(ev))
+				continue;
+
+			if (!event_start(ev, &status))
+				event_finish(ev, status);
+		}
+	} while (resume_clients());
+
+	check_idle();
+}
+
+static void
+log_event(struct event *ev)
+{
+	char **e;
+
+	fprintf(log_file, "%s\n", ev->type);
+	for (e = ev->env; *e; e++)
+		fprintf(log_file, "%s\n", *e);
+	fprintf(log_file, "\n");
+	fflush(log_file);
+}
+
+/* <type>\0<VAR>=<value>\0... */
+static struct event *
+queue_event(const char *data, int len)
+{
+	static const char * const keys[] = { "DEVPATH", "INTERFACE", "DEVICENAME" };
+	struct event *ev;
+	char *p, *end;
+	int i, n = 0;
+
+	if (!len || data[len - 1] || strchr(data, '/') || data[0] == '.')
+		return NULL;
+
+	ev = calloc(1, sizeof(*ev));
+	if (!ev)
+		return NULL;
+
+	ev->data = malloc(len);
+	if (!ev->data)
+		goto error;
+
+	memcpy(ev->data, data, len);
+	end = ev->data + len;
+	for (p = ev->data; p < end; p += strlen(p) + 1)
+		n++;
+
+	ev->env = calloc(n, sizeof(char *));
+	if (!ev->env)
+		goto error;
+
+	ev->type = ev->data;
+	for (n = 0, p = ev->data + strlen(ev->data) + 1; p < end; p += strlen(p) + 1)
+		ev->env[n++] = p;
+
+	ev->key = ev->type;
+	for (i = 0; i < ARRAY_SIZE(keys); i++) {
+		const char *val = event_getenv(ev, keys[i]);
+
+		if (val && *val) {
+			ev->key = val;
+			break;
+		}
+	}
+
+	if (log_file)
+		log_event(ev);
+
+	list_add_tail(&ev->list, &queue);
+	n_queued++;
+	return ev;
+
+error:
+	free(ev->data);
+	free(ev);
+	return NULL;
+}
+
+static void
+client_free(struct client *cl)
+{
+	struct event *ev;
+
+	list_for_each_entry(ev, &queue, list) {
+		if (ev->cl == cl)
+			ev->cl = NULL;
+	}
+
+	uloop_fd_delete(&cl->fd);
+	close(cl->fd.fd);
+	list_del(&cl->list);
+	free(cl->pending);
+	free(cl);
+}
+
+/* returns 1 if the message was held back because the queue is full */
+static int
+client_msg(struct client *cl, const char *buf, int len)
+{
+	struct event *ev;
+
+	switch (buf[0]) {
+	case MSG_EVENT:
+	case MSG_CALL:
+		if (n_queued >= max_queued) {
+			cl->pending = malloc(len);
+			if (!cl->pending)
+				return -1;
+
+			memcpy(cl->pending, buf, len);
+			cl->pending_len = len;
+			uloop_fd_delete(&cl->fd);
+			return 1;
+		}
+
+		ev = queue_event(buf + 1, len - 1);
+		if (!ev)
+			return -1;
+
+		if (buf[0] == MSG_CALL)
+			ev->cl = cl;
+		else
+			client_reply(cl, buf, 1);
+		return 0;
+	case MSG_SYNC:
+		cl->sync = true;
+		return 0;
+	}
+
+	return -1;
+}
+
+static void
+client_cb(struct uloop_fd *u, unsigned int events)
+{
+	struct client *cl = container_of(u, struct client, fd);
+	static char buf[MSG_MAXLEN];
+	ssize_t len;
+	int ret;
+
+	while (!u->eof) {
+		len = recv(u->fd, buf, sizeof(buf), 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno == EAGAIN)
+			return;
+		if (len <= 0)
+			break;
+
+		ret = client_msg(cl, buf, len);
+		if (ret < 0)
+			u->eof = true;
+		dispatch();
+
+		if (ret > 0)
+			return;
+	}
+
+	client_free(cl);
+}
+
+static void
+server_cb(struct uloop_fd *u, unsigned int events)
+{
+	struct client *cl;
+	int fd;
+
+	while ((fd = accept4(u->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		cl = calloc(1, sizeof(*cl));
+		if (!cl) {
+			close(fd);
+			continue;
+		}
+
+		cl->fd.fd = fd;
+		cl->fd.cb = client_cb;
+		list_add_tail(&cl->list, &clients);
+		uloop_fd_add(&cl->fd, ULOOP_READ);
+	}
+}
+
+static int
+server_init(void)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	int fd;
+
+	strncpy(sun.sun_path, SOCK_PATH, sizeof(sun.sun_path) - 1);
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(SOCK_PATH);
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) ||
+	    chmod(SOCK_PATH, 0600) || listen(fd, 16)) {
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+
+	server_fd.fd = fd;
+	server_fd.cb = server_cb;
+	uloop_fd_add(&server_fd, ULOOP_READ);
+
+	inotify_fd.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd.fd < 0) {
+		perror("inotify_init");
+		return -1;
+	}
+
+	top_wd = inotify_add_watch(inotify_fd.fd, HOTPLUG_DIR,
+				   IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+				   IN_MOVED_TO);
+	inotify_fd.cb = inotify_cb;
+	uloop_fd_add(&inotify_fd, ULOOP_READ);
+
+	return 0;
+}
+
+static int
+run_server(void)
+{
+	uloop_init();
+	if (server_init())
+		return 1;
+
+	uloop_run();
+	unlink(SOCK_PATH);
+	uloop_done();
+
+	return 0;
+}
+
+static int
+client_connect(void)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	int fd;
+
+	strncpy(sun.sun_path, SOCK_PATH, sizeof(sun.sun_path) - 1);
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *) &sun, sizeof(sun))) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+client_request(int fd, const char *msg, int len, char reply)
+{
+	char buf;
+
+	if (send(fd, msg, len, 0) != len ||
+	    recv(fd, &buf, 1, 0) != 1 || buf != reply)
+		return -1;
+
+	return 0;
+}
+
+static int
+msg_add(char *buf, int len, const char *str)
+{
+	int slen = strlen(str) + 1;
+
+	if (len < 0 || len + slen > MSG_MAXLEN)
+		return -1;
+
+	memcpy(buf + len, str, slen);
+	return len + slen;
+}
+
+/* waits for the scripts of the event, returns their exit status */
+static int
+send_event(const char *type)
+{
+	static char buf[MSG_MAXLEN];
+	char reply[2];
+	char **e;
+	int fd, len = 1;
+
+	buf[0] = MSG_CALL;
+	len = msg_add(buf, len, type);
+	for (e = environ; *e; e++)
+		len = msg_add(buf, len, *e);
+
+	if (len < 0)
+		return EXIT_UNHANDLED;
+
+	fd = client_connect();
+	if (fd < 0)
+		return EXIT_UNHANDLED;
+
+	if (send(fd, buf, len, 0) != len) {
+		close(fd);
+		return EXIT_UNHANDLED;
+	}
+
+	/* the scripts may have run already, do not have them run again */
+	while ((len = recv(fd, reply, sizeof(reply), 0)) < 0 && errno == EINTR)
+		;
+	close(fd);
+
+	if (len != 2 || reply[0] != MSG_CALL)
+		return 1;
+
+	return (unsigned char) reply[1];
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* events as written by -l: type line, VAR=value lines, empty line */
+static int
+replay(const char *file)
+{
+	static char buf[MSG_MAXLEN];
+	char line[4096];
+	double start;
+	int fd, len = 0, count = 0;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror("fopen");
+		return 1;
+	}
+
+	fd = client_connect();
+	if (fd < 0) {
+		fprintf(stderr, "Cannot connect to %s\n", SOCK_PATH);
+		fclose(f);
+		return 1;
+	}
+
+	start = now();
+	while (1) {
+		bool eof = !fgets(line, sizeof(line), f);
+
+		line[strcspn(line, "\n")] = 0;
+		if (!eof && line[0]) {
+			if (!len) {
+				buf[0] = MSG_EVENT;
+				len = 1;
+			}
+			len = msg_add(buf, len, line);
+			continue;
+		}
+
+		if (len > 1) {
+			if (client_request(fd, buf, len, MSG_EVENT)) {
+				fprintf(stderr, "Event %d was not accepted\n", count + 1);
+				break;
+			}
+			count++;
+		}
+		len = 0;
+
+		if (eof)
+			break;
+	}
+
+	buf[0] = MSG_SYNC;
+	if (client_request(fd, buf, 1, MSG_SYNC))
+		fprintf(stderr, "Lost connection while waiting for completion\n");
+	else
+		printf("%d events in %.3f s, %.1f events/s\n", count,
+		       now() - start, count / (now() - start));
+
+	close(fd);
+	fclose(f);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *progname = argv[0];
+	int ch;
+
+	max_workers = sysconf(_SC_NPROCESSORS_ONLN) * 2;
+	if (max_workers < 2)
+		max_workers = 2;
+
+	while ((ch = getopt(argc, argv, "j:l:q:r:s:")) != -1) {
+		switch (ch) {
+		case 'j':
+			max_workers = atoi(optarg);
+			if (max_workers < 1)
+				max_workers = 1;
+			break;
+		case 'q':
+			max_queued = atoi(optarg);
+			if (max_queued < 1)
+				max_queued = 1;
+			break;
+		case 'l':
+			log_file = fopen(optarg, "a");
+			if (!log_file) {
+				perror("fopen");
+				return 1;
+			}
+			break;
+		case 'r':
+			return replay(optarg);
+		case 's':
+			return send_event(optarg);
+		default:
+			return usage(progname);
+		}
+	}
+
+	return run_server();
+}
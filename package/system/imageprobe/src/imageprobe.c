@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Identifies a sysupgrade image from a single read of its header and
+ * prints the magic values and header fields used by the platform upgrade
+ * scripts as shell variables. Compressed images are only decompressed as
+ * far as the header and the requested offsets reach.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+
+#define HEAD_LEN		(64 * 1024)
+#define MAX_OFFSETS		16
+#define MAX_TRAILERS		4
+
+#define FWIMAGE_MAGIC		0x46577830 /* FWx0 */
+#define FWIMAGE_SIGNATURE	0
+#define FWIMAGE_INFO		1
+#define FWIMAGE_TRAILER_LEN	16
+#define FWIMAGE_HEADER_LEN	8
+
+static unsigned char head[HEAD_LEN];
+static size_t head_len;
+
+static const char *field;
+static bool field_found;
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<options>] <image>\n"
+		"\n"
+		"Options:\n"
+		"  -c <command>:		Read the image through <command> instead of\n"
+		"			detecting gzip or bzip2 compression\n"
+		"  -o <offset>:		Also print the 32 bit word at <offset> as\n"
+		"			img_magic_long_<offset>\n"
+		"  -f <field>:		Only print the value of img_<field>\n"
+		"\n", progname);
+	return 1;
+}
+
+static void
+print_var(const char *name, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void
+print_var(const char *name, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (field && strcmp(field, name))
+		return;
+
+	if (field)
+		field_found = true;
+	else
+		printf("img_%s=", name);
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	putchar('\n');
+}
+
+static void
+print_string(const char *name, const char *str, size_t maxlen)
+{
+	char buf[256];
+	size_t i, len = 0;
+
+	for (i = 0; i < maxlen && str[i] && len < sizeof(buf) - 5; i++) {
+		if (field) {
+			buf[len++] = str[i];
+		} else if (str[i] == '\'') {
+			memcpy(buf + len, "'\\''", 4);
+			len += 4;
+		} else if ((unsigned char) str[i] >= 0x20) {
+			buf[len++] = str[i];
+		}
+	}
+	buf[len] = 0;
+
+	print_var(name, field ? "%s" : "'%s'", buf);
+}
+
+static void
+print_hex(const char *name, size_t offset, size_t len)
+{
+	char buf[2 * 8 + 1] = "";
+	size_t i;
+
+	for (i = 0; i < len && offset + i < head_len; i++)
+		sprintf(buf + 2 * i, "%02x", head[offset + i]);
+
+	print_var(name, "%s", buf);
+}
+
+static uint32_t
+get_be32(size_t offset)
+{
+	const unsigned char *p = head + offset;
+
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint32_t
+get_le32(size_t offset)
+{
+	const unsigned char *p = head + offset;
+
+	return (p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+static uint16_t
+get_be16(size_t offset)
+{
+	return (head[offset] << 8) | head[offset + 1];
+}
+
+static uint16_t
+get_le16(size_t offset)
+{
+	return (head[offset + 1] << 8) | head[offset];
+}
+
+static ssize_t
+read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = read(fd, (char *) buf + done, len - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		if (!r)
+			break;
+		done += r;
+	}
+
+	return done;
+}
+
+static pid_t
+open_command(const char *cmd, const char *file, int *fd)
+{
+	int pfd[2];
+	pid_t pid;
+
+	if (pipe(pfd))
+		return -1;
+
+	pid = fork();
+	if (pid < 0) {
+		close(pfd[0]);
+		close(pfd[1]);
+		return -1;
+	}
+
+	if (!pid) {
+		close(pfd[0]);
+		dup2(pfd[1], STDOUT_FILENO);
+		close(pfd[1]);
+		execlp(cmd, cmd, file, NULL);
+		_exit(127);
+	}
+
+	close(pfd[1]);
+	*fd = pfd[0];
+	return pid;
+}
+
+static void
+close_command(pid_t pid, int fd)
+{
+	/* stop the decompressor once everything needed was read */
+	close(fd);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+struct probe_word {
+	unsigned long offset;
+	uint32_t val;
+	int len;
+};
+
+/* collects the bytes of the words that fall within a block of the image */
+static int
+collect_words(struct probe_word *w, int n, const unsigned char *buf,
+	      unsigned long pos, size_t len)
+{
+	int i, done = 0;
+
+	for (i = 0; i < n; i++) {
+		while (w[i].len < 4) {
+			unsigned long cur = w[i].offset + w[i].len;
+
+			if (cur < pos || cur >= pos + len)
+				break;
+
+			w[i].val = (w[i].val << 8) | buf[cur - pos];
+			w[i].len++;
+		}
+
+		if (w[i].len == 4)
+			done++;
+	}
+
+	return done;
+}
+
+/* reads on through the stream until all requested words are found */
+static void
+read_words(int fd, bool seekable, struct probe_word *w, int n)
+{
+	static unsigned char buf[HEAD_LEN];
+	unsigned long pos = head_len;
+	ssize_t len;
+	int i;
+
+	if (collect_words(w, n, head, 0, head_len) == n || head_len < HEAD_LEN)
+		return;
+
+	if (seekable) {
+		for (i = 0; i < n; i++)
+			if (w[i].len < 4 &&
+			    pread(fd, buf, 4, w[i].offset) == 4)
+				collect_words(&w[i], 1, buf, w[i].offset, 4);
+		return;
+	}
+
+	do {
+		len = read_full(fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+		pos += len;
+	} while (collect_words(w, n, buf, pos - len, len) < n);
+}
+
+static void
+probe_trx(void)
+{
+	int n_parts = get_le16(14) > 1 ? 4 : 3;
+	char buf[64];
+	int i, len = 0;
+
+	print_var("type", "trx");
+	print_var("trx_len", "%u", get_le32(4));
+	print_var("trx_crc", "%08x", get_le32(8));
+	print_var("trx_flags", "%u", get_le16(12));
+	print_var("trx_version", "%u", get_le16(14));
+	for (i = 0; i < n_parts; i++)
+		len += sprintf(buf + len, "%s%u", i ? " " : "",
+			       get_le32(16 + 4 * i));
+	print_var("trx_offsets", field ? "%s" : "'%s'", buf);
+}
+
+static void
+probe_seama(void)
+{
+	uint16_t metasize = get_be16(6);
+
+	print_var("type", "seama");
+	print_var("seama_metasize", "%u", metasize);
+	print_var("seama_size", "%u", get_be32(8));
+	if ((size_t) 12 + metasize <= head_len)
+		print_string("seama_meta", (const char *) head + 12, metasize);
+}
+
+static void
+probe_uimage(void)
+{
+	print_var("type", "uimage");
+	print_var("uimage_size", "%u", get_be32(12));
+	print_var("uimage_load", "%08x", get_be32(16));
+	print_var("uimage_ep", "%08x", get_be32(20));
+	print_var("uimage_dcrc", "%08x", get_be32(24));
+	print_var("uimage_os", "%u", head[28]);
+	print_var("uimage_arch", "%u", head[29]);
+	print_var("uimage_imgtype", "%u", head[30]);
+	print_var("uimage_comp", "%u", head[31]);
+	print_string("uimage_name", (const char *) head + 32, 32);
+}
+
+static void
+probe_squashfs(bool be)
+{
+	static const char * const comp[] = {
+		"unknown", "gzip", "lzma", "lzo", "xz", "lz4", "zstd",
+	};
+	uint16_t id = be ? get_be16(20) : get_le16(20);
+	uint32_t size;
+
+	/* only the low 32 bits of the 64 bit bytes_used are relevant */
+	size = be ? get_be32(44) : get_le32(40);
+
+	print_var("type", "squashfs");
+	print_var("squashfs_size", "%u", size);
+	print_var("squashfs_block_size", "%u", be ? get_be32(12) : get_le32(12));
+	print_var("squashfs_compression", "%s",
+		  id < sizeof(comp) / sizeof(comp[0]) ? comp[id] : "unknown");
+}
+
+static void
+probe_ubi(void)
+{
+	print_var("type", "ubi");
+	print_var("ubi_version", "%u", head[4]);
+	print_var("ubi_vid_hdr_offset", "%u", get_be32(16));
+	print_var("ubi_data_offset", "%u", get_be32(20));
+}
+
+static void
+probe_type(void)
+{
+	uint32_t magic;
+
+	if (head_len < 64) {
+		print_var("type", "unknown");
+		return;
+	}
+
+	magic = get_be32(0);
+	switch (magic) {
+	case 0x48445230: /* HDR0 */
+		probe_trx();
+		return;
+	case 0x5ea3a417:
+		probe_seama();
+		return;
+	case 0x27051956:
+		probe_uimage();
+		return;
+	case 0xd00dfeed:
+		print_var("type", "fit");
+		print_var("fit_size", "%u", get_be32(4));
+		return;
+	case 0x68737173: /* hsqs */
+		probe_squashfs(false);
+		return;
+	case 0x73717368: /* sqsh */
+		probe_squashfs(true);
+		return;
+	case 0x55424923: /* UBI# */
+		probe_ubi();
+		return;
+	}
+
+	if (head_len >= 512 && !memcmp(head + 257, "ustar", 5)) {
+		print_var("type", "tar");
+		print_string("tar_first", (const char *) head, 100);
+		return;
+	}
+
+	print_var("type", "unknown");
+}
+
+/* walks the fwtool trailer chain at the end of the raw image file */
+static void
+probe_fwtool(int fd)
+{
+	unsigned char tr[FWIMAGE_TRAILER_LEN];
+	struct stat st;
+	off_t end;
+	uint32_t size;
+	int i;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+		return;
+
+	end = st.st_size;
+	for (i = 0; i < MAX_TRAILERS && end >= FWIMAGE_TRAILER_LEN; i++) {
+		if (pread(fd, tr, sizeof(tr), end - sizeof(tr)) != sizeof(tr))
+			break;
+
+		if (((tr[0] << 24) | (tr[1] << 16) | (tr[2] << 8) | tr[3]) !=
+		    FWIMAGE_MAGIC)
+			break;
+
+		size = (tr[12] << 24) | (tr[13] << 16) | (tr[14] << 8) | tr[15];
+		if (size < FWIMAGE_TRAILER_LEN || size > end)
+			break;
+
+		end -= size;
+		if (tr[8] == FWIMAGE_SIGNATURE) {
+			print_var("fwtool_signature", "1");
+		} else if (tr[8] == FWIMAGE_INFO &&
+			   size >= FWIMAGE_TRAILER_LEN + FWIMAGE_HEADER_LEN) {
+			print_var("fwtool_metadata_offset", "%lld",
+				  (long long) end + FWIMAGE_HEADER_LEN);
+			print_var("fwtool_metadata_length", "%u", size -
+				  FWIMAGE_TRAILER_LEN - FWIMAGE_HEADER_LEN);
+		}
+	}
+
+	print_var("data_size", "%lld", (long long) end);
+}
+
+int main(int argc, char **argv)
+{
+	struct probe_word words[MAX_OFFSETS] = {};
+	const char *progname = argv[0];
+	const char *cmd = NULL;
+	const char *compression = "none";
+	const char *file;
+	char name[32];
+	int n_offsets = 0;
+	int fd, in_fd, ch, i;
+	pid_t pid = -1;
+	ssize_t len;
+
+	while ((ch = getopt(argc, argv, "c:f:o:")) != -1) {
+		switch (ch) {
+		case 'c':
+			cmd = optarg;
+			break;
+		case 'f':
+			field = optarg;
+			break;
+		case 'o':
+			if (n_offsets == MAX_OFFSETS)
+				return usage(progname);
+			words[n_offsets++].offset = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return usage(progname);
+		}
+	}
+
+	if (optind + 1 != argc)
+		return usage(progname);
+
+	file = argv[optind];
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", file, strerror(errno));
+		return 1;
+	}
+
+	if (!cmd) {
+		unsigned char magic[2];
+
+		if (pread(fd, magic, sizeof(magic), 0) == sizeof(magic)) {
+			if (magic[0] == 0x1f && magic[1] == 0x8b) {
+				cmd = "zcat";
+				compression = "gzip";
+			} else if (magic[0] == 0x42 && magic[1] == 0x5a) {
+				cmd = "bzcat";
+				compression = "bzip2";
+			}
+		}
+	} else if (strcmp(cmd, "cat") != 0) {
+		compression = cmd;
+	}
+
+	in_fd = fd;
+	if (cmd && strcmp(cmd, "cat") != 0) {
+		pid = open_command(cmd, file, &in_fd);
+		if (pid < 0) {
+			fprintf(stderr, "Cannot run %s: %s\n", cmd, strerror(errno));
+			close(fd);
+			return 1;
+		}
+	}
+
+	len = read_full(in_fd, head, sizeof(head));
+	head_len = len > 0 ? len : 0;
+	read_words(in_fd, pid < 0, words, n_offsets);
+
+	if (pid > 0)
+		close_command(pid, in_fd);
+
+	print_var("compression", "%s", compression);
+	print_hex("magic_word", 0, 2);
+	print_hex("magic_long", 0, 4);
+	for (i = 0; i < n_offsets; i++) {
+		snprintf(name, sizeof(name), "magic_long_%lu", words[i].offset);
+		if (words[i].len == 4)
+			print_var(name, "%08x", words[i].val);
+		else
+			print_var(name, "%s", "");
+	}
+	probe_type();
+	probe_fwtool(fd);
+
+	close(fd);
+
+	return field && !field_found;
+}
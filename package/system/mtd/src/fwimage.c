@@ -0,0 +1,269 @@
+/*
+ * fwimage.c: fwtool trailer validation for streamed images
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A helper process sits between the image source and mtd. It passes the
+ * image data on as it arrives and keeps back only a window at the end of
+ * the stream that is large enough for the fwtool trailers. Once the source
+ * ends, the trailer checksums are compared against the CRC of everything
+ * passed on, and the exit status of the helper tells mtd whether the image
+ * is intact. The beginning of the stream can be stored in a file as well,
+ * for header checks of the data that was actually written.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <byteswap.h>
+#include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "crc32.h"
+#include "mtd.h"
+
+#define FWIMAGE_MAGIC		0x46577830 /* FWx0 */
+#define FWIMAGE_SIGNATURE	0
+#define FWIMAGE_INFO		1
+#define FWIMAGE_MAX_TRAILERS	4
+
+/* fwtool limits metadata to 30 KiB and signatures to 1 KiB */
+#define FWIMAGE_TAIL_LEN	(64 * 1024)
+#define FWIMAGE_CHUNK_LEN	(64 * 1024)
+
+/* as much as sysupgrade fetches for the platform check of a stream */
+#define FWIMAGE_HEAD_LEN	FWIMAGE_CHUNK_LEN
+
+struct fwimage_trailer {
+	uint32_t magic;
+	uint32_t crc32;
+	uint8_t type;
+	uint8_t __pad[3];
+	uint32_t size;
+};
+
+struct fwimage_header {
+	uint32_t version;
+	uint32_t flags;
+};
+
+static int
+write_full(int fd, const unsigned char *buf, size_t len)
+{
+	ssize_t r;
+
+	while (len > 0) {
+		r = write(fd, buf, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		buf += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+static uint32_t
+get_be32(const void *p)
+{
+	const unsigned char *b = p;
+
+	return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+/*
+ * Checks the trailer chain at the end of the window. crc is the running
+ * CRC of all data before the window, *data_len is set to the image data
+ * left in the window.
+ */
+static int
+fwimage_check_tail(const unsigned char *win, size_t len, uint32_t crc,
+		   size_t *data_len, const char *metafile)
+{
+	struct fwimage_trailer tr[FWIMAGE_MAX_TRAILERS];
+	size_t ofs[FWIMAGE_MAX_TRAILERS];
+	size_t end = len, done = 0;
+	int n, i, meta = -1;
+
+	for (n = 0; n < FWIMAGE_MAX_TRAILERS && end >= sizeof(tr[0]); n++) {
+		memcpy(&tr[n], win + end - sizeof(tr[n]), sizeof(tr[n]));
+		if (get_be32(&tr[n].magic) != FWIMAGE_MAGIC)
+			break;
+
+		if (get_be32(&tr[n].size) < sizeof(tr[n]) ||
+		    get_be32(&tr[n].size) > end) {
+			fprintf(stderr, "Image trailer size error\n");
+			return -1;
+		}
+
+		ofs[n] = end - sizeof(tr[n]);
+		end -= get_be32(&tr[n].size);
+		if (tr[n].type == FWIMAGE_INFO && meta < 0)
+			meta = n;
+	}
+
+	if (!n) {
+		fprintf(stderr, "Image trailer not found\n");
+		return -1;
+	}
+
+	/* innermost trailer first, each covers everything in front of it */
+	for (i = n - 1; i >= 0; i--) {
+		crc = crc32(crc, win + done, ofs[i] - done);
+		done = ofs[i];
+		if (crc != get_be32(&tr[i].crc32)) {
+			fprintf(stderr, "Image CRC error\n");
+			return -1;
+		}
+	}
+
+	if (meta >= 0 && metafile) {
+		size_t meta_len = get_be32(&tr[meta].size) - sizeof(tr[meta]);
+		const unsigned char *data = win + ofs[meta] - meta_len;
+		struct fwimage_header hdr;
+		int fd;
+
+		memcpy(&hdr, data, sizeof(hdr));
+		if (meta_len < sizeof(hdr) || hdr.version != 0) {
+			fprintf(stderr, "Invalid image metadata\n");
+			return -1;
+		}
+
+		fd = open(metafile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || write_full(fd, data + sizeof(hdr),
+					 meta_len - sizeof(hdr))) {
+			fprintf(stderr, "Could not write metadata to %s\n",
+				metafile);
+			if (fd >= 0)
+				close(fd);
+			return -1;
+		}
+		close(fd);
+	}
+
+	*data_len = end;
+	return 0;
+}
+
+static int
+fwimage_write_head(const char *headfile, const unsigned char *data, size_t len)
+{
+	int fd, ret;
+
+	if (len > FWIMAGE_HEAD_LEN)
+		len = FWIMAGE_HEAD_LEN;
+
+	fd = open(headfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		ret = -1;
+	else
+		ret = write_full(fd, data, len);
+
+	if (fd >= 0 && close(fd))
+		ret = -1;
+	if (ret)
+		fprintf(stderr, "Could not write the image head to %s\n", headfile);
+
+	return ret;
+}
+
+static int
+fwimage_stream(int in, int out, const char *metafile, const char *headfile)
+{
+	size_t cap = FWIMAGE_TAIL_LEN + FWIMAGE_CHUNK_LEN;
+	unsigned char *win = malloc(cap);
+	size_t len = 0, data_len;
+	uint32_t crc = 0xffffffff;
+	ssize_t r;
+
+	if (!win)
+		return 1;
+
+	while (1) {
+		r = read(in, win + len, cap - len);
+		if (r < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (r < 0) {
+			perror("read");
+			return 1;
+		}
+		if (!r)
+			break;
+
+		len += r;
+		if (len < cap)
+			continue;
+
+		if (headfile && fwimage_write_head(headfile, win, len))
+			return 1;
+		headfile = NULL;
+
+		/* pass on everything that cannot be part of the trailers */
+		crc = crc32(crc, win, FWIMAGE_CHUNK_LEN);
+		if (write_full(out, win, FWIMAGE_CHUNK_LEN))
+			return 1;
+
+		memmove(win, win + FWIMAGE_CHUNK_LEN, FWIMAGE_TAIL_LEN);
+		len = FWIMAGE_TAIL_LEN;
+	}
+
+	if (headfile && fwimage_write_head(headfile, win, len))
+		return 1;
+
+	if (fwimage_check_tail(win, len, crc, &data_len, metafile))
+		return 1;
+
+	return write_full(out, win, data_len) ? 1 : 0;
+}
+
+int fwimage_stream_start(int imagefd, const char *metafile,
+			 const char *headfile, pid_t *pid)
+{
+	int pfd[2];
+
+	if (pipe(pfd))
+		return -1;
+
+	*pid = fork();
+	if (*pid < 0) {
+		close(pfd[0]);
+		close(pfd[1]);
+		return -1;
+	}
+
+	if (!*pid) {
+		close(pfd[0]);
+		_exit(fwimage_stream(imagefd, pfd[1], metafile, headfile));
+	}
+
+	close(pfd[1]);
+	close(imagefd);
+
+	return pfd[0];
+}
+
+int fwimage_stream_wait(pid_t pid)
+{
+	int status;
+
+	while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return -1;
+
+	return WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : -1;
+}
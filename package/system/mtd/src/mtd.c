@@ -91,6 +91,13 @@ int erasesize = 0;
 int jffs2_skip_bytes=0;
 int mtdtype = 0;
 
+/* streamed image verification, the first block is held back until it passed */
+static char *stream_meta = NULL, *stream_head = NULL, *stream_check = NULL;
+static pid_t stream_pid = -1;
+static char *head_buf = NULL, *head_mtd = NULL;
+static int head_len = 0;
+static off_t head_ofs = 0;
+
 int mtd_open(const char *mtd, bool block)
 {
 	FILE *fp;
@@ -449,6 +456,59 @@ out:
 	return ret;
 }
 
+static void
+stream_hold_head(int fd, const char *mtd, const char *data, int len)
+{
+	head_buf = malloc(len);
+	head_mtd = strdup(mtd);
+	if (!head_buf || !head_mtd) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	memcpy(head_buf, data, len);
+	head_len = len;
+	head_ofs = lseek(fd, 0, SEEK_CUR);
+	lseek(fd, len, SEEK_CUR);
+}
+
+static int
+stream_commit(int fd, const char *mtd)
+{
+	int head_fd = fd;
+
+	if (fwimage_stream_wait(stream_pid)) {
+		fprintf(stderr, "\nImage verification failed, not writing the first block.\n");
+		return -1;
+	}
+
+	if (stream_check && system(stream_check) != 0) {
+		fprintf(stderr, "\nImage check '%s' failed, not writing the first block.\n",
+			stream_check);
+		return -1;
+	}
+
+	if (!head_buf)
+		return 0;
+
+	if (strcmp(head_mtd, mtd) != 0) {
+		head_fd = mtd_check_open(head_mtd);
+		if (head_fd < 0)
+			return -1;
+	}
+
+	lseek(head_fd, head_ofs, SEEK_SET);
+	if (write(head_fd, head_buf, head_len) < head_len) {
+		fprintf(stderr, "\nError writing the first block.\n");
+		return -1;
+	}
+
+	if (head_fd != fd)
+		close(head_fd);
+
+	return 0;
+}
+
 static void
 indicate_writing(const char *mtd)
 {
@@ -660,7 +720,9 @@ resume:
 		if (!quiet)
 			fprintf(stderr, "\b\b\b[w]");
 
-		if ((result = write(fd, buf + offset, buflen)) < buflen) {
+		if (stream_pid > 0 && !head_buf) {
+			stream_hold_head(fd, mtd, buf + offset, buflen);
+		} else if ((result = write(fd, buf + offset, buflen)) < buflen) {
 			if (result < 0) {
 				fprintf(stderr, "Error writing image.\n");
 				exit(1);
@@ -675,6 +737,9 @@ resume:
 		offset = 0;
 	}
 
+	if (stream_pid > 0 && stream_commit(fd, mtd) < 0)
+		exit(1);
+
 	if (jffs2_replaced) {
 		switch (imageformat) {
 		case MTD_IMAGE_FORMAT_TRX:
@@ -750,6 +815,12 @@ static void usage(void)
 	"        -j <name>               integrate <file> into jffs2 data when writing an image\n"
 	"        -s <number>             skip the first n bytes when appending data to the jffs2 partiton, defaults to \"0\"\n"
 	"        -p <number>             write beginning at partition offset\n"
+	"        -t <file>               verify the fwtool trailer of the image while writing,\n"
+	"                                store its metadata in <file> and write the first\n"
+	"                                block only after the image passed\n"
+	"        -H <file>               store the first 64 KiB of the image in <file> (with -t)\n"
+	"        -T <command>            run <command> after the image was verified, the first\n"
+	"                                block is only written if it succeeds (with -t)\n"
 	"        -l <length>             the length of data that we want to dump\n");
 	if (mtd_fixtrx) {
 	    fprintf(stderr,
@@ -815,7 +886,7 @@ int main (int argc, char **argv)
 #ifdef FIS_SUPPORT
 			"F:"
 #endif
-			"frnqe:d:s:j:p:o:c:l:")) != -1)
+			"frnqe:d:s:j:p:o:c:l:t:H:T:")) != -1)
 		switch (ch) {
 			case 'f':
 				force = 1;
@@ -840,6 +911,15 @@ int main (int argc, char **argv)
 			case 'q':
 				quiet++;
 				break;
+			case 't':
+				stream_meta = optarg;
+				break;
+			case 'H':
+				stream_head = optarg;
+				break;
+			case 'T':
+				stream_check = optarg;
+				break;
 			case 'e':
 				i = 0;
 				while ((erase[i] != NULL) && ((i + 1) < MAX_ARGS))
@@ -942,6 +1022,16 @@ int main (int argc, char **argv)
 			fprintf(stderr, "Can't open device for writing!\n");
 			exit(1);
 		}
+
+		if (stream_meta) {
+			imagefd = fwimage_stream_start(imagefd, stream_meta,
+						       stream_head, &stream_pid);
+			if (imagefd < 0) {
+				fprintf(stderr, "Could not start image verification\n");
+				exit(1);
+			}
+		}
+
 		/* check trx file before erasing or writing anything */
 		if (!image_check(imagefd, device) && !force) {
 			fprintf(stderr, "Image check failed.\n");
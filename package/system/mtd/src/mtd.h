@@ -2,6 +2,7 @@
 #define __mtd_h
 
 #include <stdbool.h>
+#include <sys/types.h>
 
 #if defined(target_brcm47xx) || defined(target_bcm53xx)
 #define target_brcm 1
@@ -21,6 +22,9 @@ extern int mtd_write_buffer(int fd, const char *buf, int offset, int length);
 extern int mtd_write_jffs2(const char *mtd, const char *filename, const char *dir);
 extern int mtd_replace_jffs2(const char *mtd, int fd, int ofs, const char *filename);
 extern void mtd_parse_jffs2data(const char *buf, const char *dir);
+extern int fwimage_stream_start(int imagefd, const char *metafile,
+				const char *headfile, pid_t *pid);
+extern int fwimage_stream_wait(pid_t pid);
 
 /* target specific functions */
 extern int trx_fixup(int fd, const char *name)  __attribute__ ((weak));
@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Reads the member index of an uncompressed sysupgrade tar from its
+ * headers only and streams single members to stdout or into a UBI
+ * volume update, so the image data is read exactly once.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <mtd/ubi-user.h>
+
+#define TAR_BLOCK		512
+#define READ_BUFLEN		(64 * 1024)
+#define MAX_NAMELEN		1024
+
+struct tar_header {
+	char name[100];
+	char mode[8];
+	char uid[8];
+	char gid[8];
+	char size[12];
+	char mtime[12];
+	char chksum[8];
+	char typeflag;
+	char linkname[100];
+	char magic[6];
+	char version[2];
+	char uname[32];
+	char gname[32];
+	char devmajor[8];
+	char devminor[8];
+	char prefix[155];
+	char pad[12];
+};
+
+struct tar_member {
+	char name[MAX_NAMELEN];
+	char type;
+	off_t offset;
+	uint64_t size;
+};
+
+static int tar_fd = -1;
+static off_t tar_pos;
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s <command> <tar file> [<args>]\n"
+		"\n"
+		"Commands:\n"
+		"  list <tar> [<dir>]:		Print the members of <dir> (default: the first\n"
+		"				sysupgrade-* directory) as shell variables\n"
+		"  cat <tar> <member>:		Write a member to stdout\n"
+		"  ubi <tar> <member> <vol>:	Write a member to a UBI volume device\n"
+		"\n", progname);
+	return 1;
+}
+
+static int
+read_full(int fd, void *buf, size_t len, off_t offset)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = pread(fd, (char *) buf + done, len - done, offset + done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		done += r;
+	}
+
+	return 0;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < len) {
+		r = write(fd, (const char *) buf + done, len - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		done += r;
+	}
+
+	return 0;
+}
+
+static uint64_t
+parse_number(const char *field, int len)
+{
+	uint64_t val = 0;
+	int i;
+
+	/* GNU base-256 encoding for sizes that do not fit the octal field */
+	if (field[0] & 0x80) {
+		val = field[0] & 0x3f;
+		for (i = 1; i < len; i++)
+			val = (val << 8) | (unsigned char) field[i];
+		return val;
+	}
+
+	for (i = 0; i < len && field[i] == ' '; i++);
+	for (; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+		val = (val << 3) | (field[i] - '0');
+
+	return val;
+}
+
+static bool
+header_valid(const struct tar_header *h)
+{
+	const unsigned char *p = (const unsigned char *) h;
+	unsigned int sum = 0;
+	int i;
+
+	for (i = 0; i < TAR_BLOCK; i++) {
+		if (i >= 148 && i < 156)
+			sum += ' ';
+		else
+			sum += p[i];
+	}
+
+	return sum == parse_number(h->chksum, sizeof(h->chksum));
+}
+
+static bool
+block_empty(const void *buf)
+{
+	const char *p = buf;
+	int i;
+
+	for (i = 0; i < TAR_BLOCK; i++)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static void
+copy_field(char *dest, const char *src, size_t len)
+{
+	memcpy(dest, src, len);
+	dest[len] = 0;
+}
+
+static int
+pax_path(uint64_t size, char *name)
+{
+	char buf[4096];
+	char *rec, *key, *end;
+	unsigned long len;
+
+	if (size >= sizeof(buf) || read_full(tar_fd, buf, size, tar_pos))
+		return -1;
+
+	buf[size] = 0;
+	for (rec = buf; rec < buf + size; rec += len) {
+		len = strtoul(rec, &key, 10);
+		if (!len || rec + len > buf + size || *key != ' ')
+			return -1;
+
+		key++;
+		end = rec + len - 1;
+		if (*end != '\n' || strncmp(key, "path=", 5))
+			continue;
+
+		key += 5;
+		if (end - key >= MAX_NAMELEN)
+			return -1;
+
+		memcpy(name, key, end - key);
+		name[end - key] = 0;
+		return 0;
+	}
+
+	return -1;
+}
+
+/*
+ * Fetch the next member header, returns 1 at the end of the archive.
+ * Only the headers are read, member data is skipped by offset.
+ */
+static int
+next_member(struct tar_member *m)
+{
+	union {
+		struct tar_header h;
+		char buf[TAR_BLOCK];
+	} blk;
+	bool long_name = false;
+	uint64_t size;
+
+	while (1) {
+		if (read_full(tar_fd, &blk, TAR_BLOCK, tar_pos))
+			return 1;
+
+		if (block_empty(&blk))
+			return 1;
+
+		if (!header_valid(&blk.h)) {
+			fprintf(stderr, "Invalid tar header at offset %lld\n",
+				(long long) tar_pos);
+			return -1;
+		}
+
+		size = parse_number(blk.h.size, sizeof(blk.h.size));
+		tar_pos += TAR_BLOCK;
+
+		switch (blk.h.typeflag) {
+		case 'L':
+			/* GNU long name, applies to the following header */
+			if (size >= MAX_NAMELEN ||
+			    read_full(tar_fd, m->name, size, tar_pos))
+				return -1;
+			m->name[size] = 0;
+			long_name = true;
+			break;
+		case 'x':
+			/* pax extended header, only the path record is used */
+			if (!pax_path(size, m->name))
+				long_name = true;
+			break;
+		case 'K':
+		case 'g':
+			break;
+		default:
+			if (!long_name) {
+				m->name[0] = 0;
+				if (!memcmp(blk.h.magic, "ustar", 5) && blk.h.prefix[0]) {
+					copy_field(m->name, blk.h.prefix, sizeof(blk.h.prefix));
+					strcat(m->name, "/");
+				}
+				copy_field(m->name + strlen(m->name), blk.h.name,
+					   sizeof(blk.h.name));
+			}
+			m->type = blk.h.typeflag;
+			m->offset = tar_pos;
+			m->size = size;
+			tar_pos += (size + TAR_BLOCK - 1) & ~(uint64_t) (TAR_BLOCK - 1);
+			return 0;
+		}
+
+		tar_pos += (size + TAR_BLOCK - 1) & ~(uint64_t) (TAR_BLOCK - 1);
+	}
+}
+
+static bool
+member_is_file(const struct tar_member *m)
+{
+	return m->type == '0' || m->type == '\0' || m->type == '7';
+}
+
+static void
+strip_slashes(char *name)
+{
+	int len = strlen(name);
+
+	while (len > 0 && name[len - 1] == '/')
+		name[--len] = 0;
+}
+
+static int
+find_member(const char *name, struct tar_member *m)
+{
+	int ret;
+
+	tar_pos = 0;
+	while (!(ret = next_member(m))) {
+		if (member_is_file(m) && !strcmp(m->name, name))
+			return 0;
+	}
+
+	if (ret > 0)
+		fprintf(stderr, "Member %s not found\n", name);
+
+	return -1;
+}
+
+static void
+print_quoted(const char *str)
+{
+	putchar('\'');
+	for (; *str; str++) {
+		if (*str == '\'')
+			fputs("'\\''", stdout);
+		else
+			putchar(*str);
+	}
+	putchar('\'');
+}
+
+static void
+print_varname(const char *name)
+{
+	if (*name >= '0' && *name <= '9')
+		putchar('_');
+
+	for (; *name; name++) {
+		if ((*name >= 'a' && *name <= 'z') ||
+		    (*name >= 'A' && *name <= 'Z') ||
+		    (*name >= '0' && *name <= '9'))
+			putchar(*name);
+		else
+			putchar('_');
+	}
+}
+
+static void
+print_member(const char *base, const struct tar_member *m)
+{
+	unsigned char magic[4];
+	int len = m->size < sizeof(magic) ? m->size : sizeof(magic);
+	int i;
+
+	print_varname(base);
+	printf("_offset=%lld\n", (long long) m->offset);
+	print_varname(base);
+	printf("_length=%llu\n", (unsigned long long) m->size);
+	print_varname(base);
+	printf("_magic=");
+	if (len && !read_full(tar_fd, magic, len, m->offset))
+		for (i = 0; i < len; i++)
+			printf("%02x", magic[i]);
+	putchar('\n');
+}
+
+static int
+cmd_list(const char *dir)
+{
+	struct tar_member m;
+	char prefix[MAX_NAMELEN + 1] = "";
+	const char *base;
+	int plen = 0;
+	int ret;
+
+	if (dir) {
+		snprintf(prefix, sizeof(prefix), "%s", dir);
+		strip_slashes(prefix);
+		plen = strlen(prefix);
+	}
+
+	while (!(ret = next_member(&m))) {
+		strip_slashes(m.name);
+
+		if (!plen) {
+			if (strncmp(m.name, "sysupgrade-", 11))
+				continue;
+
+			/* archives do not need to carry the directory entry */
+			snprintf(prefix, sizeof(prefix), "%s", m.name);
+			plen = strcspn(prefix, "/");
+			prefix[plen] = 0;
+			if (m.type == '5')
+				continue;
+		}
+
+		if (!member_is_file(&m) || strncmp(m.name, prefix, plen) ||
+		    m.name[plen] != '/')
+			continue;
+
+		base = m.name + plen + 1;
+		if (!*base || strchr(base, '/'))
+			continue;
+
+		print_member(base, &m);
+	}
+
+	if (ret < 0)
+		return 1;
+
+	if (plen) {
+		printf("board_dir=");
+		print_quoted(prefix);
+		putchar('\n');
+	}
+
+	return 0;
+}
+
+static int
+copy_member(const struct tar_member *m, int out_fd)
+{
+	static char buf[READ_BUFLEN];
+	uint64_t left = m->size;
+	off_t pos = m->offset;
+	size_t len;
+
+	while (left > 0) {
+		len = left < sizeof(buf) ? left : sizeof(buf);
+		if (read_full(tar_fd, buf, len, pos)) {
+			fprintf(stderr, "Short read from tar file\n");
+			return 1;
+		}
+
+		if (write_full(out_fd, buf, len)) {
+			fprintf(stderr, "Write failed: %s\n", strerror(errno));
+			return 1;
+		}
+
+		pos += len;
+		left -= len;
+	}
+
+	return 0;
+}
+
+static int
+cmd_cat(const char *name)
+{
+	struct tar_member m;
+
+	if (find_member(name, &m))
+		return 1;
+
+	return copy_member(&m, STDOUT_FILENO);
+}
+
+static int
+cmd_ubi(const char *name, const char *vol)
+{
+	struct tar_member m;
+	int64_t bytes;
+	int fd, ret;
+
+	if (find_member(name, &m))
+		return 1;
+
+	fd = open(vol, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", vol, strerror(errno));
+		return 1;
+	}
+
+	bytes = m.size;
+	if (ioctl(fd, UBI_IOCVOLUP, &bytes)) {
+		fprintf(stderr, "Cannot start update of %s: %s\n", vol,
+			strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	ret = copy_member(&m, fd);
+	if (close(fd) && !ret) {
+		fprintf(stderr, "Update of %s failed: %s\n", vol, strerror(errno));
+		ret = 1;
+	}
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *progname = argv[0];
+	const char *cmd;
+	int ret;
+
+	if (argc < 3)
+		return usage(progname);
+
+	cmd = argv[1];
+	tar_fd = open(argv[2], O_RDONLY);
+	if (tar_fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", argv[2], strerror(errno));
+		return 1;
+	}
+
+	if (!strcmp(cmd, "list") && argc <= 4)
+		ret = cmd_list(argc > 3 ? argv[3] : NULL);
+	else if (!strcmp(cmd, "cat") && argc == 4)
+		ret = cmd_cat(argv[3]);
+	else if (!strcmp(cmd, "ubi") && argc == 5)
+		ret = cmd_ubi(argv[3], argv[4]);
+	else
+		ret = usage(progname);
+
+	close(tar_fd);
+	return ret;
+}
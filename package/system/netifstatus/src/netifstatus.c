@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Turns the output of "ubus call network.interface dump" into shell
+ * assignments for all values queried by /lib/functions/network.sh, so
+ * that scripts need a single process instead of one jsonfilter call per
+ * value. netifd has no state generation counter, the rendered index is
+ * cached in /var/run keyed on a hash of the dump instead.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <libubox/blobmsg_json.h>
+
+#define CACHE_FILE	"/var/run/netifstatus.cache"
+#define CACHE_MAGIC	"netifstatus 1"
+#define VAR_PREFIX	"__NETWORK_"
+
+struct strbuf {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+enum {
+	IF_NAME,
+	IF_UP,
+	IF_PROTO,
+	IF_DEVICE,
+	IF_L3_DEVICE,
+	IF_IPV4_ADDR,
+	IF_IPV6_ADDR,
+	IF_IPV6_PREFIX,
+	IF_IPV6_ASSIGN,
+	IF_ROUTE,
+	IF_DNS_SERVER,
+	IF_DNS_SEARCH,
+	IF_INACTIVE,
+	__IF_MAX
+};
+
+static const struct blobmsg_policy if_policy[__IF_MAX] = {
+	[IF_NAME] = { "interface", BLOBMSG_TYPE_STRING },
+	[IF_UP] = { "up", BLOBMSG_TYPE_BOOL },
+	[IF_PROTO] = { "proto", BLOBMSG_TYPE_STRING },
+	[IF_DEVICE] = { "device", BLOBMSG_TYPE_STRING },
+	[IF_L3_DEVICE] = { "l3_device", BLOBMSG_TYPE_STRING },
+	[IF_IPV4_ADDR] = { "ipv4-address", BLOBMSG_TYPE_ARRAY },
+	[IF_IPV6_ADDR] = { "ipv6-address", BLOBMSG_TYPE_ARRAY },
+	[IF_IPV6_PREFIX] = { "ipv6-prefix", BLOBMSG_TYPE_ARRAY },
+	[IF_IPV6_ASSIGN] = { "ipv6-prefix-assignment", BLOBMSG_TYPE_ARRAY },
+	[IF_ROUTE] = { "route", BLOBMSG_TYPE_ARRAY },
+	[IF_DNS_SERVER] = { "dns-server", BLOBMSG_TYPE_ARRAY },
+	[IF_DNS_SEARCH] = { "dns-search", BLOBMSG_TYPE_ARRAY },
+	[IF_INACTIVE] = { "inactive", BLOBMSG_TYPE_TABLE },
+};
+
+enum {
+	ADDR_ADDRESS,
+	ADDR_MASK,
+	ADDR_LOCAL,
+	__ADDR_MAX
+};
+
+static const struct blobmsg_policy addr_policy[__ADDR_MAX] = {
+	[ADDR_ADDRESS] = { "address", BLOBMSG_TYPE_STRING },
+	[ADDR_MASK] = { "mask", BLOBMSG_TYPE_INT32 },
+	[ADDR_LOCAL] = { "local-address", BLOBMSG_TYPE_TABLE },
+};
+
+enum {
+	ROUTE_TARGET,
+	ROUTE_NEXTHOP,
+	ROUTE_TABLE,
+	__ROUTE_MAX
+};
+
+static const struct blobmsg_policy route_policy[__ROUTE_MAX] = {
+	[ROUTE_TARGET] = { "target", BLOBMSG_TYPE_STRING },
+	[ROUTE_NEXTHOP] = { "nexthop", BLOBMSG_TYPE_STRING },
+	[ROUTE_TABLE] = { "table", BLOBMSG_TYPE_UNSPEC },
+};
+
+static struct blob_buf b;
+static struct strbuf out, vars, val;
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<options>] [<variable>=<field>:<interface> ...]\n"
+		"\n"
+		"Options:\n"
+		"  -s <data>:		Interface dump to use instead of reading stdin\n"
+		"  -n:			Do not use or update the cache\n"
+		"\n"
+		"Without arguments all values are printed as " VAR_PREFIX "<field>_<interface>\n"
+		"\n", progname);
+	return 1;
+}
+
+static void
+sb_add(struct strbuf *sb, const char *str, size_t len)
+{
+	if (sb->len + len + 1 > sb->size) {
+		sb->size = (sb->len + len + 1) * 2;
+		sb->buf = realloc(sb->buf, sb->size);
+		if (!sb->buf) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	memcpy(sb->buf + sb->len, str, len);
+	sb->len += len;
+	sb->buf[sb->len] = 0;
+}
+
+static void
+sb_puts(struct strbuf *sb, const char *str)
+{
+	sb_add(sb, str, strlen(str));
+}
+
+/* append a list element, separated by a space */
+static void
+val_add(const char *str, int mask)
+{
+	char buf[16];
+
+	if (val.len)
+		sb_puts(&val, " ");
+
+	sb_puts(&val, str);
+	if (mask >= 0) {
+		snprintf(buf, sizeof(buf), "/%d", mask);
+		sb_puts(&val, buf);
+	}
+}
+
+static void
+sb_add_quoted(struct strbuf *sb, const char *str)
+{
+	sb_puts(sb, "'");
+	for (; *str; str++) {
+		if (*str == '\'')
+			sb_puts(sb, "'\\''");
+		else
+			sb_add(sb, str, 1);
+	}
+	sb_puts(sb, "'");
+}
+
+static void
+emit(const char *field, const char *iface, const char *value)
+{
+	size_t start = out.len;
+
+	sb_puts(&out, VAR_PREFIX);
+	sb_puts(&out, field);
+	sb_puts(&out, "_");
+	sb_puts(&out, iface);
+
+	if (vars.len)
+		sb_puts(&vars, " ");
+	sb_add(&vars, out.buf + start, out.len - start);
+
+	sb_puts(&out, "=");
+	sb_add_quoted(&out, value);
+	sb_puts(&out, "\n");
+}
+
+static void
+emit_val(const char *field, const char *iface)
+{
+	if (!val.len)
+		return;
+
+	emit(field, iface, val.buf);
+	val.len = 0;
+}
+
+static bool
+valid_name(const char *name)
+{
+	if (!*name)
+		return false;
+
+	for (; *name; name++) {
+		if ((*name < 'a' || *name > 'z') && (*name < 'A' || *name > 'Z') &&
+		    (*name < '0' || *name > '9') && *name != '_')
+			return false;
+	}
+
+	return true;
+}
+
+static void
+add_addrs(struct blob_attr *list, bool with_mask, int limit)
+{
+	struct blob_attr *tb[__ADDR_MAX];
+	struct blob_attr *cur;
+	int rem;
+
+	if (!list)
+		return;
+
+	blobmsg_for_each_attr(cur, list, rem) {
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
+			continue;
+
+		blobmsg_parse(addr_policy, __ADDR_MAX, tb, blobmsg_data(cur),
+			      blobmsg_data_len(cur));
+		if (!tb[ADDR_ADDRESS] || (with_mask && !tb[ADDR_MASK]))
+			continue;
+
+		val_add(blobmsg_get_string(tb[ADDR_ADDRESS]),
+			with_mask ? (int) blobmsg_get_u32(tb[ADDR_MASK]) : -1);
+		if (!--limit)
+			return;
+	}
+}
+
+/* local addresses of delegated prefixes, with the mask of the assignment */
+static void
+add_assigned(struct blob_attr *list, bool with_mask, int limit)
+{
+	struct blob_attr *tb[__ADDR_MAX], *local[__ADDR_MAX];
+	struct blob_attr *cur;
+	int rem;
+
+	if (!list)
+		return;
+
+	blobmsg_for_each_attr(cur, list, rem) {
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
+			continue;
+
+		blobmsg_parse(addr_policy, __ADDR_MAX, tb, blobmsg_data(cur),
+			      blobmsg_data_len(cur));
+		if (!tb[ADDR_LOCAL] || (with_mask && !tb[ADDR_MASK]))
+			continue;
+
+		blobmsg_parse(addr_policy, __ADDR_MAX, local,
+			      blobmsg_data(tb[ADDR_LOCAL]),
+			      blobmsg_data_len(tb[ADDR_LOCAL]));
+		if (!local[ADDR_ADDRESS])
+			continue;
+
+		val_add(blobmsg_get_string(local[ADDR_ADDRESS]),
+			with_mask ? (int) blobmsg_get_u32(tb[ADDR_MASK]) : -1);
+		if (!--limit)
+			return;
+	}
+}
+
+static void
+add_strings(struct blob_attr *list)
+{
+	struct blob_attr *cur;
+	int rem;
+
+	if (!list)
+		return;
+
+	blobmsg_for_each_attr(cur, list, rem) {
+		if (blobmsg_type(cur) == BLOBMSG_TYPE_STRING)
+			val_add(blobmsg_get_string(cur), -1);
+	}
+}
+
+/*
+ * first default route outside of a custom table, or its nexthop if
+ * only routes with a nexthop are of interest
+ */
+static struct blob_attr *
+find_default_route(struct blob_attr *list, const char *target, bool nexthop)
+{
+	struct blob_attr *tb[__ROUTE_MAX];
+	struct blob_attr *cur;
+	int rem;
+
+	if (!list)
+		return NULL;
+
+	blobmsg_for_each_attr(cur, list, rem) {
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
+			continue;
+
+		blobmsg_parse(route_policy, __ROUTE_MAX, tb, blobmsg_data(cur),
+			      blobmsg_data_len(cur));
+		if (!tb[ROUTE_TARGET] || tb[ROUTE_TABLE] ||
+		    strcmp(blobmsg_get_string(tb[ROUTE_TARGET]), target) != 0)
+			continue;
+
+		if (!nexthop)
+			return cur;
+
+		if (tb[ROUTE_NEXTHOP])
+			return tb[ROUTE_NEXTHOP];
+	}
+
+	return NULL;
+}
+
+static void
+emit_gateway(const char *field, const char *iface, struct blob_attr *routes,
+	     const char *target)
+{
+	struct blob_attr *nh = find_default_route(routes, target, true);
+
+	if (nh)
+		emit(field, iface, blobmsg_get_string(nh));
+}
+
+static void
+emit_lists(const char *prefix, const char *iface, struct blob_attr **tb)
+{
+	char field[32];
+
+	snprintf(field, sizeof(field), "%sgateway", prefix);
+	emit_gateway(field, iface, tb[IF_ROUTE], "0.0.0.0");
+
+	snprintf(field, sizeof(field), "%sgateway6", prefix);
+	emit_gateway(field, iface, tb[IF_ROUTE], "::");
+
+	snprintf(field, sizeof(field), "%sdnsserver", prefix);
+	add_strings(tb[IF_DNS_SERVER]);
+	emit_val(field, iface);
+
+	snprintf(field, sizeof(field), "%sdnssearch", prefix);
+	add_strings(tb[IF_DNS_SEARCH]);
+	emit_val(field, iface);
+}
+
+static void
+render_interface(struct blob_attr *data, const char **wan)
+{
+	struct blob_attr *tb[__IF_MAX], *inactive[__IF_MAX];
+	const char *iface;
+
+	blobmsg_parse(if_policy, __IF_MAX, tb, blobmsg_data(data),
+		      blobmsg_data_len(data));
+	if (!tb[IF_NAME])
+		return;
+
+	iface = blobmsg_get_string(tb[IF_NAME]);
+	if (!valid_name(iface))
+		return;
+
+	if (tb[IF_UP])
+		emit("up", iface, blobmsg_get_bool(tb[IF_UP]) ? "1" : "0");
+	if (tb[IF_PROTO])
+		emit("proto", iface, blobmsg_get_string(tb[IF_PROTO]));
+	if (tb[IF_L3_DEVICE])
+		emit("device", iface, blobmsg_get_string(tb[IF_L3_DEVICE]));
+	if (tb[IF_DEVICE])
+		emit("physdev", iface, blobmsg_get_string(tb[IF_DEVICE]));
+
+	add_addrs(tb[IF_IPV4_ADDR], false, 1);
+	emit_val("ipaddr", iface);
+	add_addrs(tb[IF_IPV4_ADDR], false, -1);
+	emit_val("ipaddrs", iface);
+	add_addrs(tb[IF_IPV4_ADDR], true, 1);
+	emit_val("subnet", iface);
+	add_addrs(tb[IF_IPV4_ADDR], true, -1);
+	emit_val("subnets", iface);
+
+	add_addrs(tb[IF_IPV6_ADDR], false, 1);
+	if (!val.len)
+		add_assigned(tb[IF_IPV6_ASSIGN], false, 1);
+	emit_val("ipaddr6", iface);
+	add_addrs(tb[IF_IPV6_ADDR], false, -1);
+	add_assigned(tb[IF_IPV6_ASSIGN], false, -1);
+	emit_val("ipaddrs6", iface);
+	add_addrs(tb[IF_IPV6_ADDR], true, -1);
+	add_assigned(tb[IF_IPV6_ASSIGN], true, -1);
+	emit_val("subnets6", iface);
+	add_addrs(tb[IF_IPV6_PREFIX], true, 1);
+	emit_val("prefix6", iface);
+	add_addrs(tb[IF_IPV6_PREFIX], true, -1);
+	emit_val("prefixes6", iface);
+
+	emit_lists("", iface, tb);
+
+	if (!wan[0] && find_default_route(tb[IF_ROUTE], "0.0.0.0", false))
+		wan[0] = iface;
+	if (!wan[1] && find_default_route(tb[IF_ROUTE], "::", false))
+		wan[1] = iface;
+
+	if (!tb[IF_INACTIVE])
+		return;
+
+	blobmsg_parse(if_policy, __IF_MAX, inactive,
+		      blobmsg_data(tb[IF_INACTIVE]),
+		      blobmsg_data_len(tb[IF_INACTIVE]));
+	emit_lists("inactive", iface, inactive);
+
+	if (!wan[2] && find_default_route(inactive[IF_ROUTE], "0.0.0.0", false))
+		wan[2] = iface;
+	if (!wan[3] && find_default_route(inactive[IF_ROUTE], "::", false))
+		wan[3] = iface;
+}
+
+static int
+render(const char *data)
+{
+	static const struct blobmsg_policy policy = {
+		"interface", BLOBMSG_TYPE_ARRAY
+	};
+	static const char * const wan_fields[] = {
+		"wan", "wan6", "inactivewan", "inactivewan6"
+	};
+	const char *wan[ARRAY_SIZE(wan_fields)] = {};
+	struct blob_attr *list, *cur;
+	int i, rem;
+
+	blob_buf_init(&b, 0);
+	if (!blobmsg_add_json_from_string(&b, data)) {
+		fprintf(stderr, "Failed to parse interface dump\n");
+		return -1;
+	}
+
+	blobmsg_parse(&policy, 1, &list, blob_data(b.head), blob_len(b.head));
+	if (list) {
+		blobmsg_for_each_attr(cur, list, rem) {
+			if (blobmsg_type(cur) == BLOBMSG_TYPE_TABLE)
+				render_interface(cur, wan);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(wan_fields); i++) {
+		if (wan[i])
+			emit(wan_fields[i], "", wan[i]);
+	}
+
+	sb_puts(&out, VAR_PREFIX "VARS=");
+	sb_add_quoted(&out, vars.len ? vars.buf : "");
+	sb_puts(&out, "\n");
+
+	return 0;
+}
+
+/* FNV-1a, only used to tell dumps apart */
+static uint64_t
+hash_data(const char *data)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (; *data; data++)
+		h = (h ^ (unsigned char) *data) * 0x100000001b3ULL;
+
+	return h;
+}
+
+static bool
+cache_load(uint64_t hash)
+{
+	char line[64], expect[64];
+	FILE *f;
+	long len;
+
+	f = fopen(CACHE_FILE, "r");
+	if (!f)
+		return false;
+
+	snprintf(expect, sizeof(expect), CACHE_MAGIC " %016llx\n",
+		 (unsigned long long) hash);
+	if (!fgets(line, sizeof(line), f) || strcmp(line, expect) != 0)
+		goto error;
+
+	if (fseek(f, 0, SEEK_END) || (len = ftell(f)) < 0 ||
+	    fseek(f, strlen(line), SEEK_SET))
+		goto error;
+
+	len -= strlen(line);
+	out.len = 0;
+	sb_add(&out, "", 0);
+	if (len) {
+		char *buf = malloc(len);
+
+		if (!buf || fread(buf, 1, len, f) != len) {
+			free(buf);
+			goto error;
+		}
+		sb_add(&out, buf, len);
+		free(buf);
+	}
+
+	fclose(f);
+	return true;
+
+error:
+	fclose(f);
+	return false;
+}
+
+static void
+cache_save(uint64_t hash)
+{
+	char tmp[sizeof(CACHE_FILE) + 16];
+	FILE *f;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", CACHE_FILE, (int) getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	fprintf(f, CACHE_MAGIC " %016llx\n", (unsigned long long) hash);
+	if (fwrite(out.buf, 1, out.len, f) != out.len || fclose(f) != 0 ||
+	    rename(tmp, CACHE_FILE) != 0)
+		unlink(tmp);
+}
+
+static char *
+read_stdin(void)
+{
+	struct strbuf sb = {};
+	char buf[4096];
+	size_t len;
+
+	sb_add(&sb, "", 0);
+	while ((len = fread(buf, 1, sizeof(buf), stdin)) > 0)
+		sb_add(&sb, buf, len);
+
+	return sb.buf;
+}
+
+/* <variable>=<field>:<interface>, looked up in the rendered index */
+static int
+query(const char *arg)
+{
+	const char *eq = strchr(arg, '='), *sep;
+	char key[128];
+	char *line, *end;
+	int len;
+
+	if (!eq || !(sep = strchr(eq, ':')) || eq == arg) {
+		fprintf(stderr, "Invalid query: %s\n", arg);
+		return -1;
+	}
+
+	len = snprintf(key, sizeof(key), "\n" VAR_PREFIX "%.*s_%s=",
+		       (int) (sep - eq - 1), eq + 1, sep + 1);
+	if (len >= sizeof(key))
+		return -1;
+
+	/* the index always starts with a newline, see main() */
+	line = strstr(out.buf, key);
+	if (!line) {
+		printf("unset %.*s;\n", (int) (eq - arg), arg);
+		return 1;
+	}
+
+	line += len;
+	end = strchr(line, '\n');
+	printf("export %.*s=%.*s;\n", (int) (eq - arg), arg, (int) (end - line),
+	       line);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *progname = argv[0];
+	const char *data = NULL;
+	bool use_cache = true;
+	uint64_t hash;
+	int i, ch, ret = 0;
+
+	while ((ch = getopt(argc, argv, "ns:")) != -1) {
+		switch (ch) {
+		case 'n':
+			use_cache = false;
+			break;
+		case 's':
+			data = optarg;
+			break;
+		default:
+			return usage(progname);
+		}
+	}
+
+	if (!data)
+		data = read_stdin();
+
+	hash = hash_data(data);
+	if (!use_cache || !cache_load(hash)) {
+		out.len = 0;
+		sb_puts(&out, "\n");
+		if (render(data))
+			return 1;
+
+		if (use_cache)
+			cache_save(hash);
+	}
+
+	if (optind >= argc) {
+		fputs(out.buf + 1, stdout);
+		return 0;
+	}
+
+	for (i = optind; i < argc; i++) {
+		if (query(argv[i]))
+			ret = 1;
+	}
+
+	return ret;
+}
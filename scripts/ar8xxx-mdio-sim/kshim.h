@@ -0,0 +1,514 @@
+/*
+ * kshim.h: the kernel API used by ar8216.c and ar8327.c, for a host build
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * Only as much as the register access paths need is functional: memory
+ * allocation, bit operations and a mutex that remembers whether it is held,
+ * so lockdep_assert_held() catches accesses outside of the bus lock. The
+ * netdev, phy and LED glue compiles but is never called. The kernel headers
+ * the drivers include are created empty by the Makefile.
+ */
+
+#ifndef __KSHIM_H
+#define __KSHIM_H
+
+#define __KERNEL__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u16 __be16;
+typedef u32 __be32;
+typedef unsigned int gfp_t;
+
+#define GFP_KERNEL		0
+#define GFP_ATOMIC		0
+
+#define KERNEL_VERSION(a, b, c)	(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE	KERNEL_VERSION(4, 14, 0)
+#define IS_ENABLED(x)		0
+
+#define __init
+#define __exit
+#define __iomem
+#define __maybe_unused		__attribute__((unused))
+#define likely(x)		(x)
+#define unlikely(x)		(x)
+
+#define BIT(n)			(1UL << (n))
+#define BITS_PER_LONG		(8 * sizeof(long))
+#define BITS_TO_LONGS(n)	(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define ETH_ALEN		6
+#define ETH_HLEN		14
+#define IFNAMSIZ		16
+#define PAGE_SIZE		4096
+
+#define container_of(ptr, type, member) \
+	((type *) ((char *) (ptr) - offsetof(type, member)))
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		((t) (a) < (t) (b) ? (t) (a) : (t) (b))
+#define max_t(t, a, b)		((t) (a) > (t) (b) ? (t) (a) : (t) (b))
+
+#define WARN_ON(x)		({ int __w = !!(x); if (__w) fprintf(stderr, "WARN_ON(%s) at %s:%d\n", #x, __FILE__, __LINE__); __w; })
+#define BUG_ON(x)		do { if (x) abort(); } while (0)
+
+#define pr_err(...)		fprintf(stderr, __VA_ARGS__)
+#define pr_warn(...)		fprintf(stderr, __VA_ARGS__)
+#define pr_info(...)		do { } while (0)
+#define pr_debug(...)		do { } while (0)
+#define dev_err(d, ...)		fprintf(stderr, __VA_ARGS__)
+#define dev_warn(d, ...)	fprintf(stderr, __VA_ARGS__)
+#define dev_info(d, ...)	do { } while (0)
+#define dev_dbg(d, ...)		do { } while (0)
+
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+#define MODULE_LICENSE(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_DEVICE_TABLE(t, x)
+#define module_phy_driver(x)
+#define module_init(x)
+#define module_exit(x)
+#define THIS_MODULE		NULL
+
+static inline void *kzalloc(size_t size, gfp_t gfp) { return calloc(1, size); }
+static inline void *kmalloc(size_t size, gfp_t gfp) { return malloc(size); }
+static inline void *kcalloc(size_t n, size_t size, gfp_t gfp) { return calloc(n, size); }
+static inline void kfree(const void *p) { free((void *) p); }
+
+#define scnprintf		snprintf
+
+static inline int kstrtou8(const char *s, unsigned int base, u8 *res)
+{
+	char *end;
+	unsigned long val = strtoul(s, &end, base);
+
+	if (end == s || val > 0xff)
+		return -EINVAL;
+
+	*res = val;
+	return 0;
+}
+
+static inline void udelay(unsigned long us) { }
+static inline void mdelay(unsigned long ms) { }
+static inline void msleep(unsigned int ms) { }
+static inline void usleep_range(unsigned long min, unsigned long max) { }
+
+extern unsigned long jiffies;
+#define HZ			100
+#define msecs_to_jiffies(ms)	((ms) / 10)
+#define time_after(a, b)	((long) ((b) - (a)) < 0)
+
+static inline int test_bit(int nr, const unsigned long *addr)
+{
+	return (addr[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+static inline void set_bit(int nr, unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void clear_bit(int nr, unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits)
+{
+	memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+/*
+ * locking: single threaded, but a mutex knows whether it is held and can
+ * call back when it is released
+ */
+struct mutex {
+	int held;
+	void (*unlock_hook)(struct mutex *m);
+};
+
+typedef struct {
+	int held;
+} spinlock_t;
+
+#define DEFINE_MUTEX(m)		struct mutex m = { 0, NULL }
+#define DEFINE_SPINLOCK(s)	spinlock_t s = { 0 }
+
+static inline void mutex_init(struct mutex *m) { m->held = 0; m->unlock_hook = NULL; }
+
+static inline void mutex_lock(struct mutex *m)
+{
+	/* a second lock would deadlock in the kernel */
+	if (m->held) {
+		fprintf(stderr, "mutex_lock: recursive locking\n");
+		abort();
+	}
+	m->held = 1;
+}
+
+static inline void mutex_unlock(struct mutex *m)
+{
+	if (!m->held) {
+		fprintf(stderr, "mutex_unlock: not locked\n");
+		abort();
+	}
+	m->held = 0;
+	if (m->unlock_hook)
+		m->unlock_hook(m);
+}
+
+#define lockdep_assert_held(m) do {					\
+		if (!(m)->held) {					\
+			fprintf(stderr, "%s: lock not held\n", __func__);	\
+			abort();					\
+		}							\
+	} while (0)
+
+static inline void spin_lock_init(spinlock_t *s) { s->held = 0; }
+static inline void spin_lock(spinlock_t *s) { s->held = 1; }
+static inline void spin_unlock(spinlock_t *s) { s->held = 0; }
+#define spin_lock_bh		spin_lock
+#define spin_unlock_bh		spin_unlock
+
+/* lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(name)		struct list_head name = { &(name), &(name) }
+
+static inline void INIT_LIST_HEAD(struct list_head *l)
+{
+	l->next = l->prev = l;
+}
+
+static inline void list_add(struct list_head *n, struct list_head *head)
+{
+	n->next = head->next;
+	n->prev = head;
+	head->next->prev = n;
+	head->next = n;
+}
+
+static inline void list_del(struct list_head *e)
+{
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = list_entry((head)->next, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = list_entry(pos->member.next, typeof(*pos), member))
+
+/* work */
+struct work_struct {
+	void (*func)(struct work_struct *);
+};
+
+struct delayed_work {
+	struct work_struct work;
+};
+
+#define INIT_WORK(w, f)			((w)->func = (f))
+#define INIT_DELAYED_WORK(w, f)		((w)->work.func = (f))
+#define to_delayed_work(w)		container_of(w, struct delayed_work, work)
+static inline bool schedule_work(struct work_struct *w) { return true; }
+static inline bool schedule_delayed_work(struct delayed_work *w, unsigned long d) { return true; }
+static inline bool cancel_work_sync(struct work_struct *w) { return false; }
+static inline bool cancel_delayed_work_sync(struct delayed_work *w) { return false; }
+
+/* devices */
+struct device_node;
+
+struct device {
+	struct device_node *of_node;
+	void *platform_data;
+	void *driver_data;
+};
+
+static inline const char *dev_name(const struct device *dev) { return "sim"; }
+static inline void *dev_get_drvdata(const struct device *dev) { return dev->driver_data; }
+static inline const void *of_get_property(const struct device_node *np,
+					  const char *name, int *len)
+{
+	return NULL;
+}
+
+static inline int of_property_read_u32(const struct device_node *np,
+				       const char *name, u32 *val)
+{
+	return -EINVAL;
+}
+
+struct device_attribute {
+	const char *name;
+};
+
+#define DEVICE_ATTR(_name, _mode, _show, _store) \
+	struct device_attribute dev_attr_##_name = { #_name }
+
+static inline int device_create_file(struct device *dev,
+				     const struct device_attribute *a)
+{
+	return 0;
+}
+
+static inline void device_remove_file(struct device *dev,
+				      const struct device_attribute *a)
+{
+}
+
+/* network devices */
+struct net_device;
+
+struct sk_buff {
+	unsigned char *data;
+	unsigned int len;
+};
+
+struct net_device_ops {
+	int (*ndo_open)(struct net_device *);
+};
+
+struct net_device {
+	char name[IFNAMSIZ];
+	unsigned int priv_flags;
+	const struct net_device_ops *netdev_ops;
+	struct phy_device *phydev;
+	void *phy_ptr;
+	void (*eth_mangle_rx)(struct net_device *dev, struct sk_buff *skb);
+	struct sk_buff *(*eth_mangle_tx)(struct net_device *dev, struct sk_buff *skb);
+	unsigned int extra_priv_flags;
+};
+
+#define IFF_NO_IP_ALIGN		(1 << 0)
+#define NETDEV_TX_OK		0
+
+static inline unsigned char *skb_push(struct sk_buff *skb, unsigned int len)
+{
+	skb->data -= len;
+	skb->len += len;
+	return skb->data;
+}
+
+static inline unsigned char *skb_pull(struct sk_buff *skb, unsigned int len)
+{
+	skb->data += len;
+	skb->len -= len;
+	return skb->data;
+}
+
+static inline unsigned int skb_headroom(const struct sk_buff *skb) { return 0; }
+static inline int skb_cow_head(struct sk_buff *skb, unsigned int headroom) { return 0; }
+static inline void dev_kfree_skb_any(struct sk_buff *skb) { }
+static inline int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
+				   gfp_t gfp)
+{
+	return -ENOMEM;
+}
+
+static inline void netif_carrier_on(struct net_device *dev) { }
+static inline void netif_carrier_off(struct net_device *dev) { }
+
+/* generic netlink, only for the types used by linux/switch.h */
+struct nlattr;
+struct genl_info;
+struct genl_family;
+struct sk_buff;
+struct nla_policy {
+	u16 type;
+};
+
+/* MDIO and PHYs */
+#define PHY_MAX_ADDR		32
+
+struct mii_bus {
+	const char *name;
+	void *priv;
+	int (*read)(struct mii_bus *bus, int addr, int regnum);
+	int (*write)(struct mii_bus *bus, int addr, int regnum, u16 val);
+	struct mutex mdio_lock;
+	struct device dev;
+};
+
+struct phy_driver;
+
+struct mdio_device {
+	struct device dev;
+	struct mii_bus *bus;
+	int addr;
+};
+
+struct phy_device {
+	struct mdio_device mdio;
+	struct phy_driver *drv;
+	u32 phy_id;
+	int speed;
+	int duplex;
+	int pause;
+	int asym_pause;
+	int link;
+	int autoneg;
+	u32 supported;
+	u32 advertising;
+	int state;
+	int interface;
+	void *priv;
+	struct net_device *attached_dev;
+	void (*adjust_link)(struct net_device *dev);
+};
+
+struct phy_driver {
+	u32 phy_id;
+	const char *name;
+	u32 phy_id_mask;
+	u32 features;
+	int (*probe)(struct phy_device *);
+	void (*remove)(struct phy_device *);
+	int (*config_init)(struct phy_device *);
+	int (*config_aneg)(struct phy_device *);
+	int (*aneg_done)(struct phy_device *);
+	int (*read_status)(struct phy_device *);
+	int (*soft_reset)(struct phy_device *);
+	int (*update_link)(struct phy_device *);
+	void (*detach)(struct phy_device *);
+};
+
+#define PHY_GBIT_FEATURES	0
+#define PHY_BASIC_FEATURES	0
+#define PHY_HAS_INTERRUPT	0
+#define PHY_POLL		-1
+#define PHY_RUNNING		3
+#define PHY_NOLINK		4
+#define PHY_CHANGELINK		5
+#define PHY_INTERFACE_MODE_GMII		1
+#define PHY_INTERFACE_MODE_RGMII	2
+#define DUPLEX_HALF		0
+#define DUPLEX_FULL		1
+#define SPEED_10		10
+#define SPEED_100		100
+#define SPEED_1000		1000
+#define AUTONEG_DISABLE		0
+#define AUTONEG_ENABLE		1
+#define SUPPORTED_100baseT_Full		BIT(3)
+#define SUPPORTED_1000baseT_Full	BIT(5)
+#define ADVERTISED_100baseT_Full	BIT(3)
+#define ADVERTISED_1000baseT_Full	BIT(5)
+#define SUPPORTED_Pause		BIT(13)
+#define SUPPORTED_Asym_Pause	BIT(14)
+
+#define MII_BMCR		0x00
+#define MII_BMSR		0x01
+#define MII_PHYSID1		0x02
+#define MII_PHYSID2		0x03
+#define MII_ADVERTISE		0x04
+#define MII_LPA			0x05
+#define MII_CTRL1000		0x09
+#define BMCR_ANRESTART		0x0200
+#define BMCR_ANENABLE		0x1000
+#define BMCR_RESET		0x8000
+#define BMCR_PDOWN		0x0800
+#define ADVERTISE_ALL		0x01e0
+#define ADVERTISE_PAUSE_CAP	0x0400
+#define ADVERTISE_PAUSE_ASYM	0x0800
+#define ADVERTISE_1000FULL	0x0200
+#define MDIO_MMD_PCS		3
+#define MDIO_MMD_AN		7
+#define MDIO_PCS_EEE_ABLE	20
+#define MDIO_AN_EEE_ADV		60
+#define MDIO_EEE_100TX		0x0002
+#define MDIO_EEE_1000T		0x0004
+
+static inline int mdiobus_read(struct mii_bus *bus, int addr, u32 regnum)
+{
+	int ret;
+
+	mutex_lock(&bus->mdio_lock);
+	ret = bus->read(bus, addr, regnum);
+	mutex_unlock(&bus->mdio_lock);
+
+	return ret;
+}
+
+static inline int mdiobus_write(struct mii_bus *bus, int addr, u32 regnum, u16 val)
+{
+	int ret;
+
+	mutex_lock(&bus->mdio_lock);
+	ret = bus->write(bus, addr, regnum, val);
+	mutex_unlock(&bus->mdio_lock);
+
+	return ret;
+}
+
+static inline int phy_read(struct phy_device *phydev, u32 regnum)
+{
+	return mdiobus_read(phydev->mdio.bus, phydev->mdio.addr, regnum);
+}
+
+static inline int phy_write(struct phy_device *phydev, u32 regnum, u16 val)
+{
+	return mdiobus_write(phydev->mdio.bus, phydev->mdio.addr, regnum, val);
+}
+
+static inline u32 mmd_eee_adv_to_ethtool_adv_t(u16 eee_adv) { return 0; }
+
+static inline int genphy_config_aneg(struct phy_device *phydev) { return 0; }
+static inline int genphy_read_status(struct phy_device *phydev) { return 0; }
+static inline int genphy_update_link(struct phy_device *phydev) { return 0; }
+static inline int genphy_aneg_done(struct phy_device *phydev) { return 1; }
+static inline int genphy_soft_reset(struct phy_device *phydev) { return 0; }
+static inline int phy_init_hw(struct phy_device *phydev) { return 0; }
+
+/* LEDs */
+enum led_brightness {
+	LED_OFF = 0,
+	LED_FULL = 255,
+};
+
+struct led_classdev {
+	const char *name;
+	enum led_brightness brightness;
+	void (*brightness_set)(struct led_classdev *, enum led_brightness);
+	int (*blink_set)(struct led_classdev *, unsigned long *, unsigned long *);
+	const char *default_trigger;
+	struct device *dev;
+	int flags;
+};
+
+static inline int led_classdev_register(struct device *parent, struct led_classdev *cdev)
+{
+	return 0;
+}
+
+static inline void led_classdev_unregister(struct led_classdev *cdev) { }
+
+#endif
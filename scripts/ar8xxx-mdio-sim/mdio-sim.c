@@ -0,0 +1,354 @@
+/*
+ * mdio-sim.c: count the MDIO transactions of the ar8xxx switch driver
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * Builds ar8216.c and ar8327.c for the host and attaches them to a simulated
+ * mii_bus that keeps the switch registers in memory and completes ATU, VTU
+ * and MIB operations at once. Each chip is probed, started, given a VLAN
+ * setup, applied twice and has its ARL table read, and the bus reads, writes
+ * and page register writes of each step are counted. The legacy column runs
+ * the same steps without the register cache and forgets the selected page
+ * whenever mdio_lock is released, so each register access selects it again
+ * as the driver did before both were added.
+ *
+ * The bus counts are also compared against the driver's own mdio_stats
+ * counters, and the shim mutex aborts on an access outside of mdio_lock or
+ * on taking it twice.
+ */
+
+#include "kshim.h"
+
+#include "ar8216.c"
+#include "ar8327.c"
+
+#define SIM_REGS	(1 << 16)
+
+unsigned long jiffies;
+
+/* the swconfig core, only reached from the netdev and phy glue */
+int register_switch(struct switch_dev *dev, struct net_device *netdev)
+{
+	return 0;
+}
+
+void unregister_switch(struct switch_dev *dev)
+{
+}
+
+int switch_get_port_link(struct switch_dev *dev, int port,
+			 struct switch_port_link *link, unsigned long max_age)
+{
+	return dev->ops->get_port_link(dev, port, link);
+}
+
+void switch_port_link_changed(struct switch_dev *dev, int port)
+{
+}
+
+unsigned long swconfig_snapshot_interval(void)
+{
+	return 1;
+}
+
+struct sim {
+	struct mii_bus bus;
+	struct phy_device phy;
+	struct ar8xxx_priv *priv;
+	bool legacy;
+
+	u32 regs[SIM_REGS];
+	u16 phy_regs[PHY_MAX_ADDR][32];
+	u16 page;
+
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long page_writes;
+	unsigned long phy_accesses;
+};
+
+struct sim_count {
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long page_writes;
+};
+
+static struct ar8327_pad_cfg sim_pad_cfg;
+static struct ar8327_platform_data sim_pdata = {
+	.pad0_cfg = &sim_pad_cfg,
+	.pad5_cfg = &sim_pad_cfg,
+	.pad6_cfg = &sim_pad_cfg,
+};
+
+/* register index of a 32 bit register, as split_addr() took it apart */
+static unsigned int
+sim_reg(struct sim *sim, int addr, int regnum)
+{
+	return ((sim->page << 9) | ((addr & 0x7) << 6) | ((regnum & 0x1e) << 1)) / 4;
+}
+
+/* the operation started by setting a busy bit completes at once */
+static u32
+sim_busy_mask(unsigned int reg)
+{
+	switch (reg * 4) {
+	case AR8216_REG_VTU:
+		return AR8216_VTU_ACTIVE;
+	case AR8216_REG_ATU_FUNC0:
+		return AR8216_ATU_ACTIVE;
+	case AR8216_REG_MIB_FUNC:
+		return AR8216_MIB_BUSY;
+	case AR8327_REG_ATU_FUNC:
+		return AR8327_ATU_FUNC_BUSY;
+	case AR8327_REG_VTU_FUNC1:
+		return AR8327_VTU_FUNC1_BUSY;
+	}
+
+	return 0;
+}
+
+/* the driver used to select the page in each bus lock section */
+static void
+sim_legacy_unlock(struct mutex *m)
+{
+	struct sim *sim = container_of(m, struct sim, bus.mdio_lock);
+
+	if (sim->priv)
+		sim->priv->mii_page = AR8XXX_PAGE_INVALID;
+}
+
+static int
+sim_read(struct mii_bus *bus, int addr, int regnum)
+{
+	struct sim *sim = bus->priv;
+	unsigned int reg;
+
+	lockdep_assert_held(&bus->mdio_lock);
+
+	if (!(addr & 0x10)) {
+		sim->phy_accesses++;
+		/* PHY resets complete at once */
+		return sim->phy_regs[addr][regnum] & ~BMCR_RESET;
+	}
+
+	sim->reads++;
+	reg = sim_reg(sim, addr, regnum);
+
+	return regnum & 1 ? sim->regs[reg] >> 16 : sim->regs[reg] & 0xffff;
+}
+
+static int
+sim_write(struct mii_bus *bus, int addr, int regnum, u16 val)
+{
+	struct sim *sim = bus->priv;
+	unsigned int reg;
+
+	lockdep_assert_held(&bus->mdio_lock);
+
+	if (addr == 0x18 && regnum == 0) {
+		sim->page_writes++;
+		sim->page = val & 0x1ff;
+		return 0;
+	}
+
+	if (!(addr & 0x10)) {
+		sim->phy_accesses++;
+		sim->phy_regs[addr][regnum] = val;
+		return 0;
+	}
+
+	sim->writes++;
+	reg = sim_reg(sim, addr, regnum);
+	if (regnum & 1)
+		sim->regs[reg] = (sim->regs[reg] & 0xffff) | ((u32) val << 16);
+	else
+		sim->regs[reg] = (sim->regs[reg] & 0xffff0000) | val;
+	sim->regs[reg] &= ~sim_busy_mask(reg);
+
+	return 0;
+}
+
+static void
+sim_snapshot(struct sim *sim, struct sim_count *c)
+{
+	c->reads = sim->reads;
+	c->writes = sim->writes;
+	c->page_writes = sim->page_writes;
+}
+
+static void
+sim_diff(struct sim *sim, const struct sim_count *start, struct sim_count *c)
+{
+	c->reads = sim->reads - start->reads;
+	c->writes = sim->writes - start->writes;
+	c->page_writes = sim->page_writes - start->page_writes;
+}
+
+enum {
+	STEP_START,
+	STEP_APPLY,
+	STEP_REAPPLY,
+	STEP_ARL,
+	__STEP_MAX
+};
+
+static const char *step_names[__STEP_MAX] = {
+	[STEP_START] = "probe and start",
+	[STEP_APPLY] = "apply VLANs",
+	[STEP_REAPPLY] = "apply again",
+	[STEP_ARL] = "read ARL table",
+};
+
+static void
+sim_set_vlan(struct switch_dev *dev, int vlan, const int *ports, int n,
+	     int tagged)
+{
+	struct switch_port p[AR8X16_MAX_PORTS];
+	struct switch_val val = {
+		.port_vlan = vlan,
+		.len = n,
+		.value.ports = p,
+	};
+	int i;
+
+	for (i = 0; i < n; i++) {
+		p[i].id = ports[i];
+		p[i].flags = ports[i] == tagged ? 1 << SWITCH_PORT_FLAG_TAGGED : 0;
+	}
+
+	dev->ops->set_vlan_ports(dev, &val);
+	dev->ops->get_vlan_ports(dev, &val);
+}
+
+static int
+sim_run(u8 ver, bool legacy, struct sim_count *count)
+{
+	static const int lan[] = { 0, 1, 2, 3, 4 };
+	static const int wan[] = { 0, 5 };
+	struct switch_val on = { .value.i = 1 };
+	struct switch_val arl = {};
+	struct ar8xxx_chip chip;
+	struct ar8xxx_priv *priv;
+	struct sim_count start;
+	struct sim *sim;
+	int ret = -1;
+
+	sim = calloc(1, sizeof(*sim));
+	priv = ar8xxx_create();
+	if (!sim || !priv)
+		goto out;
+
+	sim->legacy = legacy;
+	sim->bus.priv = sim;
+	sim->bus.read = sim_read;
+	sim->bus.write = sim_write;
+	mutex_init(&sim->bus.mdio_lock);
+	if (legacy)
+		sim->bus.mdio_lock.unlock_hook = sim_legacy_unlock;
+	sim->phy.mdio.bus = &sim->bus;
+	sim->phy.mdio.dev.platform_data = &sim_pdata;
+	sim->phy.interface = PHY_INTERFACE_MODE_RGMII;
+	sim->regs[AR8216_REG_CTRL / 4] = ver << AR8216_CTRL_VERSION_S;
+
+	priv->mii_bus = &sim->bus;
+	priv->phy = &sim->phy;
+
+	sim_snapshot(sim, &start);
+	if (ar8xxx_probe_switch(priv))
+		goto out;
+
+	if (legacy) {
+		/* no register cache either */
+		chip = *priv->chip;
+		chip.reg_cacheable = NULL;
+		priv->chip = &chip;
+		switch_regcache_free(&priv->regcache);
+	}
+
+	sim->priv = priv;
+	if (ar8xxx_start(priv))
+		goto out;
+	sim_diff(sim, &start, &count[STEP_START]);
+
+	sim_snapshot(sim, &start);
+	ar8xxx_sw_set_vlan(&priv->dev, NULL, &on);
+	sim_set_vlan(&priv->dev, 1, lan, ARRAY_SIZE(lan), 0);
+	sim_set_vlan(&priv->dev, 2, wan, ARRAY_SIZE(wan), 0);
+	priv->dev.ops->apply_config(&priv->dev);
+	sim_diff(sim, &start, &count[STEP_APPLY]);
+
+	sim_snapshot(sim, &start);
+	priv->dev.ops->apply_config(&priv->dev);
+	sim_diff(sim, &start, &count[STEP_REAPPLY]);
+
+	sim_snapshot(sim, &start);
+	ar8xxx_sw_get_arl_table(&priv->dev, NULL, &arl);
+	sim_diff(sim, &start, &count[STEP_ARL]);
+
+	if (sim->reads != priv->mdio_reads ||
+	    sim->writes != priv->mdio_writes ||
+	    sim->page_writes != priv->mdio_page_writes) {
+		fprintf(stderr, "mdio_stats disagree with the bus: "
+			"reads %lu/%lu writes %lu/%lu page writes %lu/%lu\n",
+			priv->mdio_reads, sim->reads,
+			priv->mdio_writes, sim->writes,
+			priv->mdio_page_writes, sim->page_writes);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	if (priv) {
+		if (legacy)
+			priv->chip = NULL;
+		ar8xxx_free(priv);
+	}
+	free(sim);
+	return ret;
+}
+
+static const struct {
+	const char *name;
+	u8 ver;
+} chips[] = {
+	{ "ar8216", AR8XXX_VER_AR8216 },
+	{ "ar8236", AR8XXX_VER_AR8236 },
+	{ "ar8316", AR8XXX_VER_AR8316 },
+	{ "ar8327", AR8XXX_VER_AR8327 },
+	{ "ar8337", AR8XXX_VER_AR8337 },
+};
+
+int main(int argc, char **argv)
+{
+	struct sim_count legacy[__STEP_MAX], cur[__STEP_MAX];
+	int i, j, ret = 0;
+
+	printf("%-8s %-16s %22s %22s\n", "", "",
+	       "legacy r/w/page", "current r/w/page");
+
+	for (i = 0; i < ARRAY_SIZE(chips); i++) {
+		if (argc > 1 && strcmp(argv[1], chips[i].name) != 0)
+			continue;
+
+		if (sim_run(chips[i].ver, true, legacy) ||
+		    sim_run(chips[i].ver, false, cur)) {
+			fprintf(stderr, "%s: simulation failed\n", chips[i].name);
+			ret = 1;
+			continue;
+		}
+
+		for (j = 0; j < __STEP_MAX; j++)
+			printf("%-8s %-16s %8lu/%5lu/%7lu %8lu/%5lu/%7lu\n",
+			       j ? "" : chips[i].name, step_names[j],
+			       legacy[j].reads, legacy[j].writes,
+			       legacy[j].page_writes,
+			       cur[j].reads, cur[j].writes, cur[j].page_writes);
+	}
+
+	return ret;
+}
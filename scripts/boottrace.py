@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""
+# OpenWrt boot trace analyzer.
+# Reads the /tmp/boottrace.log written by a device booted with "boottrace"
+# on the kernel command line (or /etc/boottrace present) and prints the
+# critical path through preinit, init.d and uci-defaults.
+#
+# Copyright (C) 2018 OpenWrt.org
+"""
+
+from __future__ import print_function
+
+import sys
+import json
+import getopt
+
+
+class Span(object):
+	def __init__(self, name, pid, start, parent):
+		self.name = name
+		self.pid = pid
+		self.start = start
+		self.end = None
+		self.parent = parent
+		self.depth = parent.depth + 1 if parent else 0
+		self.children = 0.0
+		self.closed = True
+
+	def duration(self):
+		return self.end - self.start
+
+	def self_time(self):
+		return self.duration() - self.children
+
+
+def parseTrace(lines):
+	spans = []
+	instants = []
+	stacks = {}
+	last = 0.0
+
+	for lineno, line in enumerate(lines, 1):
+		fields = line.split(None, 3)
+		if len(fields) < 4 or fields[2] not in ("B", "E", "I"):
+			print("Skipping malformed line %d: %s" % (lineno, line.strip()),
+			      file=sys.stderr)
+			continue
+		ts, pid, phase, name = float(fields[0]), int(fields[1]), fields[2], fields[3].strip()
+		last = max(last, ts)
+		stack = stacks.setdefault(pid, [])
+
+		if phase == "B":
+			span = Span(name, pid, ts, stack[-1] if stack else None)
+			stack.append(span)
+			spans.append(span)
+		elif phase == "E":
+			# spans left open by an exit or a missing end are closed here
+			while stack:
+				span = stack.pop()
+				span.end = ts
+				if span.name == name:
+					break
+				span.closed = False
+		else:
+			instants.append((ts, pid, name))
+
+	for stack in stacks.values():
+		for span in stack:
+			span.end = last
+			span.closed = False
+
+	# account nested time to the enclosing span
+	for span in spans:
+		if span.parent:
+			span.parent.children += span.duration()
+
+	return spans, instants, last
+
+
+def criticalPath(spans):
+	# walk backwards from the span that ends last, always to the top level
+	# span that ended latest before the current one started
+	top = [ s for s in spans if s.depth == 0 ]
+	if not top:
+		return []
+
+	cur = max(top, key=lambda s: s.end)
+	path = [ cur ]
+	while True:
+		preds = [ s for s in top if s.end <= cur.start and s is not cur ]
+		if not preds:
+			break
+		cur = max(preds, key=lambda s: (s.end, s.start))
+		path.append(cur)
+	path.reverse()
+
+	return path
+
+
+def fmt(sec):
+	return "%8.2fs" % sec
+
+
+def networkReady(instants, iface):
+	for ts, pid, name in sorted(instants):
+		if not name.startswith("network:ifup "):
+			continue
+		if iface is None or name.split()[1] == iface:
+			return ts, name.split()[1]
+
+	return None, iface
+
+
+def printReport(spans, instants, last, count, iface):
+	first = min([ s.start for s in spans ] + [ i[0] for i in instants ] + [ last ])
+
+	print("Kernel and early userspace until the first event: %s" % fmt(first))
+	print("Traced boot: %s - %s (%s)" % (fmt(first).strip(), fmt(last).strip(),
+	      fmt(last - first).strip()))
+	ts, name = networkReady(instants, iface)
+	if ts is None:
+		print("Network ready: no ifup%s while tracing" % (" of " + iface if iface else ""))
+	else:
+		print("Network ready (ifup %s): %s" % (name, fmt(ts).strip()))
+	print()
+
+	path = criticalPath(spans)
+	print("Critical path:")
+	prev = None
+	for span in path:
+		if prev is not None and span.start - prev.end >= 0.01:
+			print("  %s  %s  (untraced)" % (fmt(prev.end), fmt(span.start - prev.end)))
+		print("  %s  %s  %s%s" % (fmt(span.start), fmt(span.duration()),
+		      span.name, "" if span.closed else " (unterminated)"))
+		prev = span
+	print()
+
+	print("Longest spans by self time:")
+	for span in sorted(spans, key=lambda s: -s.self_time())[:count]:
+		print("  %s  %s  %s%s" % (fmt(span.self_time()), fmt(span.duration()),
+		      "  " * span.depth + span.name, "" if span.closed else " (unterminated)"))
+
+
+def chromeTrace(spans, instants):
+	events = []
+
+	for span in spans:
+		events.append({
+			"name": span.name,
+			"cat": span.name.split(":", 1)[0],
+			"ph": "X",
+			"ts": int(span.start * 1000000),
+			"dur": int(span.duration() * 1000000),
+			"pid": 1,
+			"tid": span.pid,
+		})
+	for ts, pid, name in instants:
+		events.append({
+			"name": name,
+			"cat": name.split(":", 1)[0],
+			"ph": "i",
+			"s": "t",
+			"ts": int(ts * 1000000),
+			"pid": 1,
+			"tid": pid,
+		})
+
+	return { "traceEvents": events, "displayTimeUnit": "ms" }
+
+
+def usage():
+	print("OpenWrt boot trace analyzer")
+	print("")
+	print("Usage: " + sys.argv[0] + " [OPTIONS] <boottrace.log>")
+	print("")
+	print(" -c|--chrome FILE     Write a Chrome trace (chrome://tracing) to FILE")
+	print(" -i|--iface NAME      Interface that marks network ready (default: first)")
+	print(" -n|--count N         Number of longest spans to list (default 15)")
+	print(" -h|--help            Print this help text")
+	print("")
+	print("Tracing is enabled by \"boottrace\" on the kernel command line, e.g.")
+	print("  scripts/qemustart malta be -append boottrace")
+	print("or for images booting through a bootloader (x86) by adding an empty")
+	print("files/etc/boottrace to the build. Copy /tmp/boottrace.log off the")
+	print("device once the boot finished.")
+
+
+def main(argv):
+	chrome = None
+	count = 15
+	iface = None
+
+	try:
+		(opts, args) = getopt.getopt(argv[1:],
+			"hc:i:n:",
+			[ "help", "chrome=", "iface=", "count=", ])
+	except getopt.GetoptError as e:
+		usage()
+		return 1
+	for (o, v) in opts:
+		if o in ("-h", "--help"):
+			usage()
+			return 0
+		if o in ("-c", "--chrome"):
+			chrome = v
+		if o in ("-i", "--iface"):
+			iface = v
+		if o in ("-n", "--count"):
+			count = int(v)
+	if len(args) != 1:
+		usage()
+		return 1
+
+	with open(args[0]) as f:
+		spans, instants, last = parseTrace(f)
+
+	if not spans and not instants:
+		print("No events in %s" % args[0], file=sys.stderr)
+		return 1
+
+	printReport(spans, instants, last, count, iface)
+
+	if chrome:
+		with open(chrome, "w") as f:
+			json.dump(chromeTrace(spans, instants), f)
+
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
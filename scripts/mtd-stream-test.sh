@@ -0,0 +1,162 @@
+#!/bin/sh
+#
+# Copyright (C) 2018 OpenWrt.org
+#
+# This is free software, licensed under the GNU General Public License v2.
+# See /LICENSE for more information.
+#
+# Streams fwtool tagged images over HTTP into "mtd -t" the way a streamed
+# sysupgrade does, and checks that the first erase block of the device only
+# holds the image after it passed its checksums and the -T check. Needs root,
+# mtd, fwtool, wget and one of uhttpd, busybox httpd or python3.
+#
+# usage: mtd-stream-test.sh [mtdram|nandsim|<mtd partition name>]
+#
+# mtdram and nandsim are loaded for the test and removed afterwards, with a
+# partition name an existing device is used. Its contents are overwritten.
+
+MODE="${1:-mtdram}"
+PORT="${PORT:-8091}"
+WORK="$(mktemp -d /tmp/mtd-stream.XXXXXX)" || exit 1
+MODULE=
+SERVER=
+FAILED=0
+
+cleanup() {
+	[ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+	[ -n "$MODULE" ] && rmmod "$MODULE"
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+case "$MODE" in
+	mtdram)
+		MODULE=mtdram
+		NAME="mtdram test device"
+		modprobe mtdram total_size=4096 erase_size=128 || exit 1
+		;;
+	nandsim)
+		# 256 MiB, 2 KiB pages, 128 KiB erase blocks
+		MODULE=nandsim
+		NAME="NAND simulator partition 0"
+		modprobe nandsim first_id_byte=0x20 second_id_byte=0xaa \
+			third_id_byte=0x00 fourth_id_byte=0x15 || exit 1
+		;;
+	*)
+		NAME="$MODE"
+		;;
+esac
+
+while read -r dev size erasesize name; do
+	[ "$name" = "\"$NAME\"" ] || continue
+	DEV="/dev/${dev%:}"
+	SIZE=$((0x$size))
+	ERASESIZE=$((0x$erasesize))
+done < /proc/mtd
+
+[ -n "$DEV" ] || {
+	echo "No mtd device named '$NAME'" >&2
+	exit 1
+}
+
+# three and a half erase blocks, larger than the 64 KiB window held back by
+# the verifying helper
+LEN=$((ERASESIZE * 7 / 2))
+[ "$LEN" -lt "$SIZE" ] || {
+	echo "$NAME is too small for the test image" >&2
+	exit 1
+}
+
+dd if=/dev/urandom of="$WORK/data.bin" bs="$LEN" count=1 2>/dev/null
+cp "$WORK/data.bin" "$WORK/good.bin"
+echo '{ "supported_devices": [ "mtd-stream-test" ] }' > "$WORK/meta.json"
+fwtool -I "$WORK/meta.json" "$WORK/good.bin" || exit 1
+LEN=$(wc -c < "$WORK/good.bin")
+
+cp "$WORK/good.bin" "$WORK/corrupt.bin"
+printf 'corrupted block!' | \
+	dd of="$WORK/corrupt.bin" bs=1 seek=$((ERASESIZE * 2)) conv=notrunc 2>/dev/null
+head -c $((LEN - 1000)) "$WORK/good.bin" > "$WORK/truncated.bin"
+
+dd if="$WORK/good.bin" of="$WORK/good.first" bs="$ERASESIZE" count=1 2>/dev/null
+tr '\000' '\377' < /dev/zero | head -c "$ERASESIZE" > "$WORK/erased.first"
+
+if command -v uhttpd >/dev/null; then
+	uhttpd -f -p "127.0.0.1:$PORT" -h "$WORK" &
+elif busybox httpd --help >/dev/null 2>&1; then
+	busybox httpd -f -p "127.0.0.1:$PORT" -h "$WORK" &
+else
+	(cd "$WORK" && exec python3 -m http.server -b 127.0.0.1 "$PORT" >/dev/null 2>&1) &
+fi
+SERVER=$!
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	wget -q -O /dev/null "http://127.0.0.1:$PORT/meta.json" && break
+	sleep 1
+done
+
+# <image> <-T command>
+stream() {
+	rm -f "$WORK/meta" "$WORK/head"
+	wget -q -O- "http://127.0.0.1:$PORT/$1" | \
+		mtd -q -q -t "$WORK/meta" -H "$WORK/head" -T "$2" write - "$NAME"
+}
+
+# <description> <expected mtd status> <expected first block> <result>
+check() {
+	local first
+
+	dd if="$DEV" of="$WORK/dev.first" bs="$ERASESIZE" count=1 2>/dev/null
+	if cmp -s "$WORK/dev.first" "$WORK/good.first"; then
+		first=image
+	elif cmp -s "$WORK/dev.first" "$WORK/erased.first"; then
+		first=erased
+	else
+		first=other
+	fi
+
+	if [ "$4" = "$2" ] && [ "$first" = "$3" ]; then
+		echo "PASS: $1: mtd status $4, first block $first"
+	else
+		echo "FAIL: $1: mtd status $4 (expected $2), first block $first (expected $3)"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+good() {
+	stream good.bin true
+	check "good image" 0 image $?
+
+	# the trailers are stripped while streaming, as with fwtool -t
+	dd if="$DEV" bs="$ERASESIZE" count=4 2>/dev/null | \
+		head -c "$(wc -c < "$WORK/data.bin")" | cmp -s - "$WORK/data.bin" || {
+		echo "FAIL: good image: device contents differ from the image"
+		FAILED=$((FAILED + 1))
+	}
+	head -c 65536 "$WORK/good.bin" | cmp -s - "$WORK/head" || {
+		echo "FAIL: good image: -H head file differs from the image"
+		FAILED=$((FAILED + 1))
+	}
+}
+
+echo "Testing on $DEV ($NAME), erase block $ERASESIZE bytes, image $LEN bytes"
+
+# each failure case starts from a device holding a good image, so an erased
+# first block shows that it was erased and then held back
+good
+stream corrupt.bin true
+check "corrupted image" 1 erased $?
+
+good
+stream truncated.bin true
+check "truncated image" 1 erased $?
+
+good
+stream good.bin false
+check "good image, failing -T check" 1 erased $?
+
+good
+
+[ "$FAILED" = 0 ] && echo "All tests passed"
+[ "$FAILED" = 0 ]
@@ -82,15 +82,15 @@ platform_do_upgrade_combined() {
 }
 
 tplink_get_image_hwid() {
-	get_image "$@" | dd bs=4 count=1 skip=16 2>/dev/null | hexdump -v -n 4 -e '1/1 "%02x"'
+	imageprobe ${2:+-c "$2"} -o 64 -f magic_long_64 "$1" 2>/dev/null
 }
 
 tplink_get_image_mid() {
-	get_image "$@" | dd bs=4 count=1 skip=17 2>/dev/null | hexdump -v -n 4 -e '1/1 "%02x"'
+	imageprobe ${2:+-c "$2"} -o 68 -f magic_long_68 "$1" 2>/dev/null
 }
 
 tplink_get_image_boot_size() {
-	get_image "$@" | dd bs=4 count=1 skip=37 2>/dev/null | hexdump -v -n 4 -e '1/1 "%02x"'
+	imageprobe ${2:+-c "$2"} -o 148 -f magic_long_148 "$1" 2>/dev/null
 }
 
 tplink_pharos_check_image() {
@@ -185,11 +185,14 @@ alfa_check_image() {
 
 platform_check_image() {
 	local board=$(board_name)
-	local magic="$(get_magic_word "$1")"
-	local magic_long="$(get_magic_long "$1")"
 
 	[ "$#" -gt 1 ] && return 1
 
+	# the TP-Link header fields are read along with the magic
+	image_probe "$1" 64 68 148
+	local magic="$img_magic_word"
+	local magic_long="$img_magic_long"
+
 	case "$board" in
 	airgateway|\
 	airgatewaypro|\
@@ -471,8 +474,8 @@ platform_check_image() {
 
 		hwid=$(tplink_get_hwid)
 		mid=$(tplink_get_mid)
-		imagehwid=$(tplink_get_image_hwid "$1")
-		imagemid=$(tplink_get_image_mid "$1")
+		imagehwid="$img_magic_long_64"
+		imagemid="$img_magic_long_68"
 
 		[ "$hwid" != "$imagehwid" -o "$mid" != "$imagemid" ] && {
 			echo "Invalid image, hardware ID mismatch, hw:$hwid $mid image:$imagehwid $imagemid."
@@ -481,7 +484,7 @@ platform_check_image() {
 
 		local boot_size
 
-		boot_size=$(tplink_get_image_boot_size "$1")
+		boot_size="$img_magic_long_148"
 		[ "$boot_size" != "00000000" ] && {
 			echo "Invalid image, it contains a bootloader."
 			return 1
@@ -41,3 +41,19 @@ void flush_cache(unsigned long start_addr, unsigned long size)
 		addr += lsize;
 	}
 }
+
+void prefetch_range(unsigned long start_addr, unsigned long size)
+{
+	unsigned long lsize = CONFIG_CACHELINE_SIZE;
+	unsigned long addr = start_addr & ~(lsize - 1);
+	unsigned long aend = start_addr + size;
+
+	for (; addr < aend; addr += lsize)
+		__asm__ __volatile__(
+		"	.set	push				\n"
+		"	.set	mips32				\n"
+		"	pref	0, 0(%0)			\n"
+		"	.set	pop				\n"
+		:
+		: "r" (addr));
+}
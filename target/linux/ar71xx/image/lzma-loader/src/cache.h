@@ -13,5 +13,6 @@
 #define __CACHE_H
 
 void flush_cache(unsigned long start_addr, unsigned long size);
+void prefetch_range(unsigned long start_addr, unsigned long size);
 
 #endif /* __CACHE_H */
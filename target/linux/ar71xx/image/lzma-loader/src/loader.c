@@ -25,7 +25,7 @@
 #include "config.h"
 #include "cache.h"
 #include "printf.h"
-#include "LzmaDecode.h"
+#include "LzmaDec.h"
 
 #define AR71XX_FLASH_START	0x1f000000
 #define AR71XX_FLASH_END	0x1fe00000
@@ -33,8 +33,16 @@
 #define KSEG0			0x80000000
 #define KSEG1			0xa0000000
 
+#define KSEG0ADDR(a)		((((unsigned)(a)) & 0x1fffffffU) | KSEG0)
 #define KSEG1ADDR(a)		((((unsigned)(a)) & 0x1fffffffU) | KSEG1)
 
+/*
+ * The compressed stream is fed to the decoder in windows of this size,
+ * the next window is prefetched into the D-cache while the current one
+ * is being decoded.
+ */
+#define LZMA_IN_WINDOW		(32 * CONFIG_CACHELINE_SIZE)
+
 #undef LZMA_DEBUG
 
 #ifdef LZMA_DEBUG
@@ -66,8 +74,9 @@ typedef struct image_header {
 extern unsigned char workspace[];
 extern void board_init(void);
 
-static CLzmaDecoderState lzma_state;
+static CLzmaDec lzma_state;
 static unsigned char *lzma_data;
+static unsigned char *lzma_data_start;
 static unsigned long lzma_datasize;
 static unsigned long lzma_outsize;
 static unsigned long kernel_la;
@@ -110,12 +119,12 @@ static __inline__ unsigned char lzma_get_byte(void)
 
 static int lzma_init_props(void)
 {
-	unsigned char props[LZMA_PROPERTIES_SIZE];
+	unsigned char props[LZMA_PROPS_SIZE];
 	int res;
 	int i;
 
 	/* read lzma properties */
-	for (i = 0; i < LZMA_PROPERTIES_SIZE; i++)
+	for (i = 0; i < LZMA_PROPS_SIZE; i++)
 		props[i] = lzma_get_byte();
 
 	/* read the lower half of uncompressed size in the header */
@@ -128,29 +137,55 @@ static int lzma_init_props(void)
 	for (i = 0; i < 4; i++)
 		lzma_get_byte();
 
-	res = LzmaDecodeProperties(&lzma_state.Properties, props,
-					LZMA_PROPERTIES_SIZE);
+	res = LzmaProps_Decode(&lzma_state.prop, props, LZMA_PROPS_SIZE);
 	return res;
 }
 
 static int lzma_decompress(unsigned char *outStream)
 {
-	SizeT ip, op;
+	ELzmaStatus status;
+	SizeT ip;
 	int ret;
 
-	lzma_state.Probs = (CProb *) workspace;
+	lzma_state.probs = (CLzmaProb *) workspace;
+	lzma_state.dic = outStream;
+	lzma_state.dicBufSize = lzma_outsize;
+	LzmaDec_Init(&lzma_state);
+
+	prefetch_range((unsigned long) lzma_data, LZMA_IN_WINDOW);
+
+	do {
+		ip = lzma_datasize;
+		if (ip > LZMA_IN_WINDOW)
+			ip = LZMA_IN_WINDOW;
+
+		/* pull in the next window while this one is being decoded */
+		prefetch_range((unsigned long) lzma_data + ip, LZMA_IN_WINDOW);
 
-	ret = LzmaDecode(&lzma_state, lzma_data, lzma_datasize, &ip, outStream,
-			 lzma_outsize, &op);
+		ret = LzmaDec_DecodeToDic(&lzma_state, lzma_outsize, lzma_data,
+					  &ip, LZMA_FINISH_ANY, &status);
+
+		lzma_data += ip;
+		lzma_datasize -= ip;
+
+		if (ret != SZ_OK)
+			break;
+
+		if (status == LZMA_STATUS_NEEDS_MORE_INPUT && !lzma_datasize) {
+			ret = SZ_ERROR_DATA;
+			break;
+		}
+	} while (lzma_state.dicPos < lzma_outsize &&
+		 status != LZMA_STATUS_FINISHED_WITH_MARK);
 
-	if (ret != LZMA_RESULT_OK) {
+	if (ret != SZ_OK) {
 		int i;
 
-		DBG("LzmaDecode error %d at %08x, osize:%d ip:%d op:%d\n",
-		    ret, lzma_data + ip, lzma_outsize, ip, op);
+		DBG("LzmaDec error %d at %08x, osize:%d op:%d\n",
+		    ret, lzma_data, lzma_outsize, lzma_state.dicPos);
 
 		for (i = 0; i < 16; i++)
-			DBG("%02x ", lzma_data[ip + i]);
+			DBG("%02x ", lzma_data[i]);
 
 		DBG("\n");
 	}
@@ -166,6 +201,7 @@ static void lzma_init_data(void)
 
 	kernel_la = LOADADDR;
 	lzma_data = _lzma_data_start;
+	lzma_data_start = lzma_data;
 	lzma_datasize = _lzma_data_end - _lzma_data_start;
 }
 #else
@@ -177,7 +213,12 @@ static void lzma_init_data(void)
 	unsigned long kernel_ofs;
 	unsigned long kernel_size;
 
-	flash_base = (unsigned char *) KSEG1ADDR(AR71XX_FLASH_START);
+	/*
+	 * The flash is read through KSEG0 so that the decoder works on
+	 * cached, prefetched lines instead of doing an uncached bus cycle
+	 * for each byte.  The lines are dropped again after decompression.
+	 */
+	flash_base = (unsigned char *) KSEG0ADDR(AR71XX_FLASH_START);
 
 	printf("Looking for OpenWrt image... ");
 
@@ -207,6 +248,7 @@ static void lzma_init_data(void)
 	kernel_la = get_be32(&hdr->ih_load);
 
 	lzma_data = flash_base + flash_ofs + kernel_ofs;
+	lzma_data_start = lzma_data;
 	lzma_datasize = kernel_size;
 }
 #endif /* (LZMA_WRAPPER) */
@@ -226,7 +268,7 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 	lzma_init_data();
 
 	res = lzma_init_props();
-	if (res != LZMA_RESULT_OK) {
+	if (res != SZ_OK) {
 		printf("Incorrect LZMA stream properties!\n");
 		halt();
 	}
@@ -234,10 +276,10 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 	printf("Decompressing kernel... ");
 
 	res = lzma_decompress((unsigned char *) kernel_la);
-	if (res != LZMA_RESULT_OK) {
+	if (res != SZ_OK) {
 		printf("failed, ");
 		switch (res) {
-		case LZMA_RESULT_DATA_ERROR:
+		case SZ_ERROR_DATA:
 			printf("data error!\n");
 			break;
 		default:
@@ -249,6 +291,8 @@ void loader_main(unsigned long reg_a0, unsigned long reg_a1,
 	}
 
 	flush_cache(kernel_la, lzma_outsize);
+	flush_cache((unsigned long) lzma_data_start,
+		    lzma_data - lzma_data_start);
 
 	printf("Starting kernel at %08x...\n\n", kernel_la);
 
@@ -0,0 +1,251 @@
+/*
+ * Host throughput harness for the lzma-loader decoder
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * Decodes lzma-alone images (as built by lzma e / lzma-loader's Makefile)
+ * the same way loader.c does: LzmaDec_DecodeToDic() fed in windows of
+ * LZMA_IN_WINDOW bytes, straight into the output buffer. Built with
+ * -DBENCH_LZMADECODE it drives the old one-call LzmaDecode() instead, so
+ * both decoders can be compared on the same kernels. Reports the output
+ * rate in MB/s and compares the result byte for byte with a reference.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef BENCH_LZMADECODE
+#include "LzmaDecode.h"
+#define BENCH_DECODER	"LzmaDecode"
+#else
+#include "LzmaDec.h"
+#define BENCH_DECODER	"LzmaDec"
+#endif
+
+/* as in loader.c with 32 byte cache lines */
+#define LZMA_IN_WINDOW	(32 * 32)
+#define LZMA_HDR_SIZE	13
+
+static unsigned char *
+read_file(const char *name, size_t *len)
+{
+	unsigned char *buf = NULL;
+	size_t size = 0, n;
+	FILE *f;
+
+	f = fopen(name, "r");
+	if (!f) {
+		perror(name);
+		return NULL;
+	}
+
+	*len = 0;
+	do {
+		if (*len == size) {
+			size = size ? size * 2 : 1 << 20;
+			buf = realloc(buf, size);
+			if (!buf) {
+				fprintf(stderr, "Out of memory\n");
+				exit(1);
+			}
+		}
+		n = fread(buf + *len, 1, size - *len, f);
+		*len += n;
+	} while (n > 0);
+
+	fclose(f);
+	return buf;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef BENCH_LZMADECODE
+static int
+decode(const unsigned char *in, size_t in_len, unsigned char *out,
+       size_t out_len, void *workspace, size_t *done)
+{
+	CLzmaDecoderState state;
+	SizeT ip, op;
+	int ret;
+
+	if (LzmaDecodeProperties(&state.Properties, in, LZMA_PROPERTIES_SIZE) !=
+	    LZMA_RESULT_OK)
+		return -1;
+
+	state.Probs = workspace;
+	ret = LzmaDecode(&state, in + LZMA_HDR_SIZE, in_len - LZMA_HDR_SIZE,
+			 &ip, out, out_len, &op);
+	*done = op;
+
+	return ret == LZMA_RESULT_OK ? 0 : -1;
+}
+
+static size_t
+workspace_size(const unsigned char *in)
+{
+	CLzmaProperties props;
+
+	if (LzmaDecodeProperties(&props, in, LZMA_PROPERTIES_SIZE) != LZMA_RESULT_OK)
+		return 0;
+
+	return LzmaGetNumProbs(&props) * sizeof(CProb);
+}
+#else
+static int
+decode(const unsigned char *in, size_t in_len, unsigned char *out,
+       size_t out_len, void *workspace, size_t *done)
+{
+	const unsigned char *data = in + LZMA_HDR_SIZE;
+	size_t datasize = in_len - LZMA_HDR_SIZE;
+	ELzmaStatus status;
+	CLzmaDec state;
+	SizeT ip;
+	int ret;
+
+	if (LzmaProps_Decode(&state.prop, in, LZMA_PROPS_SIZE) != SZ_OK)
+		return -1;
+
+	state.probs = workspace;
+	state.dic = out;
+	state.dicBufSize = out_len;
+	LzmaDec_Init(&state);
+
+	do {
+		ip = datasize;
+		if (ip > LZMA_IN_WINDOW)
+			ip = LZMA_IN_WINDOW;
+
+		ret = LzmaDec_DecodeToDic(&state, out_len, data, &ip,
+					  LZMA_FINISH_ANY, &status);
+		data += ip;
+		datasize -= ip;
+
+		if (ret != SZ_OK)
+			break;
+
+		if (status == LZMA_STATUS_NEEDS_MORE_INPUT && !datasize) {
+			ret = SZ_ERROR_DATA;
+			break;
+		}
+	} while (state.dicPos < out_len &&
+		 status != LZMA_STATUS_FINISHED_WITH_MARK);
+
+	*done = state.dicPos;
+
+	return ret == SZ_OK ? 0 : -1;
+}
+
+static size_t
+workspace_size(const unsigned char *in)
+{
+	CLzmaProps props;
+
+	if (LzmaProps_Decode(&props, in, LZMA_PROPS_SIZE) != SZ_OK)
+		return 0;
+
+	return LzmaProps_GetNumProbs(&props) * sizeof(CLzmaProb);
+}
+#endif
+
+static int
+usage(const char *progname)
+{
+	fprintf(stderr, "Usage: %s [<options>] <image.lzma> [<reference>]\n"
+		"\n"
+		"Options:\n"
+		"  -n <count>:		Decode the image <count> times (default: 10)\n"
+		"\n", progname);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *in, *out, *ref = NULL;
+	size_t in_len, out_len, ref_len = 0, done = 0;
+	double start, best = 0;
+	void *workspace;
+	int count = 10;
+	int i, ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (count < 1 || (optind + 1 != argc && optind + 2 != argc))
+		return usage(argv[0]);
+
+	in = read_file(argv[optind], &in_len);
+	if (!in)
+		return 1;
+
+	if (optind + 2 == argc && !(ref = read_file(argv[optind + 1], &ref_len)))
+		return 1;
+
+	if (in_len < LZMA_HDR_SIZE || !workspace_size(in)) {
+		fprintf(stderr, "%s: not an lzma image\n", argv[optind]);
+		return 1;
+	}
+
+	/* the loader needs the size in the header, as written by OpenWrt's lzma */
+	if (in[5] == 0xff && in[6] == 0xff && in[7] == 0xff && in[8] == 0xff) {
+		fprintf(stderr, "%s: uncompressed size not stored\n", argv[optind]);
+		return 1;
+	}
+
+	/* the loader only looks at the lower half of the size as well */
+	out_len = in[5] | (in[6] << 8) | (in[7] << 16) | ((size_t) in[8] << 24);
+	out = malloc(out_len);
+	workspace = malloc(workspace_size(in));
+	if (!out || !workspace) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		double t;
+
+		start = now();
+		if (decode(in, in_len, out, out_len, workspace, &done) ||
+		    done != out_len) {
+			fprintf(stderr, "%s: decode error after %zu bytes\n",
+				argv[optind], done);
+			return 1;
+		}
+
+		t = now() - start;
+		if (!i || t < best)
+			best = t;
+	}
+
+	printf("%s: %s: %zu -> %zu bytes, %.2f MB/s (best of %d)\n",
+	       argv[optind], BENCH_DECODER, in_len, out_len,
+	       out_len / best / 1e6, count);
+
+	if (ref && (ref_len != out_len || memcmp(ref, out, out_len))) {
+		fprintf(stderr, "%s: output differs from %s\n", argv[optind],
+			argv[optind + 1]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -26,6 +26,8 @@
 #include <linux/timer.h>
 #include <linux/ctype.h>
 #include <linux/leds.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
 
 #include "leds.h"
 
@@ -41,6 +43,14 @@
  *   tx:   LED blinks on transmitted data
  *   rx:   LED blinks on receive data
  *
+ * rate_threshold - traffic rate in bytes per second (tx and/or rx, as selected
+ *   by mode) below which the LED blinks at a quarter of the normal frequency,
+ *   0 (the default) blinks at the same frequency for any traffic
+ *
+ * All LEDs monitoring the same device with the same interval share a single
+ * sampler, which reads the device statistics once per interval. No sampling
+ * is done while no LED is in tx or rx mode on a device with link.
+ *
  * Some suggestions:
  *
  *  Simple link status LED:
@@ -67,12 +77,37 @@
 #define MODE_TX   2
 #define MODE_RX   4
 
+/* below rate_threshold, only every SLOW_TICKS-th sample is shown */
+#define SLOW_TICKS 4
+
+struct led_netdev_sampler {
+	struct list_head list;
+	struct list_head leds;
+
+	struct delayed_work work;
+	struct net_device *net_dev;
+	unsigned interval;
+	unsigned ticks;
+
+	u64 tx_packets;
+	u64 rx_packets;
+	u64 tx_bytes;
+	u64 rx_bytes;
+
+	/* bytes per second over the last interval */
+	u64 tx_rate;
+	u64 rx_rate;
+};
+
 struct led_netdev_data {
 	spinlock_t lock;
 
-	struct delayed_work work;
 	struct notifier_block notifier;
 
+	/* protected by samplers_lock */
+	struct led_netdev_sampler *sampler;
+	struct list_head sampler_list;
+
 	struct led_classdev *led_cdev;
 	struct net_device *net_dev;
 
@@ -81,17 +116,107 @@ struct led_netdev_data {
 	unsigned mode;
 	unsigned link_up;
 	unsigned last_activity;
+	unsigned rate_threshold;
 };
 
+static LIST_HEAD(samplers);
+static DEFINE_MUTEX(samplers_lock);
+
 static void set_baseline_state(struct led_netdev_data *trigger_data)
 {
 	if ((trigger_data->mode & MODE_LINK) != 0 && trigger_data->link_up)
 		led_set_brightness(trigger_data->led_cdev, LED_FULL);
 	else
 		led_set_brightness(trigger_data->led_cdev, LED_OFF);
+}
 
-	if ((trigger_data->mode & (MODE_TX | MODE_RX)) != 0 && trigger_data->link_up)
-		schedule_delayed_work(&trigger_data->work, trigger_data->interval);
+static void netdev_trig_sample(struct led_netdev_sampler *sampler)
+{
+	struct rtnl_link_stats64 temp, *dev_stats;
+	unsigned interval_ms = jiffies_to_msecs(sampler->interval) ?: 1;
+
+	dev_stats = dev_get_stats(sampler->net_dev, &temp);
+
+	sampler->tx_rate = div_u64((dev_stats->tx_bytes - sampler->tx_bytes) *
+				   MSEC_PER_SEC, interval_ms);
+	sampler->rx_rate = div_u64((dev_stats->rx_bytes - sampler->rx_bytes) *
+				   MSEC_PER_SEC, interval_ms);
+	sampler->tx_bytes = dev_stats->tx_bytes;
+	sampler->rx_bytes = dev_stats->rx_bytes;
+	sampler->tx_packets = dev_stats->tx_packets;
+	sampler->rx_packets = dev_stats->rx_packets;
+	sampler->ticks++;
+}
+
+static void netdev_trig_work(struct work_struct *work);
+
+/* attach to or detach from a sampler to match the current state */
+static void netdev_trig_update_sampler(struct led_netdev_data *trigger_data)
+{
+	struct led_netdev_sampler *sampler, *old = NULL;
+	struct net_device *net_dev = NULL;
+	unsigned interval;
+
+	mutex_lock(&samplers_lock);
+
+	spin_lock_bh(&trigger_data->lock);
+	if (trigger_data->net_dev && trigger_data->link_up &&
+	    (trigger_data->mode & (MODE_TX | MODE_RX)) != 0) {
+		net_dev = trigger_data->net_dev;
+		dev_hold(net_dev);
+	}
+	interval = trigger_data->interval;
+	spin_unlock_bh(&trigger_data->lock);
+
+	sampler = trigger_data->sampler;
+	if (sampler) {
+		if (sampler->net_dev == net_dev && sampler->interval == interval)
+			goto out;
+
+		list_del(&trigger_data->sampler_list);
+		trigger_data->sampler = NULL;
+		if (list_empty(&sampler->leds)) {
+			list_del(&sampler->list);
+			old = sampler;
+		}
+	}
+
+	if (!net_dev)
+		goto out;
+
+	list_for_each_entry(sampler, &samplers, list)
+		if (sampler->net_dev == net_dev &&
+		    sampler->interval == interval)
+			goto found;
+
+	sampler = kzalloc(sizeof(*sampler), GFP_KERNEL);
+	if (!sampler)
+		goto out;
+
+	INIT_LIST_HEAD(&sampler->leds);
+	INIT_DELAYED_WORK(&sampler->work, netdev_trig_work);
+	dev_hold(net_dev);
+	sampler->net_dev = net_dev;
+	sampler->interval = interval;
+	netdev_trig_sample(sampler);
+	list_add(&sampler->list, &samplers);
+	schedule_delayed_work(&sampler->work, interval);
+
+found:
+	list_add(&trigger_data->sampler_list, &sampler->leds);
+	trigger_data->sampler = sampler;
+
+out:
+	mutex_unlock(&samplers_lock);
+
+	if (net_dev)
+		dev_put(net_dev);
+
+	if (old) {
+		cancel_delayed_work_sync(&old->work);
+		dev_put(old->net_dev);
+		kfree(old);
+	}
 }
 
 static ssize_t led_device_name_show(struct device *dev,
@@ -116,10 +241,13 @@ static ssize_t led_device_name_store(struct device *dev,
 	if (size >= IFNAMSIZ)
 		return -EINVAL;
 
-	cancel_delayed_work_sync(&trigger_data->work);
-
 	spin_lock_bh(&trigger_data->lock);
 
+	if (trigger_data->net_dev != NULL) {
+		dev_put(trigger_data->net_dev);
+		trigger_data->net_dev = NULL;
+	}
+
 	strcpy(trigger_data->device_name, buf);
 	if (size > 0 && trigger_data->device_name[size-1] == '\n')
 		trigger_data->device_name[size-1] = 0;
@@ -136,6 +264,8 @@ static ssize_t led_device_name_store(struct device *dev,
 	set_baseline_state(trigger_data);
 	spin_unlock_bh(&trigger_data->lock);
 
+	netdev_trig_update_sampler(trigger_data);
+
 	return size;
 }
 
@@ -202,13 +332,13 @@ static ssize_t led_mode_store(struct device *dev,
 	if (new_mode == -1)
 		return -EINVAL;
 
-	cancel_delayed_work_sync(&trigger_data->work);
-
 	spin_lock_bh(&trigger_data->lock);
 	trigger_data->mode = new_mode;
 	set_baseline_state(trigger_data);
 	spin_unlock_bh(&trigger_data->lock);
 
+	netdev_trig_update_sampler(trigger_data);
+
 	return size;
 }
 
@@ -242,13 +372,13 @@ static ssize_t led_interval_store(struct device *dev,
 
 	/* impose some basic bounds on the timer interval */
 	if (count == size && value >= 5 && value <= 10000) {
-		cancel_delayed_work_sync(&trigger_data->work);
-
 		spin_lock_bh(&trigger_data->lock);
 		trigger_data->interval = msecs_to_jiffies(value);
-		set_baseline_state(trigger_data); /* resets timer */
+		set_baseline_state(trigger_data);
 		spin_unlock_bh(&trigger_data->lock);
 
+		netdev_trig_update_sampler(trigger_data); /* resets timer */
+
 		ret = count;
 	}
 
@@ -257,6 +387,41 @@ static ssize_t led_interval_store(struct device *dev,
 
 static DEVICE_ATTR(interval, 0644, led_interval_show, led_interval_store);
 
+static ssize_t led_rate_threshold_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct led_classdev *led_cdev = dev_get_drvdata(dev);
+	struct led_netdev_data *trigger_data = led_cdev->trigger_data;
+
+	spin_lock_bh(&trigger_data->lock);
+	sprintf(buf, "%u\n", trigger_data->rate_threshold);
+	spin_unlock_bh(&trigger_data->lock);
+
+	return strlen(buf) + 1;
+}
+
+static ssize_t led_rate_threshold_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t size)
+{
+	struct led_classdev *led_cdev = dev_get_drvdata(dev);
+	struct led_netdev_data *trigger_data = led_cdev->trigger_data;
+	unsigned value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret)
+		return ret;
+
+	spin_lock_bh(&trigger_data->lock);
+	trigger_data->rate_threshold = value;
+	spin_unlock_bh(&trigger_data->lock);
+
+	return size;
+}
+
+static DEVICE_ATTR(rate_threshold, 0644, led_rate_threshold_show,
+		   led_rate_threshold_store);
+
 static int netdev_trig_notify(struct notifier_block *nb,
 			      unsigned long evt,
 			      void *dv)
@@ -270,8 +435,6 @@ static int netdev_trig_notify(struct notifier_block *nb,
 	if (strcmp(dev->name, trigger_data->device_name))
 		return NOTIFY_DONE;
 
-	cancel_delayed_work_sync(&trigger_data->work);
-
 	spin_lock_bh(&trigger_data->lock);
 
 	if (evt == NETDEV_REGISTER || evt == NETDEV_CHANGENAME) {
@@ -297,27 +460,33 @@ static int netdev_trig_notify(struct notifier_block *nb,
 
 done:
 	spin_unlock_bh(&trigger_data->lock);
+
+	netdev_trig_update_sampler(trigger_data);
+
 	return NOTIFY_DONE;
 }
 
-/* here's the real work! */
-static void netdev_trig_work(struct work_struct *work)
+static void netdev_trig_led_update(struct led_netdev_data *trigger_data,
+				   struct led_netdev_sampler *sampler)
 {
-	struct led_netdev_data *trigger_data = container_of(work, struct led_netdev_data, work.work);
-	struct rtnl_link_stats64 *dev_stats;
 	unsigned new_activity;
-	struct rtnl_link_stats64 temp;
+	u64 rate;
 
-	if (!trigger_data->link_up || !trigger_data->net_dev || (trigger_data->mode & (MODE_TX | MODE_RX)) == 0) {
-		/* we don't need to do timer work, just reflect link state. */
-		led_set_brightness(trigger_data->led_cdev, ((trigger_data->mode & MODE_LINK) != 0 && trigger_data->link_up) ? LED_FULL : LED_OFF);
-		return;
-	}
+	spin_lock_bh(&trigger_data->lock);
+
+	if (!trigger_data->link_up || (trigger_data->mode & (MODE_TX | MODE_RX)) == 0)
+		goto out;
+
+	rate = ((trigger_data->mode & MODE_TX) ? sampler->tx_rate : 0) +
+	       ((trigger_data->mode & MODE_RX) ? sampler->rx_rate : 0);
+
+	/* keep the activity for a later sample, giving a slower blink */
+	if (rate < trigger_data->rate_threshold && sampler->ticks % SLOW_TICKS)
+		goto out;
 
-	dev_stats = dev_get_stats(trigger_data->net_dev, &temp);
 	new_activity =
-		((trigger_data->mode & MODE_TX) ? dev_stats->tx_packets : 0) +
-		((trigger_data->mode & MODE_RX) ? dev_stats->rx_packets : 0);
+		((trigger_data->mode & MODE_TX) ? sampler->tx_packets : 0) +
+		((trigger_data->mode & MODE_RX) ? sampler->rx_packets : 0);
 
 	if (trigger_data->mode & MODE_LINK) {
 		/* base state is ON (link present) */
@@ -342,7 +511,32 @@ static void netdev_trig_work(struct work_struct *work)
 	}
 
 	trigger_data->last_activity = new_activity;
-	schedule_delayed_work(&trigger_data->work, trigger_data->interval);
+
+out:
+	spin_unlock_bh(&trigger_data->lock);
+}
+
+/* here's the real work! */
+static void netdev_trig_work(struct work_struct *work)
+{
+	struct led_netdev_sampler *sampler = container_of(work, struct led_netdev_sampler, work.work);
+	struct led_netdev_data *trigger_data;
+
+	mutex_lock(&samplers_lock);
+
+	/* the last LED is detaching, it cancels and frees the sampler */
+	if (list_empty(&sampler->leds))
+		goto out;
+
+	netdev_trig_sample(sampler);
+
+	list_for_each_entry(trigger_data, &sampler->leds, sampler_list)
+		netdev_trig_led_update(trigger_data, sampler);
+
+	schedule_delayed_work(&sampler->work, sampler->interval);
+
+out:
+	mutex_unlock(&samplers_lock);
 }
 
 static void netdev_trig_activate(struct led_classdev *led_cdev)
@@ -359,7 +553,7 @@ static void netdev_trig_activate(struct led_classdev *led_cdev)
 	trigger_data->notifier.notifier_call = netdev_trig_notify;
 	trigger_data->notifier.priority = 10;
 
-	INIT_DELAYED_WORK(&trigger_data->work, netdev_trig_work);
+	INIT_LIST_HEAD(&trigger_data->sampler_list);
 
 	trigger_data->led_cdev = led_cdev;
 	trigger_data->net_dev = NULL;
@@ -381,10 +575,15 @@ static void netdev_trig_activate(struct led_classdev *led_cdev)
 	rc = device_create_file(led_cdev->dev, &dev_attr_interval);
 	if (rc)
 		goto err_out_mode;
+	rc = device_create_file(led_cdev->dev, &dev_attr_rate_threshold);
+	if (rc)
+		goto err_out_interval;
 
 	register_netdevice_notifier(&trigger_data->notifier);
 	return;
 
+err_out_interval:
+	device_remove_file(led_cdev->dev, &dev_attr_interval);
 err_out_mode:
 	device_remove_file(led_cdev->dev, &dev_attr_mode);
 err_out_device_name:
@@ -404,8 +603,7 @@ static void netdev_trig_deactivate(struct led_classdev *led_cdev)
 		device_remove_file(led_cdev->dev, &dev_attr_device_name);
 		device_remove_file(led_cdev->dev, &dev_attr_mode);
 		device_remove_file(led_cdev->dev, &dev_attr_interval);
-
-		cancel_delayed_work_sync(&trigger_data->work);
+		device_remove_file(led_cdev->dev, &dev_attr_rate_threshold);
 
 		spin_lock_bh(&trigger_data->lock);
 
@@ -416,6 +614,9 @@ static void netdev_trig_deactivate(struct led_classdev *led_cdev)
 
 		spin_unlock_bh(&trigger_data->lock);
 
+		/* detaches from the sampler, there is no device anymore */
+		netdev_trig_update_sampler(trigger_data);
+
 		kfree(trigger_data);
 	}
 }
@@ -204,24 +204,31 @@ ar8xxx_phy_init(struct ar8xxx_priv *priv)
 	ar8xxx_phy_poll_reset(bus);
 }
 
+/* called with mii_bus->mdio_lock held, which also covers the counters */
 u32
 ar8xxx_mii_read32(struct ar8xxx_priv *priv, int phy_id, int regnum)
 {
 	struct mii_bus *bus = priv->mii_bus;
 	u16 lo, hi;
 
+	lockdep_assert_held(&bus->mdio_lock);
+
 	lo = bus->read(bus, phy_id, regnum);
 	hi = bus->read(bus, phy_id, regnum + 1);
+	priv->mdio_reads += 2;
 
-	return (hi << 16) | lo;
+	return ((u32) hi << 16) | lo;
 }
 
+/* called with mii_bus->mdio_lock held */
 void
 ar8xxx_mii_write32(struct ar8xxx_priv *priv, int phy_id, int regnum, u32 val)
 {
 	struct mii_bus *bus = priv->mii_bus;
 	u16 lo, hi;
 
+	lockdep_assert_held(&bus->mdio_lock);
+
 	lo = val & 0xffff;
 	hi = (u16) (val >> 16);
 
@@ -233,12 +240,38 @@ ar8xxx_mii_write32(struct ar8xxx_priv *priv, int phy_id, int regnum, u32 val)
 		bus->write(bus, phy_id, regnum + 1, hi);
 		bus->write(bus, phy_id, regnum, lo);
 	}
+	priv->mdio_writes += 2;
+}
+
+/* called with mii_bus->mdio_lock held */
+void
+ar8xxx_mii_set_page(struct ar8xxx_priv *priv, u16 page)
+{
+	struct mii_bus *bus = priv->mii_bus;
+
+	lockdep_assert_held(&bus->mdio_lock);
+
+	if (priv->mii_page == page)
+		return;
+
+	bus->write(bus, 0x18, 0, page);
+	wait_for_page_switch();
+	priv->mii_page = page;
+	priv->mdio_page_writes++;
+}
+
+static inline bool
+ar8xxx_reg_cacheable(struct ar8xxx_priv *priv, int reg)
+{
+	return priv->chip && priv->chip->reg_cacheable &&
+	       priv->chip->reg_cacheable(priv, reg);
 }
 
 u32
 ar8xxx_read(struct ar8xxx_priv *priv, int reg)
 {
 	struct mii_bus *bus = priv->mii_bus;
+	bool cacheable = ar8xxx_reg_cacheable(priv, reg);
 	u16 r1, r2, page;
 	u32 val;
 
@@ -246,10 +279,16 @@ ar8xxx_read(struct ar8xxx_priv *priv, int reg)
 
 	mutex_lock(&bus->mdio_lock);
 
-	bus->write(bus, 0x18, 0, page);
-	wait_for_page_switch();
+	if (cacheable && switch_regcache_read(&priv->regcache, reg, &val))
+		goto out;
+
+	ar8xxx_mii_set_page(priv, page);
 	val = ar8xxx_mii_read32(priv, 0x10 | r2, r1);
 
+	if (cacheable)
+		switch_regcache_update(&priv->regcache, reg, val);
+
+out:
 	mutex_unlock(&bus->mdio_lock);
 
 	return val;
@@ -259,16 +298,23 @@ void
 ar8xxx_write(struct ar8xxx_priv *priv, int reg, u32 val)
 {
 	struct mii_bus *bus = priv->mii_bus;
+	bool cacheable = ar8xxx_reg_cacheable(priv, reg);
 	u16 r1, r2, page;
 
 	split_addr((u32) reg, &r1, &r2, &page);
 
 	mutex_lock(&bus->mdio_lock);
 
-	bus->write(bus, 0x18, 0, page);
-	wait_for_page_switch();
+	if (cacheable && switch_regcache_unchanged(&priv->regcache, reg, val))
+		goto out;
+
+	ar8xxx_mii_set_page(priv, page);
 	ar8xxx_mii_write32(priv, 0x10 | r2, r1, val);
 
+	if (cacheable)
+		switch_regcache_update(&priv->regcache, reg, val);
+
+out:
 	mutex_unlock(&bus->mdio_lock);
 }
 
@@ -276,21 +322,36 @@ u32
 ar8xxx_rmw(struct ar8xxx_priv *priv, int reg, u32 mask, u32 val)
 {
 	struct mii_bus *bus = priv->mii_bus;
+	bool cacheable = ar8xxx_reg_cacheable(priv, reg);
 	u16 r1, r2, page;
-	u32 ret;
+	u32 ret, old;
 
 	split_addr((u32) reg, &r1, &r2, &page);
 
 	mutex_lock(&bus->mdio_lock);
 
-	bus->write(bus, 0x18, 0, page);
-	wait_for_page_switch();
+	if (!cacheable || !switch_regcache_read(&priv->regcache, reg, &old)) {
+		ar8xxx_mii_set_page(priv, page);
+		old = ar8xxx_mii_read32(priv, 0x10 | r2, r1);
+	}
 
-	ret = ar8xxx_mii_read32(priv, 0x10 | r2, r1);
+	ret = old;
 	ret &= ~mask;
 	ret |= val;
+
+	if (cacheable && ret == old) {
+		priv->regcache.skipped++;
+		switch_regcache_update(&priv->regcache, reg, ret);
+		goto out;
+	}
+
+	ar8xxx_mii_set_page(priv, page);
 	ar8xxx_mii_write32(priv, 0x10 | r2, r1, ret);
 
+	if (cacheable)
+		switch_regcache_update(&priv->regcache, reg, ret);
+
+out:
 	mutex_unlock(&bus->mdio_lock);
 
 	return ret;
@@ -740,7 +801,6 @@ ar8216_wait_atu_ready(struct ar8xxx_priv *priv, u16 r2, u16 r1)
 static void ar8216_get_arl_entry(struct ar8xxx_priv *priv,
 				 struct arl_entry *a, u32 *status, enum arl_op op)
 {
-	struct mii_bus *bus = priv->mii_bus;
 	u16 r2, page;
 	u16 r1_func0, r1_func1, r1_func2;
 	u32 t, val0, val1, val2;
@@ -757,8 +817,7 @@ static void ar8216_get_arl_entry(struct ar8xxx_priv *priv,
 		/* all ATU registers are on the same page
 		* therefore set page only once
 		*/
-		bus->write(bus, 0x18, 0, page);
-		wait_for_page_switch();
+		ar8xxx_mii_set_page(priv, page);
 
 		ar8216_wait_atu_ready(priv, r2, r1_func0);
 
@@ -767,6 +826,9 @@ static void ar8216_get_arl_entry(struct ar8xxx_priv *priv,
 		ar8xxx_mii_write32(priv, r2, r1_func2, 0);
 		break;
 	case AR8XXX_ARL_GET_NEXT:
+		/* no-op unless another access moved the page meanwhile */
+		ar8xxx_mii_set_page(priv, page);
+
 		t = ar8xxx_mii_read32(priv, r2, r1_func0);
 		t |= AR8216_ATU_ACTIVE;
 		ar8xxx_mii_write32(priv, r2, r1_func0, t);
@@ -1467,6 +1529,42 @@ ar8xxx_sw_set_arl_age_time(struct switch_dev *dev, const struct switch_attr *att
 	return 0;
 }
 
+int
+ar8xxx_sw_get_mibs(struct switch_dev *dev,
+		   const struct switch_attr *attr,
+		   struct switch_val *val)
+{
+	struct ar8xxx_priv *priv = swdev_to_ar8xxx(dev);
+	const struct ar8xxx_chip *chip = priv->chip;
+	struct switch_counters *counters = val->value.counters;
+	int port;
+	int ret;
+
+	if (!ar8xxx_has_mib_counters(priv))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&priv->mib_lock);
+	ret = ar8xxx_mib_capture(priv);
+	if (ret)
+		goto unlock;
+
+	for (port = 0; port < dev->ports; port++)
+		ar8xxx_mib_fetch_port_stat(priv, port, false);
+
+	/* the MIB work keeps updating mib_stats after we drop the lock */
+	memcpy(priv->mib_snapshot, priv->mib_stats,
+	       dev->ports * chip->num_mibs * sizeof(*priv->mib_stats));
+
+	counters->n_ports = dev->ports;
+	counters->n_counters = chip->num_mibs;
+	counters->names = priv->mib_names;
+	counters->values = priv->mib_snapshot;
+
+unlock:
+	mutex_unlock(&priv->mib_lock);
+	return ret;
+}
+
 int
 ar8xxx_sw_get_arl_age_time(struct switch_dev *dev, const struct switch_attr *attr,
                    struct switch_val *val)
@@ -1547,6 +1645,28 @@ ar8xxx_sw_get_arl_table(struct switch_dev *dev,
 	return 0;
 }
 
+int
+ar8xxx_sw_get_mdio_stats(struct switch_dev *dev,
+			 const struct switch_attr *attr,
+			 struct switch_val *val)
+{
+	struct ar8xxx_priv *priv = swdev_to_ar8xxx(dev);
+	struct mii_bus *bus = priv->mii_bus;
+
+	mutex_lock(&bus->mdio_lock);
+	val->len = snprintf(priv->buf, sizeof(priv->buf),
+			    "reads: %lu\nwrites: %lu\npage writes: %lu\n"
+			    "cache hits: %lu\ncache skipped writes: %lu\n",
+			    priv->mdio_reads, priv->mdio_writes,
+			    priv->mdio_page_writes, priv->regcache.hits,
+			    priv->regcache.skipped);
+	mutex_unlock(&bus->mdio_lock);
+
+	val->value.s = priv->buf;
+
+	return 0;
+}
+
 int
 ar8xxx_sw_set_flush_arl_table(struct switch_dev *dev,
 			      const struct switch_attr *attr,
@@ -1596,6 +1716,12 @@ static const struct switch_attr ar8xxx_sw_attr_globals[] = {
 		.description = "Reset all MIB counters",
 		.set = ar8xxx_sw_set_reset_mibs,
 	},
+	{
+		.type = SWITCH_TYPE_COUNTERS,
+		.name = "mibs",
+		.description = "Get MIB counters of all ports",
+		.get = ar8xxx_sw_get_mibs,
+	},
 	{
 		.type = SWITCH_TYPE_INT,
 		.name = "enable_mirror_rx",
@@ -1635,6 +1761,13 @@ static const struct switch_attr ar8xxx_sw_attr_globals[] = {
 		.set = NULL,
 		.get = ar8xxx_sw_get_arl_table,
 	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "mdio_stats",
+		.description = "Get MDIO transaction and register cache counts",
+		.set = NULL,
+		.get = ar8xxx_sw_get_mdio_stats,
+	},
 	{
 		.type = SWITCH_TYPE_NOVAL,
 		.name = "flush_arl_table",
@@ -1708,6 +1841,33 @@ static const struct switch_dev_ops ar8xxx_sw_ops = {
 #endif
 };
 
+/* port control and VLAN registers are only changed by the driver */
+static bool
+ar8216_reg_cacheable(struct ar8xxx_priv *priv, int reg)
+{
+	int port, ofs;
+
+	if (reg < AR8216_PORT_OFFSET(0) ||
+	    reg >= AR8216_PORT_OFFSET(AR8216_NUM_PORTS))
+		return false;
+
+	port = reg / 0x100 - 1;
+	ofs = reg - AR8216_PORT_OFFSET(port);
+
+	return ofs == 0x0004 || ofs == 0x0008;
+}
+
+static bool
+ar8236_reg_cacheable(struct ar8xxx_priv *priv, int reg)
+{
+	if (ar8216_reg_cacheable(priv, reg))
+		return true;
+
+	return reg >= AR8216_PORT_OFFSET(0) &&
+	       reg < AR8216_PORT_OFFSET(AR8216_NUM_PORTS) &&
+	       (reg & 0xff) == 0x000c;
+}
+
 static const struct ar8xxx_chip ar8216_chip = {
 	.caps = AR8XXX_CAP_MIB_COUNTERS,
 
@@ -1721,6 +1881,7 @@ static const struct ar8xxx_chip ar8216_chip = {
 	.swops = &ar8xxx_sw_ops,
 
 	.hw_init = ar8216_hw_init,
+	.reg_cacheable = ar8216_reg_cacheable,
 	.init_globals = ar8216_init_globals,
 	.init_port = ar8216_init_port,
 	.setup_port = ar8216_setup_port,
@@ -1751,6 +1912,7 @@ static const struct ar8xxx_chip ar8236_chip = {
 	.swops = &ar8xxx_sw_ops,
 
 	.hw_init = ar8216_hw_init,
+	.reg_cacheable = ar8236_reg_cacheable,
 	.init_globals = ar8236_init_globals,
 	.init_port = ar8216_init_port,
 	.setup_port = ar8236_setup_port,
@@ -1781,6 +1943,7 @@ static const struct ar8xxx_chip ar8316_chip = {
 	.swops = &ar8xxx_sw_ops,
 
 	.hw_init = ar8316_hw_init,
+	.reg_cacheable = ar8216_reg_cacheable,
 	.init_globals = ar8316_init_globals,
 	.init_port = ar8216_init_port,
 	.setup_port = ar8216_setup_port,
@@ -1881,6 +2044,7 @@ static int
 ar8xxx_mib_init(struct ar8xxx_priv *priv)
 {
 	unsigned int len;
+	int i;
 
 	if (!ar8xxx_has_mib_counters(priv))
 		return 0;
@@ -1890,10 +2054,16 @@ ar8xxx_mib_init(struct ar8xxx_priv *priv)
 	len = priv->dev.ports * priv->chip->num_mibs *
 	      sizeof(*priv->mib_stats);
 	priv->mib_stats = kzalloc(len, GFP_KERNEL);
+	priv->mib_snapshot = kzalloc(len, GFP_KERNEL);
+	priv->mib_names = kcalloc(priv->chip->num_mibs,
+				  sizeof(*priv->mib_names), GFP_KERNEL);
 
-	if (!priv->mib_stats)
+	if (!priv->mib_stats || !priv->mib_snapshot || !priv->mib_names)
 		return -ENOMEM;
 
+	for (i = 0; i < priv->chip->num_mibs; i++)
+		priv->mib_names[i] = priv->chip->mib_decs[i].name;
+
 	return 0;
 }
 
@@ -1927,6 +2097,7 @@ ar8xxx_create(void)
 
 	mutex_init(&priv->reg_mutex);
 	mutex_init(&priv->mib_lock);
+	priv->mii_page = AR8XXX_PAGE_INVALID;
 	INIT_DELAYED_WORK(&priv->mib_work, ar8xxx_mib_work_func);
 
 	return priv;
@@ -1940,6 +2111,9 @@ ar8xxx_free(struct ar8xxx_priv *priv)
 
 	kfree(priv->chip_data);
 	kfree(priv->mib_stats);
+	kfree(priv->mib_snapshot);
+	kfree(priv->mib_names);
+	switch_regcache_free(&priv->regcache);
 	kfree(priv);
 }
 
@@ -1963,6 +2137,13 @@ ar8xxx_probe_switch(struct ar8xxx_priv *priv)
 	swdev->ports = chip->ports;
 	swdev->ops = chip->swops;
 
+	if (chip->reg_cacheable) {
+		ret = switch_regcache_init(&priv->regcache, 0,
+					   AR8XXX_REGCACHE_SIZE / 4, 4);
+		if (ret)
+			return ret;
+	}
+
 	ret = ar8xxx_mib_init(priv);
 	if (ret)
 		return ret;
@@ -1981,6 +2162,12 @@ ar8xxx_start(struct ar8xxx_priv *priv)
 	if (ret)
 		return ret;
 
+	/* the switch may have been reset, forget its register state */
+	mutex_lock(&priv->mii_bus->mdio_lock);
+	priv->mii_page = AR8XXX_PAGE_INVALID;
+	switch_regcache_invalidate(&priv->regcache);
+	mutex_unlock(&priv->mii_bus->mdio_lock);
+
 	ret = ar8xxx_sw_reset_switch(&priv->dev);
 	if (ret)
 		return ret;
@@ -2052,6 +2239,7 @@ ar8xxx_check_link_states(struct ar8xxx_priv *priv)
 
 		priv->link_up[i] = link_new;
 		changed = true;
+		switch_port_link_changed(&priv->dev, i);
 		/* flush ARL entries for this port if it went down*/
 		if (!link_new)
 			priv->chip->atu_flush_port(priv, i);
@@ -2077,7 +2265,8 @@ ar8xxx_phy_read_status(struct phy_device *phydev)
 	if (phydev->mdio.addr != 0)
 		return genphy_read_status(phydev);
 
-	ar8216_read_port_link(priv, phydev->mdio.addr, &link);
+	switch_get_port_link(&priv->dev, phydev->mdio.addr, &link,
+			     swconfig_snapshot_interval());
 	phydev->link = !!link.link;
 	if (!phydev->link)
 		return 0;
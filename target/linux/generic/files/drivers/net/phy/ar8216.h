@@ -17,6 +17,8 @@
 #ifndef __AR8216_H
 #define __AR8216_H
 
+#include "switch_regcache.h"
+
 #define BITS(_s, _n)	(((1UL << (_n)) - 1) << _s)
 
 #define AR8XXX_CAP_GIGE			BIT(0)
@@ -28,6 +30,12 @@
 #define AR8216_NUM_VLANS	16
 #define AR8316_NUM_VLANS	4096
 
+/* register window covered by the register cache */
+#define AR8XXX_REGCACHE_SIZE	0x800
+
+/* page register value that never matches a real page */
+#define AR8XXX_PAGE_INVALID	0xffff
+
 /* size of the vlan table */
 #define AR8X16_MAX_VLANS	128
 #define AR8X16_PROBE_RETRIES	10
@@ -392,6 +400,8 @@ struct ar8xxx_chip {
 
 	int (*hw_init)(struct ar8xxx_priv *priv);
 	void (*cleanup)(struct ar8xxx_priv *priv);
+	/* registers only written by the driver, which may be cached */
+	bool (*reg_cacheable)(struct ar8xxx_priv *priv, int reg);
 
 	const char *name;
 	int vlans;
@@ -409,6 +419,7 @@ struct ar8xxx_chip {
 	void (*vtu_load_vlan)(struct ar8xxx_priv *priv, u32 vid, u32 port_mask);
 	void (*phy_fixup)(struct ar8xxx_priv *priv, int phy);
 	void (*set_mirror_regs)(struct ar8xxx_priv *priv);
+	/* called with mii_bus->mdio_lock held */
 	void (*get_arl_entry)(struct ar8xxx_priv *priv, struct arl_entry *a,
 			      u32 *status, enum arl_op op);
 	int (*sw_hw_apply)(struct switch_dev *dev);
@@ -428,6 +439,12 @@ struct ar8xxx_priv {
 	const struct net_device_ops *ndo_old;
 	struct net_device_ops ndo;
 	struct mutex reg_mutex;
+	/* protected by mii_bus->mdio_lock */
+	u16 mii_page;
+	struct switch_regcache regcache;
+	unsigned long mdio_reads;
+	unsigned long mdio_writes;
+	unsigned long mdio_page_writes;
 	u8 chip_ver;
 	u8 chip_rev;
 	const struct ar8xxx_chip *chip;
@@ -445,6 +462,8 @@ struct ar8xxx_priv {
 	struct delayed_work mib_work;
 	int mib_next_port;
 	u64 *mib_stats;
+	u64 *mib_snapshot;
+	const char **mib_names;
 
 	struct list_head list;
 	unsigned int use_count;
@@ -468,6 +487,8 @@ u32
 ar8xxx_mii_read32(struct ar8xxx_priv *priv, int phy_id, int regnum);
 void
 ar8xxx_mii_write32(struct ar8xxx_priv *priv, int phy_id, int regnum, u32 val);
+void
+ar8xxx_mii_set_page(struct ar8xxx_priv *priv, u16 page);
 u32
 ar8xxx_read(struct ar8xxx_priv *priv, int reg);
 void
@@ -546,6 +567,10 @@ ar8xxx_sw_get_port_mib(struct switch_dev *dev,
                        const struct switch_attr *attr,
                        struct switch_val *val);
 int
+ar8xxx_sw_get_mibs(struct switch_dev *dev,
+		   const struct switch_attr *attr,
+		   struct switch_val *val);
+int
 ar8xxx_sw_get_arl_age_time(struct switch_dev *dev,
 			   const struct switch_attr *attr,
 			   struct switch_val *val);
@@ -558,6 +583,10 @@ ar8xxx_sw_get_arl_table(struct switch_dev *dev,
 			const struct switch_attr *attr,
 			struct switch_val *val);
 int
+ar8xxx_sw_get_mdio_stats(struct switch_dev *dev,
+			 const struct switch_attr *attr,
+			 struct switch_val *val);
+int
 ar8xxx_sw_set_flush_arl_table(struct switch_dev *dev,
 			      const struct switch_attr *attr,
 			      struct switch_val *val);
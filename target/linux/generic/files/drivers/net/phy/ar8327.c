@@ -1084,7 +1084,6 @@ ar8327_wait_atu_ready(struct ar8xxx_priv *priv, u16 r2, u16 r1)
 static void ar8327_get_arl_entry(struct ar8xxx_priv *priv,
 				 struct arl_entry *a, u32 *status, enum arl_op op)
 {
-	struct mii_bus *bus = priv->mii_bus;
 	u16 r2, page;
 	u16 r1_data0, r1_data1, r1_data2, r1_func;
 	u32 t, val0, val1, val2;
@@ -1102,8 +1101,7 @@ static void ar8327_get_arl_entry(struct ar8xxx_priv *priv,
 		/* all ATU registers are on the same page
 		* therefore set page only once
 		*/
-		bus->write(bus, 0x18, 0, page);
-		wait_for_page_switch();
+		ar8xxx_mii_set_page(priv, page);
 
 		ar8327_wait_atu_ready(priv, r2, r1_func);
 
@@ -1112,6 +1110,9 @@ static void ar8327_get_arl_entry(struct ar8xxx_priv *priv,
 		ar8xxx_mii_write32(priv, r2, r1_data2, 0);
 		break;
 	case AR8XXX_ARL_GET_NEXT:
+		/* no-op unless another access moved the page meanwhile */
+		ar8xxx_mii_set_page(priv, page);
+
 		ar8xxx_mii_write32(priv, r2, r1_func,
 				   AR8327_ATU_FUNC_OP_GET_NEXT |
 				   AR8327_ATU_FUNC_BUSY);
@@ -1283,6 +1284,12 @@ static const struct switch_attr ar8327_sw_attr_globals[] = {
 		.description = "Reset all MIB counters",
 		.set = ar8xxx_sw_set_reset_mibs,
 	},
+	{
+		.type = SWITCH_TYPE_COUNTERS,
+		.name = "mibs",
+		.description = "Get MIB counters of all ports",
+		.get = ar8xxx_sw_get_mibs,
+	},
 	{
 		.type = SWITCH_TYPE_INT,
 		.name = "enable_mirror_rx",
@@ -1329,6 +1336,13 @@ static const struct switch_attr ar8327_sw_attr_globals[] = {
 		.set = NULL,
 		.get = ar8xxx_sw_get_arl_table,
 	},
+	{
+		.type = SWITCH_TYPE_STRING,
+		.name = "mdio_stats",
+		.description = "Get MDIO transaction and register cache counts",
+		.set = NULL,
+		.get = ar8xxx_sw_get_mdio_stats,
+	},
 	{
 		.type = SWITCH_TYPE_NOVAL,
 		.name = "flush_arl_table",
@@ -1423,6 +1437,19 @@ static const struct switch_dev_ops ar8327_sw_ops = {
 #endif
 };
 
+/* port VLAN and lookup registers are only changed by the driver */
+static bool
+ar8327_reg_cacheable(struct ar8xxx_priv *priv, int reg)
+{
+	if (reg >= AR8327_REG_PORT_VLAN0(0) &&
+	    reg < AR8327_REG_PORT_VLAN0(AR8327_NUM_PORTS))
+		return true;
+
+	return reg >= AR8327_REG_PORT_LOOKUP(0) &&
+	       reg < AR8327_REG_PORT_LOOKUP(AR8327_NUM_PORTS) &&
+	       (reg - AR8327_REG_PORT_LOOKUP(0)) % 0xc == 0;
+}
+
 const struct ar8xxx_chip ar8327_chip = {
 	.caps = AR8XXX_CAP_GIGE | AR8XXX_CAP_MIB_COUNTERS,
 	.config_at_probe = true,
@@ -1439,6 +1466,7 @@ const struct ar8xxx_chip ar8327_chip = {
 
 	.hw_init = ar8327_hw_init,
 	.cleanup = ar8327_cleanup,
+	.reg_cacheable = ar8327_reg_cacheable,
 	.init_globals = ar8327_init_globals,
 	.init_port = ar8327_init_port,
 	.setup_port = ar8327_setup_port,
@@ -1473,6 +1501,7 @@ const struct ar8xxx_chip ar8337_chip = {
 
 	.hw_init = ar8327_hw_init,
 	.cleanup = ar8327_cleanup,
+	.reg_cacheable = ar8327_reg_cacheable,
 	.init_globals = ar8327_init_globals,
 	.init_port = ar8327_init_port,
 	.setup_port = ar8327_setup_port,
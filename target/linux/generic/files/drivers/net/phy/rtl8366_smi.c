@@ -198,16 +198,30 @@ static int rtl8366_smi_read_byte1(struct rtl8366_smi *smi, u8 *data)
 	return 0;
 }
 
+static inline bool rtl8366_smi_reg_cacheable(struct rtl8366_smi *smi,
+					     u32 addr)
+{
+	return smi->regcache.size && smi->ops->reg_cacheable(smi, addr);
+}
+
 int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
 {
 	unsigned long flags;
+	bool cacheable;
 	u8 lo = 0;
 	u8 hi = 0;
 	int ret;
 
 	spin_lock_irqsave(&smi->lock, flags);
 
+	cacheable = rtl8366_smi_reg_cacheable(smi, addr);
+	if (cacheable && switch_regcache_read(&smi->regcache, addr, data)) {
+		spin_unlock_irqrestore(&smi->lock, flags);
+		return 0;
+	}
+
 	rtl8366_smi_start(smi);
+	smi->smi_reads++;
 
 	/* send READ command */
 	ret = rtl8366_smi_write_byte(smi, smi->cmd_read);
@@ -231,6 +245,9 @@ int rtl8366_smi_read_reg(struct rtl8366_smi *smi, u32 addr, u32 *data)
 
 	*data = ((u32) lo) | (((u32) hi) << 8);
 
+	if (cacheable)
+		switch_regcache_update(&smi->regcache, addr, *data);
+
 	ret = 0;
 
  out:
@@ -245,11 +262,20 @@ static int __rtl8366_smi_write_reg(struct rtl8366_smi *smi,
 				   u32 addr, u32 data, bool ack)
 {
 	unsigned long flags;
+	bool cacheable;
 	int ret;
 
 	spin_lock_irqsave(&smi->lock, flags);
 
+	cacheable = rtl8366_smi_reg_cacheable(smi, addr);
+	if (cacheable &&
+	    switch_regcache_unchanged(&smi->regcache, addr, data & 0xffff)) {
+		spin_unlock_irqrestore(&smi->lock, flags);
+		return 0;
+	}
+
 	rtl8366_smi_start(smi);
+	smi->smi_writes++;
 
 	/* send WRITE command */
 	ret = rtl8366_smi_write_byte(smi, smi->cmd_write);
@@ -279,6 +305,9 @@ static int __rtl8366_smi_write_reg(struct rtl8366_smi *smi,
 	if (ret)
 		goto out;
 
+	if (cacheable)
+		switch_regcache_update(&smi->regcache, addr, data & 0xffff);
+
 	ret = 0;
 
  out:
@@ -315,17 +344,32 @@ int rtl8366_smi_rmwr(struct rtl8366_smi *smi, u32 addr, u32 mask, u32 data)
 }
 EXPORT_SYMBOL_GPL(rtl8366_smi_rmwr);
 
+static void rtl8366_regcache_invalidate(struct rtl8366_smi *smi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smi->lock, flags);
+	switch_regcache_invalidate(&smi->regcache);
+	spin_unlock_irqrestore(&smi->lock, flags);
+}
+
 static int rtl8366_reset(struct rtl8366_smi *smi)
 {
+	int err;
+
 	if (smi->hw_reset) {
 		smi->hw_reset(true);
 		msleep(RTL8366_SMI_HW_STOP_DELAY);
 		smi->hw_reset(false);
 		msleep(RTL8366_SMI_HW_START_DELAY);
+		rtl8366_regcache_invalidate(smi);
 		return 0;
 	}
 
-	return smi->ops->reset_chip(smi);
+	err = smi->ops->reset_chip(smi);
+	rtl8366_regcache_invalidate(smi);
+
+	return err;
 }
 
 static int rtl8366_mc_is_used(struct rtl8366_smi *smi, int mc_index, int *used)
@@ -824,6 +868,28 @@ static const struct file_operations fops_rtl8366_pvid = {
 	.owner	= THIS_MODULE
 };
 
+static ssize_t rtl8366_read_debugfs_regcache(struct file *file,
+					     char __user *user_buf,
+					     size_t count, loff_t *ppos)
+{
+	struct rtl8366_smi *smi = (struct rtl8366_smi *)file->private_data;
+	char *buf = smi->buf;
+	int len;
+
+	len = snprintf(buf, sizeof(smi->buf),
+		       "reads: %lu\nwrites: %lu\nhits: %lu\nskipped: %lu\n",
+		       smi->smi_reads, smi->smi_writes,
+		       smi->regcache.hits, smi->regcache.skipped);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static const struct file_operations fops_rtl8366_regcache = {
+	.read	= rtl8366_read_debugfs_regcache,
+	.open	= rtl8366_debugfs_open,
+	.owner	= THIS_MODULE
+};
+
 static const struct file_operations fops_rtl8366_mibs = {
 	.read = rtl8366_read_debugfs_mibs,
 	.open = rtl8366_debugfs_open,
@@ -895,9 +961,17 @@ static void rtl8366_debugfs_init(struct rtl8366_smi *smi)
 
 	node = debugfs_create_file("mibs", S_IRUSR, smi->debugfs_root, smi,
 				   &fops_rtl8366_mibs);
-	if (!node)
+	if (!node) {
 		dev_err(smi->parent, "Creating debugfs file '%s' failed\n",
 			"mibs");
+		return;
+	}
+
+	node = debugfs_create_file("regcache", S_IRUSR, root, smi,
+				   &fops_rtl8366_regcache);
+	if (!node)
+		dev_err(smi->parent, "Creating debugfs file '%s' failed\n",
+			"regcache");
 }
 
 static void rtl8366_debugfs_remove(struct rtl8366_smi *smi)
@@ -1367,6 +1441,13 @@ int rtl8366_smi_init(struct rtl8366_smi *smi)
 		goto err_free_sck;
 	}
 
+	if (smi->ops->reg_cacheable && smi->regcache_size) {
+		err = switch_regcache_init(&smi->regcache, smi->regcache_base,
+					   smi->regcache_size, 1);
+		if (err)
+			goto err_free_sck;
+	}
+
 	err = rtl8366_reset(smi);
 	if (err)
 		goto err_free_sck;
@@ -1397,6 +1478,7 @@ int rtl8366_smi_init(struct rtl8366_smi *smi)
 	return 0;
 
  err_free_sck:
+	switch_regcache_free(&smi->regcache);
 	__rtl8366_smi_cleanup(smi);
  err_out:
 	return err;
@@ -1408,6 +1490,7 @@ void rtl8366_smi_cleanup(struct rtl8366_smi *smi)
 	rtl8366_debugfs_remove(smi);
 	rtl8366_smi_mii_cleanup(smi);
 	__rtl8366_smi_cleanup(smi);
+	switch_regcache_free(&smi->regcache);
 }
 EXPORT_SYMBOL_GPL(rtl8366_smi_cleanup);
 
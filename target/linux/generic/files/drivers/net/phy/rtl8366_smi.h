@@ -15,6 +15,8 @@
 #include <linux/switch.h>
 #include <linux/platform_device.h>
 
+#include "switch_regcache.h"
+
 struct rtl8366_smi_ops;
 struct rtl8366_vlan_ops;
 struct mii_bus;
@@ -50,6 +52,13 @@ struct rtl8366_smi {
 
 	struct rtl8366_smi_ops	*ops;
 
+	/* register window for ops->reg_cacheable, protected by lock */
+	u32			regcache_base;
+	unsigned int		regcache_size;
+	struct switch_regcache	regcache;
+	unsigned long		smi_reads;
+	unsigned long		smi_writes;
+
 	int			vlan_enabled;
 	int			vlan4k_enabled;
 
@@ -100,6 +109,7 @@ struct rtl8366_smi_ops {
 	int	(*enable_vlan)(struct rtl8366_smi *smi, int enable);
 	int	(*enable_vlan4k)(struct rtl8366_smi *smi, int enable);
 	int	(*enable_port)(struct rtl8366_smi *smi, int port, int enable);
+	bool	(*reg_cacheable)(struct rtl8366_smi *smi, u32 addr);
 };
 
 struct rtl8366_smi *rtl8366_smi_alloc(struct device *parent);
@@ -1413,6 +1413,17 @@ static int rtl8366rb_detect(struct rtl8366_smi *smi)
 	return 0;
 }
 
+/* the VLAN member configurations and PVIDs are only changed by the driver */
+static bool rtl8366rb_reg_cacheable(struct rtl8366_smi *smi, u32 addr)
+{
+	if (addr >= RTL8366RB_VLAN_MC_BASE(0) &&
+	    addr < RTL8366RB_VLAN_MC_BASE(RTL8366RB_NUM_VLANS))
+		return true;
+
+	return addr >= RTL8366RB_PORT_VLAN_CTRL_REG(0) &&
+	       addr <= RTL8366RB_PORT_VLAN_CTRL_REG(RTL8366RB_NUM_PORTS - 1);
+}
+
 static struct rtl8366_smi_ops rtl8366rb_smi_ops = {
 	.detect		= rtl8366rb_detect,
 	.reset_chip	= rtl8366rb_reset_chip,
@@ -1432,6 +1443,7 @@ static struct rtl8366_smi_ops rtl8366rb_smi_ops = {
 	.enable_vlan	= rtl8366rb_enable_vlan,
 	.enable_vlan4k	= rtl8366rb_enable_vlan4k,
 	.enable_port	= rtl8366rb_enable_port,
+	.reg_cacheable	= rtl8366rb_reg_cacheable,
 };
 
 static int rtl8366rb_probe(struct platform_device *pdev)
@@ -1455,6 +1467,10 @@ static int rtl8366rb_probe(struct platform_device *pdev)
 	smi->cpu_port = RTL8366RB_PORT_NUM_CPU;
 	smi->num_ports = RTL8366RB_NUM_PORTS;
 	smi->num_vlan_mc = RTL8366RB_NUM_VLANS;
+	smi->regcache_base = RTL8366RB_VLAN_MC_BASE(0);
+	smi->regcache_size =
+		RTL8366RB_PORT_VLAN_CTRL_REG(RTL8366RB_NUM_PORTS - 1) + 1 -
+		smi->regcache_base;
 	smi->mib_counters = rtl8366rb_mib_counters;
 	smi->num_mib_counters = ARRAY_SIZE(rtl8366rb_mib_counters);
 
@@ -1500,6 +1500,17 @@ static int rtl8367b_detect(struct rtl8366_smi *smi)
 	return 0;
 }
 
+/* the VLAN member configurations and PVIDs are only changed by the driver */
+static bool rtl8367b_reg_cacheable(struct rtl8366_smi *smi, u32 addr)
+{
+	if (addr >= RTL8367B_VLAN_MC_BASE(0) &&
+	    addr < RTL8367B_VLAN_MC_BASE(RTL8367B_NUM_VLANS))
+		return true;
+
+	return addr >= RTL8367B_VLAN_PVID_CTRL_REG(0) &&
+	       addr <= RTL8367B_VLAN_PVID_CTRL_REG(RTL8367B_NUM_PORTS - 1);
+}
+
 static struct rtl8366_smi_ops rtl8367b_smi_ops = {
 	.detect		= rtl8367b_detect,
 	.reset_chip	= rtl8367b_reset_chip,
@@ -1519,6 +1530,7 @@ static struct rtl8366_smi_ops rtl8367b_smi_ops = {
 	.enable_vlan	= rtl8367b_enable_vlan,
 	.enable_vlan4k	= rtl8367b_enable_vlan4k,
 	.enable_port	= rtl8367b_enable_port,
+	.reg_cacheable	= rtl8367b_reg_cacheable,
 };
 
 static int  rtl8367b_probe(struct platform_device *pdev)
@@ -1537,6 +1549,9 @@ static int  rtl8367b_probe(struct platform_device *pdev)
 	smi->cpu_port = RTL8367B_CPU_PORT_NUM;
 	smi->num_ports = RTL8367B_NUM_PORTS;
 	smi->num_vlan_mc = RTL8367B_NUM_VLANS;
+	smi->regcache_base = RTL8367B_VLAN_PVID_CTRL_REG(0);
+	smi->regcache_size = RTL8367B_VLAN_MC_BASE(RTL8367B_NUM_VLANS) -
+			     smi->regcache_base;
 	smi->mib_counters = rtl8367b_mib_counters;
 	smi->num_mib_counters = ARRAY_SIZE(rtl8367b_mib_counters);
 
@@ -29,12 +29,31 @@
 
 #define SWCONFIG_DEVNAME	"switch%d"
 
+static unsigned int snapshot_interval = 100;
+module_param(snapshot_interval, uint, 0644);
+MODULE_PARM_DESC(snapshot_interval,
+		 "port link/stats snapshot refresh interval in milliseconds");
+
+/**
+ * swconfig_snapshot_interval - default max_age for the port snapshots
+ *
+ * Drivers polling link state through switch_get_port_link() should use this
+ * rather than their own interval, so that all readers share the snapshots.
+ */
+unsigned long
+swconfig_snapshot_interval(void)
+{
+	return max_t(unsigned long, msecs_to_jiffies(snapshot_interval), 1);
+}
+EXPORT_SYMBOL_GPL(swconfig_snapshot_interval);
+
 #include "swconfig_leds.c"
 
 MODULE_AUTHOR("Felix Fietkau <nbd@nbd.name>");
 MODULE_LICENSE("GPL");
 
 static int swdev_id;
+static unsigned int swdev_attr_gen;
 static struct list_head swdevs;
 static DEFINE_SPINLOCK(swdevs_lock);
 struct swconfig_callback;
@@ -132,10 +151,16 @@ static int
 swconfig_set_link(struct switch_dev *dev, const struct switch_attr *attr,
 			struct switch_val *val)
 {
+	int err;
+
 	if (!dev->ops->set_port_link)
 		return -EOPNOTSUPP;
 
-	return dev->ops->set_port_link(dev, val->port_vlan, val->value.link);
+	err = dev->ops->set_port_link(dev, val->port_vlan, val->value.link);
+	if (!err)
+		switch_port_link_changed(dev, val->port_vlan);
+
+	return err;
 }
 
 static int
@@ -150,8 +175,8 @@ swconfig_get_link(struct switch_dev *dev, const struct switch_attr *attr,
 	if (!dev->ops->get_port_link)
 		return -EOPNOTSUPP;
 
-	memset(link, 0, sizeof(*link));
-	return dev->ops->get_port_link(dev, val->port_vlan, link);
+	return switch_get_port_link(dev, val->port_vlan, link,
+				    swconfig_snapshot_interval());
 }
 
 static int
@@ -280,6 +305,10 @@ static const struct nla_policy switch_policy[SWITCH_ATTR_MAX+1] = {
 	[SWITCH_ATTR_OP_VALUE_STR] = { .type = NLA_NUL_STRING },
 	[SWITCH_ATTR_OP_VALUE_PORTS] = { .type = NLA_NESTED },
 	[SWITCH_ATTR_TYPE] = { .type = NLA_U32 },
+	[SWITCH_ATTR_BATCH] = { .type = NLA_NESTED },
+	[SWITCH_ATTR_BATCH_OP] = { .type = NLA_NESTED },
+	[SWITCH_ATTR_BATCH_CMD] = { .type = NLA_U32 },
+	[SWITCH_ATTR_BATCH_APPLY] = { .type = NLA_FLAG },
 };
 
 static const struct nla_policy port_policy[SWITCH_PORT_ATTR_MAX+1] = {
@@ -494,10 +523,9 @@ out:
 }
 
 static const struct switch_attr *
-swconfig_lookup_attr(struct switch_dev *dev, struct genl_info *info,
+swconfig_lookup_attr(struct switch_dev *dev, int cmd, struct nlattr **attrs,
 		struct switch_val *val)
 {
-	struct genlmsghdr *hdr = nlmsg_data(info->nlhdr);
 	const struct switch_attrlist *alist;
 	const struct switch_attr *attr = NULL;
 	unsigned int attr_id;
@@ -507,10 +535,10 @@ swconfig_lookup_attr(struct switch_dev *dev, struct genl_info *info,
 	unsigned long *def_active;
 	int n_def;
 
-	if (!info->attrs[SWITCH_ATTR_OP_ID])
+	if (!attrs[SWITCH_ATTR_OP_ID])
 		goto done;
 
-	switch (hdr->cmd) {
+	switch (cmd) {
 	case SWITCH_CMD_SET_GLOBAL:
 	case SWITCH_CMD_GET_GLOBAL:
 		alist = &dev->ops->attr_global;
@@ -524,9 +552,9 @@ swconfig_lookup_attr(struct switch_dev *dev, struct genl_info *info,
 		def_list = default_vlan;
 		def_active = &dev->def_vlan;
 		n_def = ARRAY_SIZE(default_vlan);
-		if (!info->attrs[SWITCH_ATTR_OP_VLAN])
+		if (!attrs[SWITCH_ATTR_OP_VLAN])
 			goto done;
-		val->port_vlan = nla_get_u32(info->attrs[SWITCH_ATTR_OP_VLAN]);
+		val->port_vlan = nla_get_u32(attrs[SWITCH_ATTR_OP_VLAN]);
 		if (val->port_vlan >= dev->vlans)
 			goto done;
 		break;
@@ -536,9 +564,9 @@ swconfig_lookup_attr(struct switch_dev *dev, struct genl_info *info,
 		def_list = default_port;
 		def_active = &dev->def_port;
 		n_def = ARRAY_SIZE(default_port);
-		if (!info->attrs[SWITCH_ATTR_OP_PORT])
+		if (!attrs[SWITCH_ATTR_OP_PORT])
 			goto done;
-		val->port_vlan = nla_get_u32(info->attrs[SWITCH_ATTR_OP_PORT]);
+		val->port_vlan = nla_get_u32(attrs[SWITCH_ATTR_OP_PORT]);
 		if (val->port_vlan >= dev->ports)
 			goto done;
 		break;
@@ -550,7 +578,7 @@ swconfig_lookup_attr(struct switch_dev *dev, struct genl_info *info,
 	if (!alist)
 		goto done;
 
-	attr_id = nla_get_u32(info->attrs[SWITCH_ATTR_OP_ID]);
+	attr_id = nla_get_u32(attrs[SWITCH_ATTR_OP_ID]);
 	if (attr_id >= SWITCH_ATTR_DEFAULTS_OFFSET) {
 		attr_id -= SWITCH_ATTR_DEFAULTS_OFFSET;
 		if (attr_id >= n_def)
@@ -632,23 +660,17 @@ swconfig_parse_link(struct sk_buff *msg, struct nlattr *nla,
 	return 0;
 }
 
+/* called with dev->sw_mutex held */
 static int
-swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
+swconfig_set_attr_val(struct switch_dev *dev, int cmd, struct nlattr **attrs,
+		struct sk_buff *skb)
 {
 	const struct switch_attr *attr;
-	struct switch_dev *dev;
 	struct switch_val val;
 	int err = -EINVAL;
 
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	dev = swconfig_get_dev(info);
-	if (!dev)
-		return -EINVAL;
-
 	memset(&val, 0, sizeof(val));
-	attr = swconfig_lookup_attr(dev, info, &val);
+	attr = swconfig_lookup_attr(dev, cmd, attrs, &val);
 	if (!attr || !attr->set)
 		goto error;
 
@@ -657,16 +679,16 @@ swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
 	case SWITCH_TYPE_NOVAL:
 		break;
 	case SWITCH_TYPE_INT:
-		if (!info->attrs[SWITCH_ATTR_OP_VALUE_INT])
+		if (!attrs[SWITCH_ATTR_OP_VALUE_INT])
 			goto error;
 		val.value.i =
-			nla_get_u32(info->attrs[SWITCH_ATTR_OP_VALUE_INT]);
+			nla_get_u32(attrs[SWITCH_ATTR_OP_VALUE_INT]);
 		break;
 	case SWITCH_TYPE_STRING:
-		if (!info->attrs[SWITCH_ATTR_OP_VALUE_STR])
+		if (!attrs[SWITCH_ATTR_OP_VALUE_STR])
 			goto error;
 		val.value.s =
-			nla_data(info->attrs[SWITCH_ATTR_OP_VALUE_STR]);
+			nla_data(attrs[SWITCH_ATTR_OP_VALUE_STR]);
 		break;
 	case SWITCH_TYPE_PORTS:
 		val.value.ports = dev->portbuf;
@@ -674,9 +696,9 @@ swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
 			sizeof(struct switch_port) * dev->ports);
 
 		/* TODO: implement multipart? */
-		if (info->attrs[SWITCH_ATTR_OP_VALUE_PORTS]) {
+		if (attrs[SWITCH_ATTR_OP_VALUE_PORTS]) {
 			err = swconfig_parse_ports(skb,
-				info->attrs[SWITCH_ATTR_OP_VALUE_PORTS],
+				attrs[SWITCH_ATTR_OP_VALUE_PORTS],
 				&val, dev->ports);
 			if (err < 0)
 				goto error;
@@ -689,9 +711,9 @@ swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
 		val.value.link = &dev->linkbuf;
 		memset(&dev->linkbuf, 0, sizeof(struct switch_port_link));
 
-		if (info->attrs[SWITCH_ATTR_OP_VALUE_LINK]) {
+		if (attrs[SWITCH_ATTR_OP_VALUE_LINK]) {
 			err = swconfig_parse_link(skb,
-						  info->attrs[SWITCH_ATTR_OP_VALUE_LINK],
+						  attrs[SWITCH_ATTR_OP_VALUE_LINK],
 						  val.value.link);
 			if (err < 0)
 				goto error;
@@ -706,6 +728,93 @@ swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
 
 	err = attr->set(dev, attr, &val);
 error:
+	return err;
+}
+
+static int
+swconfig_set_attr(struct sk_buff *skb, struct genl_info *info)
+{
+	struct genlmsghdr *hdr = nlmsg_data(info->nlhdr);
+	struct switch_dev *dev;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	dev = swconfig_get_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	err = swconfig_set_attr_val(dev, hdr->cmd, info->attrs, skb);
+	swconfig_put_dev(dev);
+	return err;
+}
+
+static int
+swconfig_set_batch(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *tb[SWITCH_ATTR_MAX + 1];
+	struct switch_dev *dev;
+	struct nlattr *nla;
+	int err = 0;
+	int rem;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!info->attrs[SWITCH_ATTR_BATCH])
+		return -EINVAL;
+
+	dev = swconfig_get_dev(info);
+	if (!dev)
+		return -EINVAL;
+
+	/*
+	 * Apply every operation of the batch under a single hold of the
+	 * device mutex. Like a sequence of individual set commands, a
+	 * failing operation does not stop the following ones; the first
+	 * error is reported back once the whole batch has been processed.
+	 */
+	nla_for_each_nested(nla, info->attrs[SWITCH_ATTR_BATCH], rem) {
+		int cmd, ret;
+
+		if (nla_type(nla) != SWITCH_ATTR_BATCH_OP)
+			continue;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,12,0)
+		ret = nla_parse_nested(tb, SWITCH_ATTR_MAX, nla, switch_policy);
+#else
+		ret = nla_parse_nested(tb, SWITCH_ATTR_MAX, nla, switch_policy,
+				       NULL);
+#endif
+		if (ret)
+			goto next;
+
+		ret = -EINVAL;
+		if (!tb[SWITCH_ATTR_BATCH_CMD])
+			goto next;
+
+		cmd = nla_get_u32(tb[SWITCH_ATTR_BATCH_CMD]);
+		switch (cmd) {
+		case SWITCH_CMD_SET_GLOBAL:
+		case SWITCH_CMD_SET_VLAN:
+		case SWITCH_CMD_SET_PORT:
+			ret = swconfig_set_attr_val(dev, cmd, tb, skb);
+			break;
+		}
+
+next:
+		if (ret && !err)
+			err = ret;
+	}
+
+	if (info->attrs[SWITCH_ATTR_BATCH_APPLY] && dev->ops->apply_config) {
+		int ret = dev->ops->apply_config(dev);
+
+		if (ret && !err)
+			err = ret;
+	}
+
 	swconfig_put_dev(dev);
 	return err;
 }
@@ -830,14 +939,76 @@ nla_put_failure:
 	return -1;
 }
 
+static size_t
+swconfig_counters_size(const struct switch_counters *counters)
+{
+	size_t size;
+	int i;
+
+	size = nla_total_size(0) * 2;
+	for (i = 0; i < counters->n_counters; i++)
+		size += nla_total_size(strlen(counters->names[i]) + 1);
+
+	size += counters->n_ports *
+		(nla_total_size(0) + nla_total_size(sizeof(u32)) +
+		 nla_total_size(counters->n_counters * sizeof(u64)));
+
+	return size;
+}
+
+static int
+swconfig_send_counters(struct sk_buff *msg, int attr,
+		       const struct switch_counters *counters)
+{
+	struct nlattr *c, *n;
+	int i;
+
+	c = nla_nest_start(msg, attr);
+	if (!c)
+		return -1;
+
+	/* the name table is sent once, not repeated for every port */
+	n = nla_nest_start(msg, SWITCH_COUNTERS_NAMES);
+	if (!n)
+		goto nla_put_failure;
+	for (i = 0; i < counters->n_counters; i++) {
+		if (nla_put_string(msg, SWITCH_COUNTERS_NAME,
+				   counters->names[i]))
+			goto nla_put_failure;
+	}
+	nla_nest_end(msg, n);
+
+	for (i = 0; i < counters->n_ports; i++) {
+		n = nla_nest_start(msg, SWITCH_COUNTERS_PORT);
+		if (!n)
+			goto nla_put_failure;
+		if (nla_put_u32(msg, SWITCH_COUNTERS_PORT_ID, i))
+			goto nla_put_failure;
+		if (nla_put(msg, SWITCH_COUNTERS_VALUES,
+			    counters->n_counters * sizeof(u64),
+			    &counters->values[i * counters->n_counters]))
+			goto nla_put_failure;
+		nla_nest_end(msg, n);
+	}
+
+	nla_nest_end(msg, c);
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(msg, c);
+	return -1;
+}
+
 static int
 swconfig_get_attr(struct sk_buff *skb, struct genl_info *info)
 {
 	struct genlmsghdr *hdr = nlmsg_data(info->nlhdr);
 	const struct switch_attr *attr;
 	struct switch_dev *dev;
+	struct switch_counters counters;
 	struct sk_buff *msg = NULL;
 	struct switch_val val;
+	size_t size = NLMSG_GOODSIZE;
 	int err = -EINVAL;
 	int cmd = hdr->cmd;
 
@@ -846,7 +1017,7 @@ swconfig_get_attr(struct sk_buff *skb, struct genl_info *info)
 		return -EINVAL;
 
 	memset(&val, 0, sizeof(val));
-	attr = swconfig_lookup_attr(dev, info, &val);
+	attr = swconfig_lookup_attr(dev, hdr->cmd, info->attrs, &val);
 	if (!attr || !attr->get)
 		goto error;
 
@@ -857,13 +1028,20 @@ swconfig_get_attr(struct sk_buff *skb, struct genl_info *info)
 	} else if (attr->type == SWITCH_TYPE_LINK) {
 		val.value.link = &dev->linkbuf;
 		memset(&dev->linkbuf, 0, sizeof(struct switch_port_link));
+	} else if (attr->type == SWITCH_TYPE_COUNTERS) {
+		val.value.counters = &counters;
+		memset(&counters, 0, sizeof(counters));
 	}
 
 	err = attr->get(dev, attr, &val);
 	if (err)
 		goto error;
 
-	msg = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+	if (attr->type == SWITCH_TYPE_COUNTERS)
+		size = max_t(size_t, size, swconfig_counters_size(&counters) +
+			     genlmsg_total_size(0));
+
+	msg = nlmsg_new(size, GFP_KERNEL);
 	if (!msg)
 		goto error;
 
@@ -893,6 +1071,12 @@ swconfig_get_attr(struct sk_buff *skb, struct genl_info *info)
 		if (err < 0)
 			goto nla_put_failure;
 		break;
+	case SWITCH_TYPE_COUNTERS:
+		err = swconfig_send_counters(msg, SWITCH_ATTR_OP_VALUE_COUNTERS,
+					     val.value.counters);
+		if (err < 0)
+			goto nla_put_failure;
+		break;
 	default:
 		pr_debug("invalid type in attribute\n");
 		err = -EINVAL;
@@ -943,6 +1127,8 @@ swconfig_send_switch(struct sk_buff *msg, u32 pid, u32 seq, int flags,
 		goto nla_put_failure;
 	if (nla_put_u32(msg, SWITCH_ATTR_CPU_PORT, dev->cpu_port))
 		goto nla_put_failure;
+	if (nla_put_u32(msg, SWITCH_ATTR_GENERATION, dev->attr_gen))
+		goto nla_put_failure;
 
 	m = nla_nest_start(msg, SWITCH_ATTR_PORTMAP);
 	if (!m)
@@ -1046,6 +1232,12 @@ static struct genl_ops swconfig_ops[] = {
 		.doit = swconfig_set_attr,
 		.policy = switch_policy,
 	},
+	{
+		.cmd = SWITCH_CMD_SET_BATCH,
+		.flags = GENL_ADMIN_PERM,
+		.doit = swconfig_set_batch,
+		.policy = switch_policy,
+	},
 	{
 		.cmd = SWITCH_CMD_GET_SWITCH,
 		.dumpit = swconfig_dump_switches,
@@ -1112,6 +1304,196 @@ of_switch_load_portmap(struct switch_dev *dev)
 }
 #endif
 
+/*
+ * Port link and stats snapshots
+ *
+ * Reading the link state or the traffic counters of a port takes several
+ * bus transactions on most switches. The LED trigger, link attribute reads
+ * and switch drivers themselves share the values read last, as long as
+ * they are younger than the age the caller can tolerate.
+ */
+enum {
+	SWITCH_SNAPSHOT_LINK,
+	SWITCH_SNAPSHOT_STATS,
+};
+
+struct switch_port_snapshot {
+	unsigned long valid;
+	unsigned long link_time;
+	unsigned long stats_time;
+	struct switch_port_link link;
+	struct switch_port_stats stats;
+};
+
+struct switch_snapshot {
+	/* serializes refreshes, the ops may sleep */
+	struct mutex lock;
+	struct switch_port_snapshot port[];
+};
+
+static int
+swconfig_snapshot_alloc(struct switch_dev *dev)
+{
+	struct switch_snapshot *snap;
+
+	if (!dev->ports ||
+	    (!dev->ops->get_port_link && !dev->ops->get_port_stats))
+		return 0;
+
+	snap = kzalloc(sizeof(*snap) + dev->ports * sizeof(snap->port[0]),
+		       GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	mutex_init(&snap->lock);
+	dev->snapshot = snap;
+
+	return 0;
+}
+
+static void
+swconfig_snapshot_free(struct switch_dev *dev)
+{
+	kfree(dev->snapshot);
+	dev->snapshot = NULL;
+}
+
+static inline bool
+swconfig_snapshot_fresh(struct switch_port_snapshot *ps, int bit,
+			unsigned long time, unsigned long max_age)
+{
+	return test_bit(bit, &ps->valid) &&
+	       time_before(jiffies, time + max_age);
+}
+
+/**
+ * switch_get_port_link - read the link state of a port
+ * @dev: switch device
+ * @port: port number
+ * @link: returns the link state
+ * @max_age: age in jiffies up to which a previous reading is reused
+ */
+int
+switch_get_port_link(struct switch_dev *dev, int port,
+		     struct switch_port_link *link, unsigned long max_age)
+{
+	struct switch_snapshot *snap = dev->snapshot;
+	struct switch_port_snapshot *ps;
+	int err = 0;
+
+	if (!dev->ops->get_port_link)
+		return -EOPNOTSUPP;
+
+	if (port < 0 || port >= dev->ports)
+		return -EINVAL;
+
+	if (!snap) {
+		memset(link, 0, sizeof(*link));
+		return dev->ops->get_port_link(dev, port, link);
+	}
+
+	ps = &snap->port[port];
+
+	mutex_lock(&snap->lock);
+	if (!swconfig_snapshot_fresh(ps, SWITCH_SNAPSHOT_LINK, ps->link_time,
+				     max_age)) {
+		/* set before reading, so a concurrent change is not lost */
+		set_bit(SWITCH_SNAPSHOT_LINK, &ps->valid);
+		memset(&ps->link, 0, sizeof(ps->link));
+		err = dev->ops->get_port_link(dev, port, &ps->link);
+		if (err)
+			clear_bit(SWITCH_SNAPSHOT_LINK, &ps->valid);
+		ps->link_time = jiffies;
+	}
+	*link = ps->link;
+	mutex_unlock(&snap->lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(switch_get_port_link);
+
+/**
+ * switch_get_port_stats - read the traffic counters of a port
+ * @dev: switch device
+ * @port: port number
+ * @stats: returns the counters
+ * @max_age: age in jiffies up to which a previous reading is reused
+ */
+int
+switch_get_port_stats(struct switch_dev *dev, int port,
+		      struct switch_port_stats *stats, unsigned long max_age)
+{
+	struct switch_snapshot *snap = dev->snapshot;
+	struct switch_port_snapshot *ps;
+	int err = 0;
+
+	if (!dev->ops->get_port_stats)
+		return -EOPNOTSUPP;
+
+	if (port < 0 || port >= dev->ports)
+		return -EINVAL;
+
+	if (!snap) {
+		memset(stats, 0, sizeof(*stats));
+		return dev->ops->get_port_stats(dev, port, stats);
+	}
+
+	ps = &snap->port[port];
+
+	mutex_lock(&snap->lock);
+	if (!swconfig_snapshot_fresh(ps, SWITCH_SNAPSHOT_STATS, ps->stats_time,
+				     max_age)) {
+		set_bit(SWITCH_SNAPSHOT_STATS, &ps->valid);
+		memset(&ps->stats, 0, sizeof(ps->stats));
+		err = dev->ops->get_port_stats(dev, port, &ps->stats);
+		if (err)
+			clear_bit(SWITCH_SNAPSHOT_STATS, &ps->valid);
+		ps->stats_time = jiffies;
+	}
+	*stats = ps->stats;
+	mutex_unlock(&snap->lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(switch_get_port_stats);
+
+/**
+ * switch_port_link_changed - notify swconfig about a link change
+ * @dev: switch device
+ * @port: port number
+ *
+ * Drops the link snapshot of the port and updates the LEDs right away.
+ * May be called from atomic context, e.g. a link change interrupt.
+ */
+void
+switch_port_link_changed(struct switch_dev *dev, int port)
+{
+	struct switch_snapshot *snap = dev->snapshot;
+
+	if (!snap || port < 0 || port >= dev->ports)
+		return;
+
+	clear_bit(SWITCH_SNAPSHOT_LINK, &snap->port[port].valid);
+	swconfig_led_link_changed(dev, port);
+}
+EXPORT_SYMBOL_GPL(switch_port_link_changed);
+
+/**
+ * switch_attrs_changed - notify swconfig about a changed attribute set
+ * @dev: switch device
+ *
+ * Must be called by drivers that change the attributes they provide after
+ * registering the switch, so that user space drops its cached copy.
+ */
+void
+switch_attrs_changed(struct switch_dev *dev)
+{
+	swconfig_lock();
+	dev->attr_gen = ++swdev_attr_gen;
+	swconfig_unlock();
+}
+EXPORT_SYMBOL_GPL(switch_attrs_changed);
+
 int
 register_switch(struct switch_dev *dev, struct net_device *netdev)
 {
@@ -1146,10 +1528,17 @@ register_switch(struct switch_dev *dev, struct net_device *netdev)
 			return -ENOMEM;
 		}
 	}
+	err = swconfig_snapshot_alloc(dev);
+	if (err) {
+		kfree(dev->portbuf);
+		kfree(dev->portmap);
+		return err;
+	}
 	swconfig_defaults_init(dev);
 	mutex_init(&dev->sw_mutex);
 	swconfig_lock();
 	dev->id = ++swdev_id;
+	dev->attr_gen = ++swdev_attr_gen;
 
 	list_for_each_entry(sdev, &swdevs, dev_list) {
 		if (!sscanf(sdev->devname, SWCONFIG_DEVNAME, &i))
@@ -1163,6 +1552,7 @@ register_switch(struct switch_dev *dev, struct net_device *netdev)
 
 	if (i == max_switches) {
 		swconfig_unlock();
+		swconfig_snapshot_free(dev);
 		return -ENFILE;
 	}
 
@@ -1178,8 +1568,15 @@ register_switch(struct switch_dev *dev, struct net_device *netdev)
 	swconfig_unlock();
 
 	err = swconfig_create_led_trigger(dev);
-	if (err)
+	if (err) {
+		swconfig_lock();
+		list_del(&dev->dev_list);
+		swconfig_unlock();
+		swconfig_snapshot_free(dev);
+		kfree(dev->portbuf);
+		kfree(dev->portmap);
 		return err;
+	}
 
 	return 0;
 }
@@ -1194,6 +1591,7 @@ unregister_switch(struct switch_dev *dev)
 	swconfig_lock();
 	list_del(&dev->dev_list);
 	swconfig_unlock();
+	swconfig_snapshot_free(dev);
 	mutex_unlock(&dev->sw_mutex);
 }
 EXPORT_SYMBOL_GPL(unregister_switch);
@@ -17,7 +17,6 @@
 #include <linux/device.h>
 #include <linux/workqueue.h>
 
-#define SWCONFIG_LED_TIMER_INTERVAL	(HZ / 10)
 #define SWCONFIG_LED_NUM_PORTS		32
 
 #define SWCONFIG_LED_PORT_SPEED_NA	0x01	/* unknown speed */
@@ -93,7 +92,7 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 
 	if (port_mask)
 		schedule_delayed_work(&sw_trig->sw_led_work,
-				      SWCONFIG_LED_TIMER_INTERVAL);
+				      swconfig_snapshot_interval());
 	else
 		cancel_delayed_work_sync(&sw_trig->sw_led_work);
 }
@@ -317,6 +316,7 @@ swconfig_led_work_func(struct work_struct *work)
 {
 	struct switch_led_trigger *sw_trig;
 	struct switch_dev *swdev;
+	unsigned long interval;
 	u32 port_mask;
 	u32 link;
 	int i;
@@ -326,6 +326,7 @@ swconfig_led_work_func(struct work_struct *work)
 
 	port_mask = sw_trig->port_mask;
 	swdev = sw_trig->swdev;
+	interval = swconfig_snapshot_interval();
 
 	link = 0;
 	for (i = 0; i < SWCONFIG_LED_NUM_PORTS; i++) {
@@ -337,11 +338,15 @@ swconfig_led_work_func(struct work_struct *work)
 		if ((port_mask & port_bit) == 0)
 			continue;
 
+		/*
+		 * Readings taken in between by other users of the snapshot
+		 * are reused if they are less than half a period old.
+		 */
 		if (swdev->ops->get_port_link) {
 			struct switch_port_link port_link;
 
 			memset(&port_link, '\0', sizeof(port_link));
-			swdev->ops->get_port_link(swdev, i, &port_link);
+			switch_get_port_link(swdev, i, &port_link, interval / 2);
 
 			if (port_link.link) {
 				link |= port_bit;
@@ -370,7 +375,8 @@ swconfig_led_work_func(struct work_struct *work)
 			struct switch_port_stats port_stats;
 
 			memset(&port_stats, '\0', sizeof(port_stats));
-			swdev->ops->get_port_stats(swdev, i, &port_stats);
+			switch_get_port_stats(swdev, i, &port_stats,
+					      interval / 2);
 			sw_trig->port_traffic[i] = port_stats.tx_bytes +
 						   port_stats.rx_bytes;
 		}
@@ -380,8 +386,16 @@ swconfig_led_work_func(struct work_struct *work)
 
 	swconfig_trig_update_leds(sw_trig);
 
-	schedule_delayed_work(&sw_trig->sw_led_work,
-			      SWCONFIG_LED_TIMER_INTERVAL);
+	schedule_delayed_work(&sw_trig->sw_led_work, interval);
+}
+
+static void
+swconfig_led_link_changed(struct switch_dev *swdev, int port)
+{
+	struct switch_led_trigger *sw_trig = swdev->led_trigger;
+
+	if (sw_trig && (sw_trig->port_mask & BIT(port)))
+		mod_delayed_work(system_wq, &sw_trig->sw_led_work, 0);
 }
 
 static int
@@ -436,4 +450,7 @@ swconfig_create_led_trigger(struct switch_dev *swdev) { return 0; }
 
 static inline void
 swconfig_destroy_led_trigger(struct switch_dev *swdev) { }
+
+static inline void
+swconfig_led_link_changed(struct switch_dev *swdev, int port) { }
 #endif /* CONFIG_SWCONFIG_LEDS */
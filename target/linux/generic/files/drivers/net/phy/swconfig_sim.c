@@ -0,0 +1,385 @@
+/*
+ * swconfig_sim.c: Software emulated switch for the switch configuration API
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The emulated switch keeps its VLAN table in memory and has no
+ * hardware behind it. It allows exercising swconfig, swlib and the
+ * uci binding on any system. An optional per-access delay models the
+ * cost of MDIO register accesses of real switches.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/switch.h>
+
+#define SWSIM_MAX_PORTS		32
+#define SWSIM_MAX_VLANS		4096
+
+static unsigned int ports = 7;
+module_param(ports, uint, 0444);
+MODULE_PARM_DESC(ports, "number of emulated ports, the last one is the CPU port");
+
+static unsigned int vlans = 128;
+module_param(vlans, uint, 0444);
+MODULE_PARM_DESC(vlans, "number of emulated VLAN table entries");
+
+static unsigned int access_delay;
+module_param(access_delay, uint, 0644);
+MODULE_PARM_DESC(access_delay, "emulated register access time in microseconds");
+
+struct swsim_vlan {
+	u16 vid;
+	u32 members;
+	u32 tagged;
+};
+
+struct swsim_state {
+	struct switch_dev dev;
+
+	bool vlan_enabled;
+	u16 pvid[SWSIM_MAX_PORTS];
+	struct swsim_vlan *vlan;
+
+	/* statistics for benchmarking the configuration path */
+	unsigned int n_access;
+	unsigned int n_apply;
+};
+
+#define to_swsim(_dev) container_of(_dev, struct swsim_state, dev)
+
+static void
+swsim_access(struct swsim_state *state)
+{
+	state->n_access++;
+	if (access_delay)
+		usleep_range(access_delay, access_delay + 1);
+}
+
+static int
+swsim_get_vlan_ports(struct switch_dev *dev, struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+	struct swsim_vlan *vlan = &state->vlan[val->port_vlan];
+	int i;
+
+	swsim_access(state);
+
+	val->len = 0;
+	for (i = 0; i < dev->ports; i++) {
+		struct switch_port *p;
+
+		if (!(vlan->members & BIT(i)))
+			continue;
+
+		p = &val->value.ports[val->len++];
+		p->id = i;
+		if (vlan->tagged & BIT(i))
+			p->flags = (1 << SWITCH_PORT_FLAG_TAGGED);
+		else
+			p->flags = 0;
+	}
+
+	return 0;
+}
+
+static int
+swsim_set_vlan_ports(struct switch_dev *dev, struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+	struct swsim_vlan *vlan = &state->vlan[val->port_vlan];
+	int i;
+
+	swsim_access(state);
+
+	vlan->members = 0;
+	vlan->tagged = 0;
+	for (i = 0; i < val->len; i++) {
+		struct switch_port *p = &val->value.ports[i];
+
+		if (p->id >= dev->ports)
+			return -EINVAL;
+
+		vlan->members |= BIT(p->id);
+		if (p->flags & (1 << SWITCH_PORT_FLAG_TAGGED))
+			vlan->tagged |= BIT(p->id);
+		else
+			state->pvid[p->id] = val->port_vlan;
+	}
+
+	return 0;
+}
+
+static int
+swsim_get_pvid(struct switch_dev *dev, int port, int *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	swsim_access(state);
+	*val = state->pvid[port];
+
+	return 0;
+}
+
+static int
+swsim_set_pvid(struct switch_dev *dev, int port, int val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	if (val < 0 || val >= dev->vlans)
+		return -EINVAL;
+
+	swsim_access(state);
+	state->pvid[port] = val;
+
+	return 0;
+}
+
+static int
+swsim_get_port_link(struct switch_dev *dev, int port,
+		    struct switch_port_link *link)
+{
+	link->link = 1;
+	link->duplex = 1;
+	link->aneg = 1;
+	link->speed = SWITCH_PORT_SPEED_1000;
+
+	return 0;
+}
+
+static int
+swsim_apply_config(struct switch_dev *dev)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	/* model a full rewrite of the port and VLAN tables */
+	swsim_access(state);
+	state->n_apply++;
+
+	return 0;
+}
+
+static int
+swsim_reset_switch(struct switch_dev *dev)
+{
+	struct swsim_state *state = to_swsim(dev);
+	int i;
+
+	swsim_access(state);
+
+	state->vlan_enabled = false;
+	memset(state->pvid, 0, sizeof(state->pvid));
+	memset(state->vlan, 0, sizeof(*state->vlan) * dev->vlans);
+	for (i = 0; i < dev->vlans; i++)
+		state->vlan[i].vid = i;
+
+	return 0;
+}
+
+static int
+swsim_get_enable_vlan(struct switch_dev *dev, const struct switch_attr *attr,
+		      struct switch_val *val)
+{
+	val->value.i = to_swsim(dev)->vlan_enabled;
+
+	return 0;
+}
+
+static int
+swsim_set_enable_vlan(struct switch_dev *dev, const struct switch_attr *attr,
+		      struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	swsim_access(state);
+	state->vlan_enabled = !!val->value.i;
+
+	return 0;
+}
+
+static int
+swsim_get_stat(struct switch_dev *dev, const struct switch_attr *attr,
+	       struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	if (attr->ofs)
+		val->value.i = state->n_apply;
+	else
+		val->value.i = state->n_access;
+
+	return 0;
+}
+
+static int
+swsim_reset_stats(struct switch_dev *dev, const struct switch_attr *attr,
+		  struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	state->n_access = 0;
+	state->n_apply = 0;
+
+	return 0;
+}
+
+static int
+swsim_get_vid(struct switch_dev *dev, const struct switch_attr *attr,
+	      struct switch_val *val)
+{
+	val->value.i = to_swsim(dev)->vlan[val->port_vlan].vid;
+
+	return 0;
+}
+
+static int
+swsim_set_vid(struct switch_dev *dev, const struct switch_attr *attr,
+	      struct switch_val *val)
+{
+	struct swsim_state *state = to_swsim(dev);
+
+	if (val->value.i < 0 || val->value.i >= SWSIM_MAX_VLANS)
+		return -EINVAL;
+
+	swsim_access(state);
+	state->vlan[val->port_vlan].vid = val->value.i;
+
+	return 0;
+}
+
+static const struct switch_attr swsim_global[] = {
+	{
+		.type = SWITCH_TYPE_INT,
+		.name = "enable_vlan",
+		.description = "Enable VLAN mode",
+		.set = swsim_set_enable_vlan,
+		.get = swsim_get_enable_vlan,
+		.max = 1,
+	}, {
+		.type = SWITCH_TYPE_INT,
+		.name = "accesses",
+		.description = "Number of emulated register accesses",
+		.get = swsim_get_stat,
+		.ofs = 0,
+	}, {
+		.type = SWITCH_TYPE_INT,
+		.name = "applies",
+		.description = "Number of configuration applies",
+		.get = swsim_get_stat,
+		.ofs = 1,
+	}, {
+		.type = SWITCH_TYPE_NOVAL,
+		.name = "reset_stats",
+		.description = "Reset the access and apply counters",
+		.set = swsim_reset_stats,
+	},
+};
+
+static const struct switch_attr swsim_vlan[] = {
+	{
+		.type = SWITCH_TYPE_INT,
+		.name = "vid",
+		.description = "VLAN ID (0-4094)",
+		.set = swsim_set_vid,
+		.get = swsim_get_vid,
+		.max = 4094,
+	},
+};
+
+static const struct switch_dev_ops swsim_ops = {
+	.attr_global = {
+		.attr = swsim_global,
+		.n_attr = ARRAY_SIZE(swsim_global),
+	},
+	.attr_port = {
+		.attr = NULL,
+		.n_attr = 0,
+	},
+	.attr_vlan = {
+		.attr = swsim_vlan,
+		.n_attr = ARRAY_SIZE(swsim_vlan),
+	},
+	.get_vlan_ports = swsim_get_vlan_ports,
+	.set_vlan_ports = swsim_set_vlan_ports,
+	.get_port_pvid = swsim_get_pvid,
+	.set_port_pvid = swsim_set_pvid,
+	.get_port_link = swsim_get_port_link,
+	.apply_config = swsim_apply_config,
+	.reset_switch = swsim_reset_switch,
+};
+
+static struct swsim_state *swsim;
+
+static int __init
+swsim_init(void)
+{
+	struct swsim_state *state;
+	struct switch_dev *dev;
+	int err;
+
+	if (!ports || ports > SWSIM_MAX_PORTS || !vlans ||
+	    vlans > SWSIM_MAX_VLANS)
+		return -EINVAL;
+
+	state = kzalloc(sizeof(*state), GFP_KERNEL);
+	if (!state)
+		return -ENOMEM;
+
+	state->vlan = kcalloc(vlans, sizeof(*state->vlan), GFP_KERNEL);
+	if (!state->vlan) {
+		err = -ENOMEM;
+		goto err_free_state;
+	}
+
+	dev = &state->dev;
+	dev->name = "Emulated switch";
+	dev->alias = "swsim";
+	dev->ops = &swsim_ops;
+	dev->ports = ports;
+	dev->vlans = vlans;
+	dev->cpu_port = ports - 1;
+
+	swsim_reset_switch(dev);
+
+	err = register_switch(dev, NULL);
+	if (err)
+		goto err_free_vlan;
+
+	pr_info("%s: %d ports, %d vlans\n", dev->devname, dev->ports,
+		dev->vlans);
+	swsim = state;
+
+	return 0;
+
+err_free_vlan:
+	kfree(state->vlan);
+err_free_state:
+	kfree(state);
+	return err;
+}
+module_init(swsim_init);
+
+static void __exit
+swsim_exit(void)
+{
+	unregister_switch(&swsim->dev);
+	kfree(swsim->vlan);
+	kfree(swsim);
+}
+module_exit(swsim_exit);
+
+MODULE_DESCRIPTION("Software emulated switch for swconfig");
+MODULE_LICENSE("GPL");
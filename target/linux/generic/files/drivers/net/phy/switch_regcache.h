@@ -0,0 +1,128 @@
+/*
+ * switch_regcache.h: write-through register cache for switch drivers
+ *
+ * Copyright (C) 2018 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * Switches behind MDIO or bit-banged SMI need several bus transactions for
+ * each register access. The configuration registers are only ever changed
+ * by the driver itself, so their last written value can be kept here and
+ * reads or read-modify-write cycles of them can be served without touching
+ * the bus. Which registers are safe to cache is up to the driver; the cache
+ * only covers the address window given at init time.
+ */
+
+#ifndef __SWITCH_REGCACHE_H
+#define __SWITCH_REGCACHE_H
+
+#include <linux/types.h>
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+
+struct switch_regcache {
+	u32 base;
+	unsigned int size;
+	unsigned int stride;
+	u32 *val;
+	unsigned long *valid;
+
+	/* bus accesses avoided, for debugging */
+	unsigned long hits;
+	unsigned long skipped;
+};
+
+static inline int
+switch_regcache_init(struct switch_regcache *c, u32 base, unsigned int size,
+		     unsigned int stride)
+{
+	c->base = base;
+	c->size = size;
+	c->stride = stride;
+	c->hits = 0;
+	c->skipped = 0;
+	c->val = kcalloc(size, sizeof(*c->val), GFP_KERNEL);
+	c->valid = kcalloc(BITS_TO_LONGS(size), sizeof(long), GFP_KERNEL);
+	if (!c->val || !c->valid) {
+		kfree(c->val);
+		kfree(c->valid);
+		c->val = NULL;
+		c->valid = NULL;
+		c->size = 0;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static inline void
+switch_regcache_free(struct switch_regcache *c)
+{
+	kfree(c->val);
+	kfree(c->valid);
+	c->val = NULL;
+	c->valid = NULL;
+	c->size = 0;
+}
+
+/* forget all cached values, e.g. after a reset of the switch */
+static inline void
+switch_regcache_invalidate(struct switch_regcache *c)
+{
+	if (c->valid)
+		bitmap_zero(c->valid, c->size);
+}
+
+static inline bool
+__switch_regcache_index(struct switch_regcache *c, u32 reg, unsigned int *idx)
+{
+	if (!c->size || reg < c->base || (reg - c->base) % c->stride)
+		return false;
+
+	*idx = (reg - c->base) / c->stride;
+	return *idx < c->size;
+}
+
+/* returns true and the cached value if the register is in the cache */
+static inline bool
+switch_regcache_read(struct switch_regcache *c, u32 reg, u32 *val)
+{
+	unsigned int idx;
+
+	if (!__switch_regcache_index(c, reg, &idx) || !test_bit(idx, c->valid))
+		return false;
+
+	*val = c->val[idx];
+	c->hits++;
+	return true;
+}
+
+/* returns true if the register is known to hold val already */
+static inline bool
+switch_regcache_unchanged(struct switch_regcache *c, u32 reg, u32 val)
+{
+	unsigned int idx;
+
+	if (!__switch_regcache_index(c, reg, &idx) || !test_bit(idx, c->valid) ||
+	    c->val[idx] != val)
+		return false;
+
+	c->skipped++;
+	return true;
+}
+
+static inline void
+switch_regcache_update(struct switch_regcache *c, u32 reg, u32 val)
+{
+	unsigned int idx;
+
+	if (!__switch_regcache_index(c, reg, &idx))
+		return;
+
+	c->val[idx] = val;
+	set_bit(idx, c->valid);
+}
+
+#endif /* __SWITCH_REGCACHE_H */
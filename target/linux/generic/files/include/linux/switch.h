@@ -25,10 +25,22 @@ struct switch_val;
 struct switch_attr;
 struct switch_attrlist;
 struct switch_led_trigger;
+struct switch_snapshot;
+struct switch_port_link;
+struct switch_port_stats;
 
 int register_switch(struct switch_dev *dev, struct net_device *netdev);
 void unregister_switch(struct switch_dev *dev);
 
+int switch_get_port_link(struct switch_dev *dev, int port,
+			 struct switch_port_link *link, unsigned long max_age);
+int switch_get_port_stats(struct switch_dev *dev, int port,
+			  struct switch_port_stats *stats,
+			  unsigned long max_age);
+void switch_port_link_changed(struct switch_dev *dev, int port);
+unsigned long swconfig_snapshot_interval(void);
+void switch_attrs_changed(struct switch_dev *dev);
+
 /**
  * struct switch_attrlist - attribute list
  *
@@ -121,6 +133,7 @@ struct switch_dev {
 
 	/* the following fields are internal for swconfig */
 	unsigned int id;
+	unsigned int attr_gen;
 	struct list_head dev_list;
 	unsigned long def_global, def_port, def_vlan;
 
@@ -128,6 +141,7 @@ struct switch_dev {
 	struct switch_port *portbuf;
 	struct switch_portmap *portmap;
 	struct switch_port_link linkbuf;
+	struct switch_snapshot *snapshot;
 
 	char buf[128];
 
@@ -146,6 +160,17 @@ struct switch_portmap {
 	const char *s;
 };
 
+/*
+ * Counter arrays for all ports: values holds n_counters entries per
+ * port, for n_ports ports, described by the names table.
+ */
+struct switch_counters {
+	unsigned int n_ports;
+	unsigned int n_counters;
+	const char * const *names;
+	const u64 *values;
+};
+
 struct switch_val {
 	const struct switch_attr *attr;
 	unsigned int port_vlan;
@@ -155,6 +180,7 @@ struct switch_val {
 		u32 i;
 		struct switch_port *ports;
 		struct switch_port_link *link;
+		struct switch_counters *counters;
 	} value;
 };
 
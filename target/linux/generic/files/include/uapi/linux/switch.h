@@ -54,6 +54,15 @@ enum {
 	SWITCH_ATTR_OP_DESCRIPTION,
 	/* port lists */
 	SWITCH_ATTR_PORT,
+	/* batch set */
+	SWITCH_ATTR_BATCH,
+	SWITCH_ATTR_BATCH_OP,
+	SWITCH_ATTR_BATCH_CMD,
+	SWITCH_ATTR_BATCH_APPLY,
+	/* counter arrays */
+	SWITCH_ATTR_OP_VALUE_COUNTERS,
+	/* attribute set generation */
+	SWITCH_ATTR_GENERATION,
 	SWITCH_ATTR_MAX
 };
 
@@ -78,7 +87,8 @@ enum {
 	SWITCH_CMD_SET_PORT,
 	SWITCH_CMD_LIST_VLAN,
 	SWITCH_CMD_GET_VLAN,
-	SWITCH_CMD_SET_VLAN
+	SWITCH_CMD_SET_VLAN,
+	SWITCH_CMD_SET_BATCH
 };
 
 /* data types */
@@ -89,6 +99,7 @@ enum switch_val_type {
 	SWITCH_TYPE_PORTS,
 	SWITCH_TYPE_LINK,
 	SWITCH_TYPE_NOVAL,
+	SWITCH_TYPE_COUNTERS,
 };
 
 /* port nested attributes */
@@ -113,6 +124,17 @@ enum {
 	SWITCH_LINK_ATTR_MAX,
 };
 
+/* counter array nested attributes */
+enum {
+	SWITCH_COUNTERS_UNSPEC,
+	SWITCH_COUNTERS_NAMES,		/* nested SWITCH_COUNTERS_NAME strings */
+	SWITCH_COUNTERS_NAME,
+	SWITCH_COUNTERS_PORT,		/* nested, one per port */
+	SWITCH_COUNTERS_PORT_ID,
+	SWITCH_COUNTERS_VALUES,		/* u64 array in name table order */
+	SWITCH_COUNTERS_ATTR_MAX,
+};
+
 #define SWITCH_ATTR_DEFAULTS_OFFSET	0x1000
 
 
@@ -28,7 +28,7 @@ linksys_get_target_firmware() {
 }
 
 linksys_get_root_magic() {
-	(get_image "$@" | dd skip=786432 bs=4 count=1 | hexdump -v -n 4 -e '1/1 "%02x"') 2>/dev/null
+	imageprobe ${2:+-c "$2"} -o 3145728 -f magic_long_3145728 "$1" 2>/dev/null
 }
 
 platform_do_upgrade_linksys() {
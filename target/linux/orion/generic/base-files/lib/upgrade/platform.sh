@@ -9,8 +9,9 @@ platform_check_image() {
 	[ "${ARGC}" -gt 1 ] && { echo 'Too many arguments. Only flash file expected.'; return 1; }
 
 	local hardware="$(board_name)"
-	local magic="$(get_magic_word "$1")"
-	local magic_long="$(get_magic_long "$1")"
+	image_probe "$1"
+	local magic="$img_magic_word"
+	local magic_long="$img_magic_long"
 
 	case "${hardware}" in
 	 # hardware with a direct uImage partition